@@ -0,0 +1,417 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L /* clock_gettime() */
+#include <sys/resource.h>       /* getrusage() */
+#define BENCH_RUSAGE
+#endif
+#include <stddef.h>  /* size_t */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "leptjson.h"
+
+/* counts the allocations of the library through its allocator, loosely when it runs threads */
+static unsigned long bench_allocs;
+static void* bench_malloc(void* ctx, size_t size) { (void)ctx; bench_allocs++; return malloc(size); }
+static void* bench_realloc(void* ctx, void* ptr, size_t size) { (void)ctx; bench_allocs++; return realloc(ptr, size); }
+static void bench_free(void* ctx, void* ptr) { (void)ctx; free(ptr); }
+
+#define BENCH_WARMUP 3
+#define BENCH_ITERATIONS 20
+#define BENCH_THREADS 4
+#define BENCH_TOLERANCE 10.0    /* percent below the baseline that fails */
+
+typedef struct {
+    const char* name;
+    char* json;
+    size_t len;
+}bench_corpus;
+
+typedef struct {
+    char* s;
+    size_t len, size;
+}bench_buffer;
+
+static double bench_now(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static int bench_buffer_write(void* ctx, const char* buf, size_t len) {
+    bench_buffer* b = (bench_buffer*)ctx;
+    if (b->len + len >= b->size) {
+        while (b->len + len >= b->size)
+            b->size = b->size ? b->size + (b->size >> 1) : 4096;
+        b->s = (char*)realloc(b->s, b->size);
+    }
+    memcpy(b->s + b->len, buf, len);
+    b->len += len;
+    return 0;
+}
+
+/* deterministic numbers in [0, 1) so every run sees the same corpora */
+static double bench_random(void) {
+    static uint32_t seed = 2463534242u;
+    uint32_t hi, lo;
+    seed = seed * 1664525u + 1013904223u;
+    hi = seed >> 5;
+    seed = seed * 1664525u + 1013904223u;
+    lo = seed >> 6;
+    return (hi * 67108864.0 + lo) / 9007199254740992.0;   /* 27 + 26 bits */
+}
+
+/* GeoJSON polygons with full precision coordinates, like canada.json */
+static void bench_generate_numbers(lept_writer* w) {
+    int i, j;
+    lept_writer_start_object(w);
+    lept_writer_key(w, "type", 4);
+    lept_writer_string(w, "FeatureCollection", 17);
+    lept_writer_key(w, "features", 8);
+    lept_writer_start_array(w);
+    for (i = 0; i < 16; i++) {
+        lept_writer_start_object(w);
+        lept_writer_key(w, "type", 4);
+        lept_writer_string(w, "Polygon", 7);
+        lept_writer_key(w, "coordinates", 11);
+        lept_writer_start_array(w);
+        lept_writer_start_array(w);
+        for (j = 0; j < 4096; j++) {
+            lept_writer_start_array(w);
+            lept_writer_number(w, bench_random() * 360.0 - 180.0);
+            lept_writer_number(w, bench_random() * 180.0 - 90.0);
+            lept_writer_end_array(w);
+        }
+        lept_writer_end_array(w);
+        lept_writer_end_array(w);
+        lept_writer_end_object(w);
+    }
+    lept_writer_end_array(w);
+    lept_writer_end_object(w);
+}
+
+/* small objects of mixed members, like twitter.json and citm_catalog.json */
+static void bench_generate_objects(lept_writer* w) {
+    static const char* words[] = { "lorem", "ipsum", "caf\xc3\xa9", "dolor", "sit", "amet", "\xe6\x97\xa5\xe6\x9c\xac", "json" };
+    char text[128];
+    int i, j;
+    size_t len;
+    lept_writer_start_array(w);
+    for (i = 0; i < 4096; i++) {
+        lept_writer_start_object(w);
+        lept_writer_key(w, "id", 2);
+        lept_writer_int64(w, (int64_t)505874924 * 1000000000 + i);
+        lept_writer_key(w, "text", 4);
+        for (len = 0, j = (int)(bench_random() * 12) + 4; j > 0; j--) {
+            const char* word = words[(int)(bench_random() * 8)];
+            memcpy(text + len, word, strlen(word));
+            len += strlen(word);
+            text[len++] = j > 1 ? ' ' : '\n';
+        }
+        lept_writer_string(w, text, len);
+        lept_writer_key(w, "user", 4);
+        lept_writer_start_object(w);
+        lept_writer_key(w, "screen_name", 11);
+        lept_writer_string(w, words[i % 8], strlen(words[i % 8]));
+        lept_writer_key(w, "followers_count", 15);
+        lept_writer_int64(w, (int64_t)(bench_random() * 100000));
+        lept_writer_key(w, "verified", 8);
+        lept_writer_boolean(w, i % 7 == 0);
+        lept_writer_end_object(w);
+        lept_writer_key(w, "hashtags", 8);
+        lept_writer_start_array(w);
+        for (j = i % 3; j > 0; j--)
+            lept_writer_string(w, words[j], strlen(words[j]));
+        lept_writer_end_array(w);
+        lept_writer_key(w, "price", 5);
+        lept_writer_number(w, (int)(bench_random() * 10000) / 100.0);
+        lept_writer_key(w, "in_reply_to", 11);
+        lept_writer_null(w);
+        lept_writer_end_object(w);
+    }
+    lept_writer_end_array(w);
+}
+
+/* long strings with a few escapes */
+static void bench_generate_strings(lept_writer* w) {
+    char s[16384];
+    int i;
+    size_t j;
+    lept_writer_start_array(w);
+    for (i = 0; i < 64; i++) {
+        for (j = 0; j < sizeof(s); j++) {
+            double r = bench_random();
+            s[j] = r < 0.002 ? '"' : r < 0.004 ? '\\' : r < 0.01 ? '\n' : (char)(' ' + (int)(r * 94));
+        }
+        lept_writer_string(w, s, sizeof(s));
+    }
+    lept_writer_end_array(w);
+}
+
+/* long strings of nothing but \uXXXX escapes, CJK and emoji (surrogate pairs) */
+static void bench_generate_escapes(bench_corpus* corpus) {
+    bench_buffer b = { NULL, 0, 0 };
+    char s[16];
+    int i, j;
+    bench_buffer_write(&b, "[", 1);
+    for (i = 0; i < 64; i++) {
+        bench_buffer_write(&b, i ? ",\"" : "\"", i ? 2 : 1);
+        for (j = 0; j < 2048; j++) {
+            double r = bench_random();
+            if (r < 0.8)
+                sprintf(s, "\\u%04x", 0x4e00 + (unsigned)(r * 0x6400));
+            else
+                sprintf(s, "\\ud83d\\u%04x", 0xde00 + (unsigned)((r - 0.8) * 400));
+            bench_buffer_write(&b, s, strlen(s));
+        }
+        bench_buffer_write(&b, "\"", 1);
+    }
+    bench_buffer_write(&b, "]", 1);
+    corpus->name = "escapes";
+    corpus->json = b.s;
+    corpus->len = b.len;
+}
+
+static void bench_generate(bench_corpus* corpus, const char* name, void (*generate)(lept_writer*)) {
+    bench_buffer b = { NULL, 0, 0 };
+    lept_writer* w = lept_writer_create(bench_buffer_write, &b, 0);
+    generate(w);
+    lept_writer_flush(w);
+    lept_writer_destroy(w);
+    corpus->name = name;
+    corpus->json = b.s;
+    corpus->len = b.len;
+}
+
+static int bench_read(bench_corpus* corpus, const char* path) {
+    FILE* fp = fopen(path, "rb");
+    long len;
+    if (!fp)
+        return 0;
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    corpus->name = path;
+    corpus->json = (char*)malloc(len > 0 ? len : 1);
+    corpus->len = fread(corpus->json, 1, len > 0 ? len : 0, fp);
+    fclose(fp);
+    return 1;
+}
+
+/* a baseline is what -o wrote: corpus, operation and MB/s on each line, tab separated */
+typedef struct {
+    char name[256], op[16];
+    double speed;
+}bench_result;
+
+static bench_result* bench_baseline;
+static size_t bench_baseline_size;
+static FILE* bench_output;
+static double bench_tolerance = BENCH_TOLERANCE;
+static int bench_regressions;
+
+static int bench_load(const char* path) {
+    FILE* fp = fopen(path, "r");
+    char line[512], *op, *speed;
+    size_t capacity = 0;
+    if (!fp)
+        return 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (!(op = strchr(line, '\t')) || !(speed = strchr(op + 1, '\t')))
+            continue;
+        *op++ = *speed++ = '\0';
+        if (bench_baseline_size == capacity)
+            bench_baseline = (bench_result*)realloc(bench_baseline, (capacity += 64) * sizeof(bench_result));
+        sprintf(bench_baseline[bench_baseline_size].name, "%.255s", line);
+        sprintf(bench_baseline[bench_baseline_size].op, "%.15s", op);
+        bench_baseline[bench_baseline_size++].speed = atof(speed);
+    }
+    fclose(fp);
+    return 1;
+}
+
+static void bench_record(const char* name, const char* op, double speed) {
+    size_t i;
+    if (bench_output)
+        fprintf(bench_output, "%s\t%s\t%.1f\n", name, op, speed);
+    for (i = 0; i < bench_baseline_size; i++)
+        if (strcmp(bench_baseline[i].name, name) == 0 && strcmp(bench_baseline[i].op, op) == 0 &&
+            speed < bench_baseline[i].speed * (1.0 - bench_tolerance / 100.0)) {
+            printf("%-24s %-10s %.1f MB/s is %.1f%% below the baseline of %.1f MB/s\n",
+                name, op, speed, 100.0 - speed * 100.0 / bench_baseline[i].speed, bench_baseline[i].speed);
+            bench_regressions++;
+        }
+}
+
+enum { BENCH_PARSE, BENCH_INDEXED, BENCH_PARALLEL, BENCH_LAZY, BENCH_SAX, BENCH_TAPE, BENCH_STRINGIFY, BENCH_DECODE, BENCH_VIEW };
+
+/* data is v encoded, decoding is measured against the size of the JSON too */
+static int bench_run(const bench_corpus* corpus, int op, const lept_value* v, lept_tape* t, const char* data, size_t len) {
+    static const lept_handler h = { NULL };
+    lept_value v2;
+    char* json;
+    switch (op) {
+        case BENCH_PARSE:
+            lept_init(&v2);
+            if (lept_parse_n(&v2, corpus->json, corpus->len) != LEPT_PARSE_OK)
+                return 0;
+            lept_free(&v2);
+            return 1;
+        case BENCH_INDEXED:
+            if (lept_parse_indexed(&v2, corpus->json, corpus->len) != LEPT_PARSE_OK)
+                return 0;
+            lept_free(&v2);
+            return 1;
+        case BENCH_PARALLEL:
+            if (lept_parse_parallel(&v2, corpus->json, corpus->len, BENCH_THREADS) != LEPT_PARSE_OK)
+                return 0;
+            lept_free(&v2);
+            return 1;
+        case BENCH_LAZY:
+            if (lept_parse_lazy(&v2, corpus->json, corpus->len) != LEPT_PARSE_OK)
+                return 0;
+            lept_free(&v2);
+            return 1;
+        case BENCH_SAX:
+            return lept_parse_sax(corpus->json, corpus->len, &h, NULL) == LEPT_PARSE_OK;
+        case BENCH_TAPE:
+            return lept_tape_parse(t, corpus->json, corpus->len) == LEPT_PARSE_OK;
+        case BENCH_STRINGIFY:
+            if (lept_stringify(v, &json, NULL) != LEPT_STRINGIFY_OK)
+                return 0;
+            free(json);
+            return 1;
+        default:
+            if ((op == BENCH_DECODE ? lept_decode(&v2, data, len) : lept_decode_view(&v2, data, len)) != LEPT_PARSE_OK)
+                return 0;
+            lept_free(&v2);
+            return 1;
+    }
+}
+
+/* reports the fastest of the timed iterations, the one least disturbed by the machine */
+static void bench_corpus_run(const bench_corpus* corpus, int warmup, int iterations) {
+    static const char* ops[] = { "parse", "indexed", "parallel", "lazy", "sax", "tape", "stringify", "decode", "view" };
+    lept_value v;
+    lept_tape* t = lept_tape_create();
+    char* data;
+    size_t len;
+    int op, i;
+    lept_init(&v);
+    if (lept_parse_n(&v, corpus->json, corpus->len) != LEPT_PARSE_OK) {
+        printf("%-24s does not parse, skipped\n", corpus->name);
+        lept_tape_destroy(t);
+        return;
+    }
+    lept_encode(&v, &data, &len);
+    for (op = BENCH_PARSE; op <= BENCH_VIEW; op++) {
+        double best = 0.0;
+        unsigned long allocs;
+        for (i = 0; i < warmup; i++)
+            bench_run(corpus, op, &v, t, data, len);
+        allocs = bench_allocs;
+        for (i = 0; i < iterations; i++) {
+            double start = bench_now(), elapsed;
+            bench_run(corpus, op, &v, t, data, len);
+            elapsed = bench_now() - start;
+            if (i == 0 || elapsed < best)
+                best = elapsed;
+        }
+        allocs = (bench_allocs - allocs) / (iterations > 0 ? iterations : 1);
+        if (best <= 0.0)
+            best = 1e-9;
+        printf("%-24s %9.2f MB %-10s %10.1f MB/s %10.1f docs/s %10lu allocs/doc\n",
+            corpus->name, corpus->len / 1048576.0, ops[op], corpus->len / 1048576.0 / best, 1.0 / best, allocs);
+        bench_record(corpus->name, ops[op], corpus->len / 1048576.0 / best);
+    }
+    free(data);
+    lept_free(&v);
+    lept_tape_destroy(t);
+}
+
+static void bench_usage(void) {
+    fprintf(stderr,
+        "usage: leptjson_bench [-w warmup] [-n iterations] [-o results] [-b baseline [-t percent]]\n"
+        "                      [file.json ...]\n"
+        "without files it runs generated corpora, pass twitter.json, canada.json,\n"
+        "citm_catalog.json and the like to measure those. -o saves the throughput, a later\n"
+        "run given it by -b fails when one falls more than percent (default 10) below it.\n");
+}
+
+int main(int argc, char* argv[]) {
+    static const lept_allocator counting = { bench_malloc, bench_realloc, bench_free, NULL };
+    bench_corpus corpus;
+    int warmup = BENCH_WARMUP, iterations = BENCH_ITERATIONS, files = 0, i;
+#ifdef BENCH_RUSAGE
+    struct rusage usage;
+#endif
+    lept_set_allocator(&counting);
+    /* options apply wherever they are given, before or after the files */
+    for (i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "-n") == 0) && i + 1 < argc) {
+            *(argv[i][1] == 'w' ? &warmup : &iterations) = atoi(argv[i + 1]);
+            i++;
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            if ((bench_output = fopen(argv[++i], "w")) == NULL) {
+                fprintf(stderr, "cannot write %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            if (!bench_load(argv[++i])) {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            bench_tolerance = atof(argv[++i]);
+        else if (argv[i][0] == '-') {
+            bench_usage();
+            return 1;
+        }
+        else
+            argv[1 + files++] = argv[i];    /* files run once every option is known */
+    }
+    for (i = 1; i <= files; i++) {
+        if (!bench_read(&corpus, argv[i])) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        bench_corpus_run(&corpus, warmup, iterations);
+        free(corpus.json);
+    }
+    if (files == 0) {
+        static const struct { const char* name; void (*generate)(lept_writer*); } generated[] = {
+            { "numbers", bench_generate_numbers },
+            { "objects", bench_generate_objects },
+            { "strings", bench_generate_strings }
+        };
+        for (i = 0; i < (int)(sizeof(generated) / sizeof(generated[0])); i++) {
+            bench_generate(&corpus, generated[i].name, generated[i].generate);
+            bench_corpus_run(&corpus, warmup, iterations);
+            free(corpus.json);
+        }
+        /* compare with strings, escapes should not fall far behind */
+        bench_generate_escapes(&corpus);
+        bench_corpus_run(&corpus, warmup, iterations);
+        free(corpus.json);
+    }
+#ifdef BENCH_RUSAGE
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+#ifdef __APPLE__
+        printf("peak RSS %ld KB\n", (long)usage.ru_maxrss / 1024);
+#else
+        printf("peak RSS %ld KB\n", (long)usage.ru_maxrss);
+#endif
+#endif
+    if (bench_output)
+        fclose(bench_output);
+    free(bench_baseline);
+    return bench_regressions != 0;
+}
@@ -0,0 +1,429 @@
+#include <stddef.h>  /* size_t */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "leptjson.h"
+
+/*
+ * Differential test: random documents, and any files given, go through every engine and each
+ * result is held to lept_parse_n(), values and error codes alike. A generated document is
+ * also written out the way it was meant, through lept_writer, and lept_parse_n() is held to
+ * that, so the reference itself is checked against text it did not read.
+ */
+#define DIFF_DOCUMENTS 5000
+#define DIFF_MUTATIONS 64   /* damaged copies of each file */
+#define DIFF_REPORTS 10     /* mismatches printed in full */
+
+typedef struct {
+    char* s;
+    size_t len, size;
+}diff_buffer;
+
+static uint32_t diff_seed = 2463534242u;
+static unsigned long diff_mismatches;
+
+static int diff_buffer_write(void* ctx, const char* buf, size_t len) {
+    diff_buffer* b = (diff_buffer*)ctx;
+    if (b->len + len >= b->size) {
+        while (b->len + len >= b->size)
+            b->size = b->size ? b->size + (b->size >> 1) : 4096;
+        b->s = (char*)realloc(b->s, b->size);
+    }
+    memcpy(b->s + b->len, buf, len);
+    b->len += len;
+    return 0;
+}
+
+static void diff_put(diff_buffer* b, const char* s) {
+    diff_buffer_write(b, s, strlen(s));
+}
+
+static unsigned diff_random(unsigned n) {
+    diff_seed ^= diff_seed << 13;
+    diff_seed ^= diff_seed >> 17;
+    diff_seed ^= diff_seed << 5;
+    return (unsigned)(diff_seed % n);
+}
+
+/* mostly none, sometimes a run long enough to cross a SIMD block */
+static void diff_space(diff_buffer* text) {
+    static const char* spaces = " \t\n\r";
+    unsigned n = diff_random(4) ? 0 : diff_random(8) ? 1 + diff_random(3) : 64 + diff_random(100);
+    while (n--)
+        diff_buffer_write(text, spaces + diff_random(4), 1);
+}
+
+static void diff_number(diff_buffer* text, lept_writer* w) {
+    char s[64];
+    size_t n = 0;
+    int integer = 1, digits;
+    if (!diff_random(4))
+        s[n++] = '-';
+    if (!diff_random(5))
+        s[n++] = '0';
+    else
+        for (s[n++] = (char)('1' + diff_random(9)), digits = diff_random(18); digits > 0; digits--)
+            s[n++] = (char)('0' + diff_random(10));
+    if (!diff_random(3)) {
+        integer = 0;
+        s[n++] = '.';
+        for (digits = 1 + diff_random(20); digits > 0; digits--)
+            s[n++] = (char)('0' + diff_random(10));
+    }
+    if (!diff_random(4)) {
+        /* three digits only downwards, to subnormals and zero, never out of range */
+        int big = !diff_random(8);
+        integer = 0;
+        s[n++] = diff_random(2) ? 'e' : 'E';
+        if (big || !diff_random(3))
+            s[n++] = big || diff_random(2) ? '-' : '+';
+        for (digits = big ? 3 : 1 + diff_random(2); digits > 0; digits--)
+            s[n++] = (char)('0' + diff_random(10));
+    }
+    s[n] = '\0';
+    diff_put(text, s);
+    if (integer && strcmp(s, "-0") != 0) {
+        int64_t i = 0;
+        size_t j;
+        for (j = s[0] == '-'; j < n; j++)
+            i = i * 10 + (s[j] - '0');
+        lept_writer_int64(w, s[0] == '-' ? -i : i);
+    }
+    else
+        lept_writer_number(w, strtod(s, NULL));
+}
+
+static void diff_escape(diff_buffer* text, unsigned u) {
+    char s[8];
+    sprintf(s, diff_random(2) ? "\\u%04x" : "\\u%04X", u);
+    diff_put(text, s);
+}
+
+/* the string's bytes go to s, which holds 4 per code point and 16 more */
+static size_t diff_string(diff_buffer* text, char* s, size_t count) {
+    static const char* shorts = "\"\\/\b\f\n\r\t", *letters = "\"\\/bfnrt";
+    size_t len = 0;
+    diff_put(text, "\"");
+    while (count--) {
+        unsigned r = diff_random(24), u;
+        size_t start = len;
+        const char* e;
+        if (r == 0)
+            u = diff_random(0x20);
+        else if (r == 1)
+            u = diff_random(2) ? '\"' : '\\';
+        else if (r == 2)
+            u = 0x80 + diff_random(0x800 - 0x80);
+        else if (r == 3)
+            do u = 0x800 + diff_random(0x10000 - 0x800); while (u >= 0xD800 && u <= 0xDFFF);
+        else if (r == 4)
+            u = 0x10000 + diff_random(0x110000 - 0x10000);
+        else
+            u = ' ' + diff_random(0x7F - ' ');
+        if (u < 0x80)
+            s[len++] = (char)u;
+        else if (u < 0x800) {
+            s[len++] = (char)(0xC0 | u >> 6);
+            s[len++] = (char)(0x80 | (u & 0x3F));
+        }
+        else if (u < 0x10000) {
+            s[len++] = (char)(0xE0 | u >> 12);
+            s[len++] = (char)(0x80 | (u >> 6 & 0x3F));
+            s[len++] = (char)(0x80 | (u & 0x3F));
+        }
+        else {
+            s[len++] = (char)(0xF0 | u >> 18);
+            s[len++] = (char)(0x80 | (u >> 12 & 0x3F));
+            s[len++] = (char)(0x80 | (u >> 6 & 0x3F));
+            s[len++] = (char)(0x80 | (u & 0x3F));
+        }
+        /* what has to be escaped is, the rest now and then */
+        if (u < 0x20 || u == '\"' || u == '\\' || !diff_random(8)) {
+            if (u > 0 && u < 0x80 && (e = strchr(shorts, (int)u)) != NULL && diff_random(4)) {
+                char pair[3] = { '\\', 0, 0 };
+                pair[1] = letters[e - shorts];
+                diff_put(text, pair);
+            }
+            else if (u >= 0x10000) {
+                diff_escape(text, 0xD800 + ((u - 0x10000) >> 10));
+                diff_escape(text, 0xDC00 + ((u - 0x10000) & 0x3FF));
+            }
+            else
+                diff_escape(text, u);
+        }
+        else
+            diff_buffer_write(text, s + start, len - start);
+    }
+    diff_put(text, "\"");
+    return len;
+}
+
+static size_t diff_string_length(void) {
+    return diff_random(8) ? diff_random(20) : 64 + diff_random(300);
+}
+
+static void diff_value(diff_buffer* text, lept_writer* w, char* s, int depth) {
+    size_t n, i, len;
+    diff_space(text);
+    switch (diff_random(depth < 5 ? 9 : 6)) {
+        case 0: diff_put(text, "null"); lept_writer_null(w); break;
+        case 1: diff_put(text, "true"); lept_writer_boolean(w, 1); break;
+        case 2: diff_put(text, "false"); lept_writer_boolean(w, 0); break;
+        case 3:
+        case 4: diff_number(text, w); break;
+        case 5:
+            len = diff_string(text, s, diff_string_length());
+            lept_writer_string(w, s, len);
+            break;
+        case 6:
+        case 7:
+            diff_put(text, "[");
+            lept_writer_start_array(w);
+            for (i = 0, n = diff_random(7); i < n; i++) {
+                if (i) {
+                    diff_space(text);
+                    diff_put(text, ",");
+                }
+                diff_value(text, w, s, depth + 1);
+            }
+            diff_space(text);
+            diff_put(text, "]");
+            lept_writer_end_array(w);
+            break;
+        default:
+            diff_put(text, "{");
+            lept_writer_start_object(w);
+            for (i = 0, n = diff_random(7); i < n; i++) {
+                char suffix[32];
+                if (i)
+                    diff_put(text, ",");
+                diff_space(text);
+                /* keys are kept apart by a suffix, every engine reads members in order anyway */
+                len = diff_string(text, s, diff_random(12));
+                text->len--;
+                sprintf(suffix, "#%lu\"", (unsigned long)i);
+                diff_put(text, suffix);
+                memcpy(s + len, suffix, strlen(suffix) - 1);
+                lept_writer_key(w, s, len + strlen(suffix) - 1);
+                diff_space(text);
+                diff_put(text, ":");
+                diff_value(text, w, s, depth + 1);
+            }
+            diff_space(text);
+            diff_put(text, "}");
+            lept_writer_end_object(w);
+    }
+    diff_space(text);
+}
+
+/* one in this many is an array long enough for lept_parse_parallel() to split */
+#define DIFF_LARGE 64
+
+static void diff_generate(diff_buffer* text, diff_buffer* expect, int large) {
+    static char s[4 * 400 + 16];
+    lept_writer* w = lept_writer_create(diff_buffer_write, expect, 0);
+    text->len = expect->len = 0;
+    if (large) {
+        size_t i;
+        diff_put(text, "[");
+        lept_writer_start_array(w);
+        for (i = 0; i < 1000; i++) {
+            if (i)
+                diff_put(text, ",");
+            diff_value(text, w, s, 1);
+        }
+        diff_put(text, "]");
+        lept_writer_end_array(w);
+    }
+    else
+        diff_value(text, w, s, 0);
+    lept_writer_flush(w);
+    lept_writer_destroy(w);
+}
+
+enum {
+    DIFF_INSITU, DIFF_ARENA, DIFF_LAZY, DIFF_INDEXED, DIFF_PARALLEL, DIFF_PARSER, DIFF_PARSER_INDEXED,
+    DIFF_FEED, DIFF_SAX, DIFF_TAPE, DIFF_DECODE, DIFF_VIEW, DIFF_ENGINES
+};
+
+static const char* diff_engines[] = {
+    "insitu", "arena", "lazy", "indexed", "parallel", "parser", "parser indexed",
+    "feed", "sax", "tape", "decode", "view"
+};
+
+typedef struct {
+    lept_parser* p;
+    lept_arena* a;
+    lept_tape* t;
+    diff_buffer copy;
+}diff_state;
+
+static void diff_report(const char* engine, const char* what, const char* json, size_t len) {
+    if (diff_mismatches++ < DIFF_REPORTS)
+        printf("%s: %s for %lu bytes: %.*s%s\n",
+            engine, what, (unsigned long)len, len > 200 ? 200 : (int)len, json, len > 200 ? "..." : "");
+}
+
+static int diff_same(const lept_value* v, const char* expect, size_t len) {
+    char* json;
+    size_t n;
+    int same;
+    if (lept_stringify(v, &json, &n) != LEPT_STRINGIFY_OK)
+        return 0;
+    same = n == len && memcmp(json, expect, len) == 0;
+    free(json);
+    return same;
+}
+
+/* the value an engine built, or none for the engines that only report an error */
+static int diff_run(diff_state* s, int engine, lept_value* v, const char* json, size_t len, const char* data, size_t size) {
+    static const lept_handler h = { NULL };
+    int ret = LEPT_PARSE_OK;
+    size_t i, chunk;
+    lept_init(v);
+    switch (engine) {
+        case DIFF_INSITU:
+            s->copy.len = 0;
+            diff_buffer_write(&s->copy, json, len);
+            return lept_parse_insitu(v, s->copy.s, len);
+        case DIFF_ARENA: return lept_parse_arena(v, json, len, s->a);
+        case DIFF_LAZY: return lept_parse_lazy(v, json, len);
+        case DIFF_INDEXED: return lept_parse_indexed(v, json, len);
+        case DIFF_PARALLEL: return lept_parse_parallel(v, json, len, 4);
+        case DIFF_PARSER: return lept_parser_parse(s->p, v, json, len);
+        case DIFF_PARSER_INDEXED: return lept_parser_parse_indexed(s->p, v, json, len);
+        case DIFF_FEED:
+            chunk = 1 + diff_random(64);
+            for (i = 0; i < len && ret == LEPT_PARSE_OK; i += chunk)
+                ret = lept_parser_feed(s->p, json + i, len - i < chunk ? len - i : chunk);
+            return lept_parser_finish(s->p, v);
+        case DIFF_SAX: return lept_parse_sax(json, len, &h, NULL);
+        case DIFF_TAPE: return lept_tape_parse(s->t, json, len);
+        case DIFF_DECODE: return lept_decode(v, data, size);
+        default: return lept_decode_view(v, data, size);
+    }
+}
+
+/* expect, when not NULL, is how the document was meant to read */
+static void diff_check(diff_state* s, const char* json, size_t len, const diff_buffer* expect) {
+    lept_value e, v;
+    char* ref = NULL, *data = NULL;
+    size_t n = 0, size = 0;
+    int error, engine;
+    lept_init(&e);
+    error = lept_parse_n(&e, json, len);
+    if (expect && (error != LEPT_PARSE_OK || !diff_same(&e, expect->s, expect->len)))
+        diff_report("parse", error != LEPT_PARSE_OK ? "error" : "value unlike the generated", json, len);
+    if (error == LEPT_PARSE_OK) {
+        lept_stringify(&e, &ref, &n);
+        lept_encode(&e, &data, &size);
+    }
+    for (engine = 0; engine < DIFF_ENGINES; engine++) {
+        int ret;
+        if ((engine == DIFF_DECODE || engine == DIFF_VIEW) && error != LEPT_PARSE_OK)
+            continue;
+        ret = diff_run(s, engine, &v, json, len, data, size);
+        /* lazy numbers out of range read as infinity, the lazy parse goes on past them */
+        if (engine == DIFF_LAZY && error == LEPT_PARSE_NUMBER_TOO_BIG)
+            ;
+        else if (ret != error)
+            diff_report(diff_engines[engine], "another error", json, len);
+        else if (error == LEPT_PARSE_OK && engine != DIFF_SAX && engine != DIFF_TAPE && !diff_same(&v, ref, n))
+            diff_report(diff_engines[engine], "another value", json, len);
+        lept_free(&v);
+    }
+    lept_arena_reset(s->a);
+    free(ref);
+    free(data);
+    lept_free(&e);
+}
+
+/* damage: a byte overwritten, dropped or the document cut short */
+static size_t diff_mutate(char* json, size_t len) {
+    static const char bytes[] = "[]{},:\"\\ 0-e.tu\x01\x80\xC3\xFF";
+    size_t i, m = 1 + diff_random(3);
+    if (len == 0)
+        return len;
+    while (m-- && len) {
+        i = diff_random((unsigned)len);
+        switch (diff_random(3)) {
+            case 0: json[i] = bytes[diff_random(sizeof(bytes) - 1)]; break;
+            case 1: memmove(json + i, json + i + 1, len - i - 1); len--; break;
+            default: len = i;
+        }
+    }
+    return len;
+}
+
+static int diff_read(diff_buffer* b, const char* path) {
+    FILE* fp = fopen(path, "rb");
+    char buf[65536];
+    size_t n;
+    if (!fp)
+        return 0;
+    b->len = 0;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) != 0)
+        diff_buffer_write(b, buf, n);
+    fclose(fp);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    diff_buffer text = { NULL, 0, 0 }, expect = { NULL, 0, 0 }, damaged = { NULL, 0, 0 };
+    diff_state s;
+    unsigned long documents = DIFF_DOCUMENTS, i, checked = 0;
+    int a, j;
+    s.p = lept_parser_create();
+    s.a = lept_arena_create(0);
+    s.t = lept_tape_create();
+    s.copy.s = NULL;
+    s.copy.len = s.copy.size = 0;
+    for (a = 1; a < argc; a++) {
+        if ((strcmp(argv[a], "-n") == 0 || strcmp(argv[a], "-s") == 0) && a + 1 < argc) {
+            if (argv[a][1] == 'n')
+                documents = strtoul(argv[a + 1], NULL, 10);
+            else
+                diff_seed = (uint32_t)strtoul(argv[a + 1], NULL, 10) | 1;
+            a++;
+        }
+        else if (argv[a][0] == '-') {
+            fprintf(stderr,
+                "usage: leptjson_difftest [-n documents] [-s seed] [file.json ...]\n"
+                "checks every engine against lept_parse_n() on random documents and on the\n"
+                "files, each file also damaged in a few places.\n");
+            return 1;
+        }
+        else if (diff_read(&text, argv[a])) {
+            diff_check(&s, text.s, text.len, NULL);
+            for (j = 0; j < DIFF_MUTATIONS; j++) {
+                damaged.len = 0;
+                diff_buffer_write(&damaged, text.s, text.len);
+                diff_check(&s, damaged.s, diff_mutate(damaged.s, damaged.len), NULL);
+            }
+            checked += 1 + DIFF_MUTATIONS;
+        }
+        else {
+            fprintf(stderr, "cannot read %s\n", argv[a]);
+            return 1;
+        }
+    }
+    for (i = 0; i < documents; i++) {
+        diff_generate(&text, &expect, i % DIFF_LARGE == DIFF_LARGE - 1);
+        diff_check(&s, text.s, text.len, &expect);
+        if (diff_random(3) == 0) {
+            diff_check(&s, text.s, diff_mutate(text.s, text.len), NULL);
+            checked++;
+        }
+        checked++;
+    }
+    printf("%lu documents through %d engines, %lu mismatches\n", checked, DIFF_ENGINES, diff_mismatches);
+    free(text.s);
+    free(expect.s);
+    free(damaged.s);
+    free(s.copy.s);
+    lept_tape_destroy(s.t);
+    lept_arena_destroy(s.a);
+    lept_parser_destroy(s.p);
+    return diff_mismatches != 0;
+}
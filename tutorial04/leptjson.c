@@ -2,37 +2,442 @@
 #define _CRTDBG_MAP_ALLOC
 #include <crtdbg.h>
 #endif
+#if defined(_WIN32)
+#include <windows.h> /* CreateFileMappingA(), MapViewOfFile(), CreateThread() */
+#define LEPT_WIN32
+#elif defined(__unix__) || defined(__APPLE__)
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+#include <fcntl.h>     /* open() */
+#include <pthread.h>   /* pthread_create(), pthread_join() */
+#include <sys/mman.h>  /* mmap(), posix_madvise() */
+#include <sys/stat.h>  /* fstat() */
+#include <unistd.h>    /* close() */
+#define LEPT_POSIX
+#else
+#include <stdio.h>     /* fopen(), fread() */
+#endif
 #include "leptjson.h"
 #include <assert.h>  /* assert() */
-#include <errno.h>   /* errno, ERANGE */
-#include <math.h>    /* HUGE_VAL */
-#include <stdlib.h>  /* NULL, malloc(), realloc(), free(), strtod() */
-#include <string.h>  /* memcpy() */
+#include <stddef.h>  /* offsetof() */
+#include <stdint.h>  /* uint32_t, uint64_t */
+#include <stdlib.h>  /* NULL, malloc(), realloc(), free() */
+#include <string.h>  /* memcpy(), strlen() */
+
+#ifndef LEPT_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LEPT_SIMD_AVX2
+#define LEPT_SIMD_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LEPT_SIMD_SSE2
+#elif defined(__ARM_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+#define LEPT_SIMD_NEON
+#endif
+#endif
+
+/* _mm_shuffle_epi8() for the UTF-8 validator, AVX2 has its own */
+#if defined(LEPT_SIMD_SSE2) && !defined(LEPT_SIMD_AVX2) && defined(__SSSE3__)
+#include <tmmintrin.h>
+#define LEPT_SIMD_SSSE3
+#endif
+
+#if defined(LEPT_SIMD_SSE2) && defined(__PCLMUL__) && defined(__x86_64__)
+#include <wmmintrin.h>
+#define LEPT_SIMD_CLMUL
+#endif
+
+#if defined(LEPT_SIMD_SSE2) || defined(LEPT_SIMD_NEON)
+#if defined(_MSC_VER)
+#include <intrin.h>  /* _BitScanForward() */
+#pragma intrinsic(_BitScanForward)
+#endif
+#endif
+
+#ifdef LEPT_STATS
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>  /* __rdtsc() */
+#define lept_ticks() ((uint64_t)__rdtsc())
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>  /* __rdtsc() */
+#define lept_ticks() ((uint64_t)__rdtsc())
+#else
+#include <time.h>    /* clock_gettime(), clock() */
+static uint64_t lept_ticks(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#else
+    return (uint64_t)clock();
+#endif
+}
+#endif
+#endif
+
+static void* lept_default_malloc(void* ctx, size_t size) { (void)ctx; return malloc(size); }
+static void* lept_default_realloc(void* ctx, void* ptr, size_t size) { (void)ctx; return realloc(ptr, size); }
+static void lept_default_free(void* ctx, void* ptr) { (void)ctx; free(ptr); }
+
+static lept_allocator lept_allocator_current = { lept_default_malloc, lept_default_realloc, lept_default_free, NULL };
+
+/* replace all three together to bypass lept_set_allocator(), lept_stringify() results are then released with LEPT_FREE() */
+#ifndef LEPT_MALLOC
+#define LEPT_MALLOC(size)       lept_allocator_current.malloc_func(lept_allocator_current.ctx, size)
+#define LEPT_REALLOC(ptr, size) lept_allocator_current.realloc_func(lept_allocator_current.ctx, ptr, size)
+#define LEPT_FREE(ptr)          lept_allocator_current.free_func(lept_allocator_current.ctx, ptr)
+#endif
+
+void lept_set_allocator(const lept_allocator* a) {
+    if (a) {
+        assert(a->malloc_func != NULL && a->realloc_func != NULL && a->free_func != NULL);
+        lept_allocator_current = *a;
+    }
+    else {
+        lept_allocator_current.malloc_func = lept_default_malloc;
+        lept_allocator_current.realloc_func = lept_default_realloc;
+        lept_allocator_current.free_func = lept_default_free;
+        lept_allocator_current.ctx = NULL;
+    }
+}
+
+#ifndef LEPT_PARSE_MAX_DEPTH
+#define LEPT_PARSE_MAX_DEPTH 512
+#endif
+
+#ifndef LEPT_PARSE_FRAMES
+#define LEPT_PARSE_FRAMES 32 /* open containers tracked without allocating */
+#endif
 
 #ifndef LEPT_PARSE_STACK_INIT_SIZE
 #define LEPT_PARSE_STACK_INIT_SIZE 256
 #endif
 
+#ifndef LEPT_PARSE_STRINGIFY_INIT_SIZE
+#define LEPT_PARSE_STRINGIFY_INIT_SIZE 256
+#endif
+
+#ifndef LEPT_WRITER_BUFFER_SIZE
+#define LEPT_WRITER_BUFFER_SIZE 4096
+#endif
+
+#ifndef LEPT_STREAM_DEPTH_INIT_SIZE
+#define LEPT_STREAM_DEPTH_INIT_SIZE 16
+#endif
+
+#ifndef LEPT_TAPE_INIT_SIZE
+#define LEPT_TAPE_INIT_SIZE 256
+#endif
+
+#ifndef LEPT_THREAD_PART_SIZE
+#define LEPT_THREAD_PART_SIZE 65536 /* the least input worth a thread */
+#endif
+
+#ifndef LEPT_STATS_SAMPLE
+#define LEPT_STATS_SAMPLE 64 /* one parse in this many is timed, 0 for none */
+#endif
+
+#ifndef LEPT_ARENA_BLOCK_SIZE
+#define LEPT_ARENA_BLOCK_SIZE 4096
+#endif
+
+#if defined(LEPT_SIMD_SSE2) || defined(LEPT_SIMD_NEON)
+#if defined(__GNUC__)
+#define LEPT_CTZ(x)         ((unsigned)__builtin_ctz(x))
+#else
+static unsigned LEPT_CTZ(unsigned x) { unsigned long i; _BitScanForward(&i, x); return (unsigned)i; }
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define LEPT_CTZ64(x)       ((unsigned)__builtin_ctzll(x))
+#else
+static unsigned LEPT_CTZ64(uint64_t x) {
+    unsigned n = 0;
+    if (!(x & 0xFFFFFFFFu)) { n += 32; x >>= 32; }
+    if (!(x & 0xFFFF)) { n += 16; x >>= 16; }
+    if (!(x & 0xFF)) { n += 8; x >>= 8; }
+    if (!(x & 0xF)) { n += 4; x >>= 4; }
+    if (!(x & 0x3)) { n += 2; x >>= 2; }
+    return n + !(x & 1);
+}
+#endif
+
+#define LEPT_VALUE_EXTERNAL 0x01 /* payload lives in an arena or the input, lept_free() must not release it */
+#define LEPT_VALUE_INT64    0x02 /* number is stored in u.i */
+#define LEPT_VALUE_SHORT    0x04 /* string is stored in u.ss */
+#define LEPT_VALUE_LAZY     0x08 /* u.s spans the source text of a number or an escape-free string */
+#define LEPT_VALUE_INDEXED  0x10 /* a hash index of the keys follows the members of an object */
+
+#define LEPT_SHORT_STRING_MAX (sizeof(((lept_value*)0)->u.ss) - 2)
+
+#ifndef LEPT_OBJECT_INDEX_MIN
+#define LEPT_OBJECT_INDEX_MIN 16 /* smaller objects are scanned, indexing them does not pay */
+#endif
+
 #define EXPECT(c, ch)       do { assert(*c->json == (ch)); c->json++; } while(0)
 #define ISDIGIT(ch)         ((ch) >= '0' && (ch) <= '9')
 #define ISDIGIT1TO9(ch)     ((ch) >= '1' && (ch) <= '9')
+#define ISWHITESPACE(ch)    ((ch) == ' ' || (ch) == '\t' || (ch) == '\n' || (ch) == '\r')
+#define PEEK(c, p)          ((p) != (c)->end ? *(p) : '\0')
 #define PUTC(c, ch)         do { *(char*)lept_context_push(c, sizeof(char)) = (ch); } while(0)
+#define PUTS(c, s, len)     memcpy(lept_context_push(c, len), s, len)
+#define LEPT_EMIT(c, cb, args) ((c)->handler->cb && (c)->handler->cb args ? LEPT_PARSE_ABORTED : LEPT_PARSE_OK)
+
+typedef union {
+    void* p;
+    double n;
+    size_t s;
+}lept_arena_align;
+
+typedef struct lept_arena_block {
+    struct lept_arena_block* next;
+    size_t size, used;
+    lept_arena_align data[1];
+}lept_arena_block;
+
+struct lept_arena {
+    lept_arena_block* head;
+    size_t block_size;
+};
+
+/*
+ * The index of the two-stage parser: the offset of every token outside strings in document
+ * order, quotation marks both opening and closing, and finally the length of the input.
+ */
+#define LEPT_TOKEN_DIRTY 0x80000000u /* on a closing quotation mark: escapes or control characters inside */
+
+typedef struct {
+    const char* base;
+    uint32_t* pos;
+    size_t size, capacity, next;    /* next: no token before it is ahead of the parser */
+}lept_tokens;
 
 typedef struct {
     const char* json;
+    const char* end;
     char* stack;
     size_t size, top;
+    lept_arena* arena;
+    int insitu;
+    int lazy;   /* numbers and escape-free strings left undecoded, see lept_materialize() */
+    int utf8;   /* strings must be well-formed UTF-8 */
+    int index;  /* wide objects get a hash index, see lept_index_slots() */
+    size_t max_depth;   /* open arrays and objects at most */
+    lept_tokens* tokens;    /* NULL unless parsing with a structural index */
+    lept_stats* stats;  /* NULL unless counting, which needs LEPT_STATS and a handler */
+#ifdef LEPT_STATS
+    lept_stats counted;
+    uint64_t started[LEPT_PHASE_COUNT];
+#endif
+    const lept_handler* handler;
+    void* handler_ctx;
 }lept_context;
 
+/* an empty stack and the defaults, entry points then set what they do differently */
+static void lept_context_init(lept_context* c, lept_arena* a) {
+    c->json = c->end = NULL;
+    c->stack = NULL;
+    c->size = c->top = 0;
+    c->arena = a;
+    c->insitu = 0;
+    c->lazy = 0;
+    c->utf8 = 0;
+    c->index = 0;
+    c->max_depth = LEPT_PARSE_MAX_DEPTH;
+    c->tokens = NULL;
+    c->stats = NULL;
+    c->handler = NULL;
+    c->handler_ctx = NULL;
+}
+
+/* every counter takes a statement, none of them is compiled without LEPT_STATS */
+#ifdef LEPT_STATS
+#define LEPT_STATS_ADD(c, counter, n) do { if ((c)->stats) (c)->stats->counter += (n); } while(0)
+#define LEPT_STATS_START(c, phase)\
+    do { if ((c)->stats && (c)->stats->timed) (c)->started[phase] = lept_ticks(); } while(0)
+#define LEPT_STATS_STOP(c, phase)\
+    do { if ((c)->stats && (c)->stats->timed) (c)->stats->ticks[phase] += lept_ticks() - (c)->started[phase]; } while(0)
+#else
+#define LEPT_STATS_ADD(c, counter, n)   do { } while(0)
+#define LEPT_STATS_START(c, phase)      do { } while(0)
+#define LEPT_STATS_STOP(c, phase)       do { } while(0)
+#endif
+
+#ifdef LEPT_STATS
+#define LEPT_STATS_BEGIN(c)             lept_stats_begin(c)
+#define LEPT_STATS_END(c, json, ret)    lept_stats_end(c, json, ret)
+#else
+#define LEPT_STATS_BEGIN(c)             do { } while(0)
+#define LEPT_STATS_END(c, json, ret)    do { } while(0)
+#endif
+
+enum {
+    LEPT_STREAM_VALUE,      /* before a value */
+    LEPT_STREAM_LITERAL,
+    LEPT_STREAM_NUMBER,
+    LEPT_STREAM_STRING,
+    LEPT_STREAM_ESCAPE,     /* after a backslash */
+    LEPT_STREAM_HEX,        /* inside \uXXXX */
+    LEPT_STREAM_SURROGATE,  /* before the \u of a low surrogate */
+    LEPT_STREAM_ARRAY,      /* after '[' */
+    LEPT_STREAM_OBJECT,     /* after '{' */
+    LEPT_STREAM_KEY,        /* after ',' in an object */
+    LEPT_STREAM_COLON,      /* after a key */
+    LEPT_STREAM_AFTER       /* after a value */
+};
+
+typedef struct {
+    size_t size;            /* values completed so far */
+    int object;
+}lept_stream_frame;
+
+/* what lept_parser_feed() carries over from one chunk to the next */
+typedef struct {
+    int state, error;
+    const char* literal;
+    lept_type literal_type;
+    size_t matched;         /* characters of the literal or the hex quad seen so far */
+    char hex[4];
+    unsigned high;          /* the high surrogate waiting for its low one */
+    int key;                /* the string being read is a member key */
+    size_t head;            /* stack top where the pending number or string text starts */
+    lept_stream_frame* frames;
+    size_t depth, capacity;
+}lept_stream;
+
+struct lept_parser {
+    lept_context c;
+    lept_stream s;
+    lept_tokens t;          /* kept between documents like the stack */
+};
+
+struct lept_writer {
+    lept_context c;         /* the output buffer */
+    size_t flush_size;
+    lept_write_func write;
+    void* ctx;
+    int comma, error;
+};
+
+/* a JSON Pointer trie, node 0 is the root and the others hold one reference token each */
+typedef struct {
+    const char* token;      /* unescaped, in lept_query.tokens */
+    size_t len;
+    size_t index;           /* the token as an array index, LEPT_KEY_NOT_EXIST if it is none */
+    size_t child, sibling;  /* first child and next sibling, 0 for none */
+    size_t path;            /* 1 + a path ending here, 0 for none */
+}lept_query_node;
+
+struct lept_query {
+    lept_query_node* nodes;
+    size_t size, capacity;
+    size_t* next;           /* 1 + the next path ending at the same node, for each path */
+    size_t paths;
+    char* tokens;
+};
+
+typedef struct {
+    const lept_field* field;
+    size_t len;             /* of the name */
+    uint32_t hash;
+    size_t table;           /* the nested table of an object with fields */
+}lept_schema_entry;
+
+typedef struct {
+    size_t entry, count;    /* the entries of the table */
+    size_t slot, mask;      /* its index, 1 + an entry in every used slot */
+}lept_schema_table;
+
+/* table 0 is the root struct */
+struct lept_schema {
+    lept_schema_table* tables;
+    lept_schema_entry* entries;
+    uint32_t* slots;
+    size_t tables_size, entries_size, slots_size;
+};
+
+struct lept_tape {
+    uint64_t* words;
+    size_t size, capacity;
+    char* strings;          /* null-terminated strings back to back */
+    size_t strings_size, strings_capacity;
+    size_t* open;           /* indices of the containers not closed yet */
+    size_t depth, open_capacity;
+    lept_parser* p;
+};
+
+lept_arena* lept_arena_create(size_t block_size) {
+    lept_arena* a = (lept_arena*)LEPT_MALLOC(sizeof(lept_arena));
+    a->head = NULL;
+    a->block_size = block_size ? block_size : LEPT_ARENA_BLOCK_SIZE;
+    return a;
+}
+
+static void lept_arena_free_blocks(lept_arena_block* b) {
+    while (b) {
+        lept_arena_block* next = b->next;
+        LEPT_FREE(b);
+        b = next;
+    }
+}
+
+void lept_arena_reset(lept_arena* a) {
+    assert(a != NULL);
+    if (a->head) {
+        /* keep one block around for the next document */
+        lept_arena_free_blocks(a->head->next);
+        a->head->next = NULL;
+        a->head->used = 0;
+    }
+}
+
+void lept_arena_destroy(lept_arena* a) {
+    if (a) {
+        lept_arena_free_blocks(a->head);
+        LEPT_FREE(a);
+    }
+}
+
+static void* lept_arena_alloc(lept_arena* a, size_t size) {
+    lept_arena_block* b = a->head;
+    void* ret;
+    size = (size + sizeof(lept_arena_align) - 1) / sizeof(lept_arena_align) * sizeof(lept_arena_align);
+    if (!b || b->size - b->used < size) {
+        size_t block_size = size > a->block_size ? size : a->block_size;
+        b = (lept_arena_block*)LEPT_MALLOC(offsetof(lept_arena_block, data) + block_size);
+        b->size = block_size;
+        b->used = 0;
+        if (a->head && size > a->block_size) {
+            /* oversized payload gets a block of its own, the current block keeps serving small ones */
+            b->next = a->head->next;
+            a->head->next = b;
+        }
+        else {
+            b->next = a->head;
+            a->head = b;
+        }
+    }
+    ret = (char*)b->data + b->used;
+    b->used += size;
+    return ret;
+}
+
 static void* lept_context_push(lept_context* c, size_t size) {
     void* ret;
     assert(size > 0);
     if (c->top + size >= c->size) {
+        LEPT_STATS_START(c, LEPT_PHASE_STACK);
         if (c->size == 0)
             c->size = LEPT_PARSE_STACK_INIT_SIZE;
         while (c->top + size >= c->size)
             c->size += c->size >> 1;  /* c->size * 1.5 */
-        c->stack = (char*)realloc(c->stack, c->size);
+        c->stack = (char*)LEPT_REALLOC(c->stack, c->size);
+        LEPT_STATS_ADD(c, stack_reallocs, 1);
+        LEPT_STATS_STOP(c, LEPT_PHASE_STACK);
     }
     ret = c->stack + c->top;
     c->top += size;
@@ -44,188 +449,4474 @@ static void* lept_context_pop(lept_context* c, size_t size) {
     return c->stack + (c->top -= size);
 }
 
-static void lept_parse_whitespace(lept_context* c) {
-    const char *p = c->json;
-    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+/* returns the first non-whitespace character in [p, end), or end */
+static const char* lept_skip_whitespace(const char* p, const char* end) {
+#if defined(LEPT_SIMD_AVX2)
+    const __m256i space32 = _mm256_set1_epi8(' '), tab32 = _mm256_set1_epi8('\t');
+    const __m256i lf32 = _mm256_set1_epi8('\n'), cr32 = _mm256_set1_epi8('\r');
+#endif
+#if defined(LEPT_SIMD_SSE2)
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+#elif defined(LEPT_SIMD_NEON)
+    const uint8x16_t space = vdupq_n_u8(' '), tab = vdupq_n_u8('\t');
+    const uint8x16_t lf = vdupq_n_u8('\n'), cr = vdupq_n_u8('\r');
+#endif
+#if defined(LEPT_SIMD_AVX2)
+    for (; end - p >= 32; p += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)p);
+        __m256i t = _mm256_cmpeq_epi8(s, space32);
+        unsigned mask;
+        if ((unsigned)_mm256_movemask_epi8(t) == 0xFFFFFFFFu)
+            continue; /* indentation: nothing but spaces */
+        t = _mm256_or_si256(t, _mm256_or_si256(_mm256_cmpeq_epi8(s, lf32),
+            _mm256_or_si256(_mm256_cmpeq_epi8(s, tab32), _mm256_cmpeq_epi8(s, cr32))));
+        if ((mask = ~(unsigned)_mm256_movemask_epi8(t)) != 0)
+            return p + LEPT_CTZ(mask);
+    }
+#endif
+#if defined(LEPT_SIMD_SSE2)
+    for (; end - p >= 16; p += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)p);
+        __m128i t = _mm_cmpeq_epi8(s, space);
+        unsigned mask;
+        if (_mm_movemask_epi8(t) == 0xFFFF)
+            continue; /* indentation: nothing but spaces */
+        t = _mm_or_si128(t, _mm_or_si128(_mm_cmpeq_epi8(s, lf),
+            _mm_or_si128(_mm_cmpeq_epi8(s, tab), _mm_cmpeq_epi8(s, cr))));
+        if ((mask = ~(unsigned)_mm_movemask_epi8(t) & 0xFFFF) != 0)
+            return p + LEPT_CTZ(mask);
+    }
+#elif defined(LEPT_SIMD_NEON)
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t s = vld1q_u8((const uint8_t*)p);
+        uint8x16_t t = vceqq_u8(s, space);
+        if (vminvq_u8(t))
+            continue; /* indentation: nothing but spaces */
+        t = vorrq_u8(t, vorrq_u8(vceqq_u8(s, lf), vorrq_u8(vceqq_u8(s, tab), vceqq_u8(s, cr))));
+        if (vminvq_u8(t) == 0) {
+            uint64_t mask = ~vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(t), 4)), 0);
+            unsigned lo = (unsigned)mask;
+            return p + (lo ? LEPT_CTZ(lo) : 32 + LEPT_CTZ((unsigned)(mask >> 32))) / 4;
+        }
+    }
+#endif
+    while (p != end && ISWHITESPACE(*p))
         p++;
+    return p;
+}
+
+/* the index of the first token at or after p */
+static size_t lept_tokens_find(lept_tokens* t, const char* p) {
+    size_t i = t->next, offset = p - t->base;
+    while ((t->pos[i] & ~LEPT_TOKEN_DIRTY) < offset)
+        i++;
+    return t->next = i;
+}
+
+static void lept_parse_whitespace(lept_context* c) {
+    const char *p = c->json, *end = c->end;
+    LEPT_STATS_START(c, LEPT_PHASE_WHITESPACE);
+    /* everything up to the next token is whitespace, when outside a string */
+    if (c->tokens) {
+        if (p != end && ISWHITESPACE(*p))
+            p = c->tokens->base + c->tokens->pos[lept_tokens_find(c->tokens, p)];
+    }
+    /* none or a single separator is the common case, keep it off the vector path */
+    else if (p != end && ISWHITESPACE(*p) && ++p != end && ISWHITESPACE(*p))
+        p = lept_skip_whitespace(p + 1, end);
     c->json = p;
+    LEPT_STATS_STOP(c, LEPT_PHASE_WHITESPACE);
+}
+
+static int lept_emit_literal(lept_context* c, lept_type type) {
+    if (type == LEPT_NULL)
+        return LEPT_EMIT(c, on_null, (c->handler_ctx));
+    return LEPT_EMIT(c, on_boolean, (c->handler_ctx, type == LEPT_TRUE));
 }
 
-static int lept_parse_literal(lept_context* c, lept_value* v, const char* literal, lept_type type) {
+static int lept_emit_number(lept_context* c, const lept_value* n) {
+    if ((n->flags & LEPT_VALUE_INT64) && c->handler->on_int64)
+        return LEPT_EMIT(c, on_int64, (c->handler_ctx, n->u.i));
+    return LEPT_EMIT(c, on_number, (c->handler_ctx, lept_get_number(n)));
+}
+
+static int lept_parse_literal(lept_context* c, const char* literal, lept_type type) {
     size_t i;
     EXPECT(c, literal[0]);
     for (i = 0; literal[i + 1]; i++)
-        if (c->json[i] != literal[i + 1])
+        if (c->json + i == c->end || c->json[i] != literal[i + 1])
             return LEPT_PARSE_INVALID_VALUE;
     c->json += i;
-    v->type = type;
-    return LEPT_PARSE_OK;
+    return lept_emit_literal(c, type);
 }
 
-static int lept_parse_number(lept_context* c, lept_value* v) {
-    const char* p = c->json;
-    if (*p == '-') p++;
-    if (*p == '0') p++;
-    else {
-        if (!ISDIGIT1TO9(*p)) return LEPT_PARSE_INVALID_VALUE;
-        for (p++; ISDIGIT(*p); p++);
-    }
-    if (*p == '.') {
-        p++;
-        if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
-        for (p++; ISDIGIT(*p); p++);
+/*
+ * Decimal to double conversion, correctly rounded and independent of the locale:
+ * 1. Clinger's fast path when the digits and the power of ten are both exact doubles.
+ * 2. Eisel-Lemire: a 64x64-bit product with a normalized power of five decides almost
+ *    every remaining input.
+ * 3. Otherwise compare the decimal against the halfway points of the candidate with
+ *    big integers.
+ */
+
+typedef struct {
+    uint64_t w;                 /* first 19 significant digits */
+    long digits;                /* significant digits, including those beyond w */
+    long e;                     /* decimal exponent of w, before the explicit exponent */
+    long exp;                   /* explicit exponent */
+    const char *int_begin, *int_end, *frac_begin, *frac_end;
+}lept_decimal;
+
+#define LEPT_DECIMAL_W_DIGITS   19
+#define LEPT_DECIMAL_EXP_MAX    100000000L  /* far beyond any double, stop accumulating there */
+#define LEPT_DOUBLE_INF_BITS    ((uint64_t)0x7FF00000 << 32)
+#define LEPT_DOUBLE_HIDDEN_BIT  ((uint64_t)1 << 52)
+#define LEPT_DOUBLE_MAX_EXACT   9007199254740992.0  /* 2^53 */
+
+#ifndef LEPT_BIGINT_MAX_DIGITS
+#define LEPT_BIGINT_MAX_DIGITS 780      /* more digits than any halfway point between doubles needs */
+#endif
+#define LEPT_BIGINT_CAPACITY 128        /* 32-bit words, bounds the largest comparison */
+
+static const double lept_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* normalized 64-bit 5^q for q in [-342, 308], truncated: 5^q * 2^(63 - floor(log2(5^q))) */
+static const uint32_t lept_pow5_table[][2] = {
+    { 0xeef453d6, 0x923bd65a }, { 0x9558b466, 0x1b6565f8 }, { 0xbaaee17f, 0xa23ebf76 }, { 0xe95a99df, 0x8ace6f53 },
+    { 0x91d8a02b, 0xb6c10594 }, { 0xb64ec836, 0xa47146f9 }, { 0xe3e27a44, 0x4d8d98b7 }, { 0x8e6d8c6a, 0xb0787f72 },
+    { 0xb208ef85, 0x5c969f4f }, { 0xde8b2b66, 0xb3bc4723 }, { 0x8b16fb20, 0x3055ac76 }, { 0xaddcb9e8, 0x3c6b1793 },
+    { 0xd953e862, 0x4b85dd78 }, { 0x87d4713d, 0x6f33aa6b }, { 0xa9c98d8c, 0xcb009506 }, { 0xd43bf0ef, 0xfdc0ba48 },
+    { 0x84a57695, 0xfe98746d }, { 0xa5ced43b, 0x7e3e9188 }, { 0xcf42894a, 0x5dce35ea }, { 0x818995ce, 0x7aa0e1b2 },
+    { 0xa1ebfb42, 0x19491a1f }, { 0xca66fa12, 0x9f9b60a6 }, { 0xfd00b897, 0x478238d0 }, { 0x9e20735e, 0x8cb16382 },
+    { 0xc5a89036, 0x2fddbc62 }, { 0xf712b443, 0xbbd52b7b }, { 0x9a6bb0aa, 0x55653b2d }, { 0xc1069cd4, 0xeabe89f8 },
+    { 0xf148440a, 0x256e2c76 }, { 0x96cd2a86, 0x5764dbca }, { 0xbc807527, 0xed3e12bc }, { 0xeba09271, 0xe88d976b },
+    { 0x93445b87, 0x31587ea3 }, { 0xb8157268, 0xfdae9e4c }, { 0xe61acf03, 0x3d1a45df }, { 0x8fd0c162, 0x06306bab },
+    { 0xb3c4f1ba, 0x87bc8696 }, { 0xe0b62e29, 0x29aba83c }, { 0x8c71dcd9, 0xba0b4925 }, { 0xaf8e5410, 0x288e1b6f },
+    { 0xdb71e914, 0x32b1a24a }, { 0x892731ac, 0x9faf056e }, { 0xab70fe17, 0xc79ac6ca }, { 0xd64d3d9d, 0xb981787d },
+    { 0x85f04682, 0x93f0eb4e }, { 0xa76c5823, 0x38ed2621 }, { 0xd1476e2c, 0x07286faa }, { 0x82cca4db, 0x847945ca },
+    { 0xa37fce12, 0x6597973c }, { 0xcc5fc196, 0xfefd7d0c }, { 0xff77b1fc, 0xbebcdc4f }, { 0x9faacf3d, 0xf73609b1 },
+    { 0xc795830d, 0x75038c1d }, { 0xf97ae3d0, 0xd2446f25 }, { 0x9becce62, 0x836ac577 }, { 0xc2e801fb, 0x244576d5 },
+    { 0xf3a20279, 0xed56d48a }, { 0x9845418c, 0x345644d6 }, { 0xbe5691ef, 0x416bd60c }, { 0xedec366b, 0x11c6cb8f },
+    { 0x94b3a202, 0xeb1c3f39 }, { 0xb9e08a83, 0xa5e34f07 }, { 0xe858ad24, 0x8f5c22c9 }, { 0x91376c36, 0xd99995be },
+    { 0xb5854744, 0x8ffffb2d }, { 0xe2e69915, 0xb3fff9f9 }, { 0x8dd01fad, 0x907ffc3b }, { 0xb1442798, 0xf49ffb4a },
+    { 0xdd95317f, 0x31c7fa1d }, { 0x8a7d3eef, 0x7f1cfc52 }, { 0xad1c8eab, 0x5ee43b66 }, { 0xd863b256, 0x369d4a40 },
+    { 0x873e4f75, 0xe2224e68 }, { 0xa90de353, 0x5aaae202 }, { 0xd3515c28, 0x31559a83 }, { 0x8412d999, 0x1ed58091 },
+    { 0xa5178fff, 0x668ae0b6 }, { 0xce5d73ff, 0x402d98e3 }, { 0x80fa687f, 0x881c7f8e }, { 0xa139029f, 0x6a239f72 },
+    { 0xc9874347, 0x44ac874e }, { 0xfbe91419, 0x15d7a922 }, { 0x9d71ac8f, 0xada6c9b5 }, { 0xc4ce17b3, 0x99107c22 },
+    { 0xf6019da0, 0x7f549b2b }, { 0x99c10284, 0x4f94e0fb }, { 0xc0314325, 0x637a1939 }, { 0xf03d93ee, 0xbc589f88 },
+    { 0x96267c75, 0x35b763b5 }, { 0xbbb01b92, 0x83253ca2 }, { 0xea9c2277, 0x23ee8bcb }, { 0x92a1958a, 0x7675175f },
+    { 0xb749faed, 0x14125d36 }, { 0xe51c79a8, 0x5916f484 }, { 0x8f31cc09, 0x37ae58d2 }, { 0xb2fe3f0b, 0x8599ef07 },
+    { 0xdfbdcece, 0x67006ac9 }, { 0x8bd6a141, 0x006042bd }, { 0xaecc4991, 0x4078536d }, { 0xda7f5bf5, 0x90966848 },
+    { 0x888f9979, 0x7a5e012d }, { 0xaab37fd7, 0xd8f58178 }, { 0xd5605fcd, 0xcf32e1d6 }, { 0x855c3be0, 0xa17fcd26 },
+    { 0xa6b34ad8, 0xc9dfc06f }, { 0xd0601d8e, 0xfc57b08b }, { 0x823c1279, 0x5db6ce57 }, { 0xa2cb1717, 0xb52481ed },
+    { 0xcb7ddcdd, 0xa26da268 }, { 0xfe5d5415, 0x0b090b02 }, { 0x9efa548d, 0x26e5a6e1 }, { 0xc6b8e9b0, 0x709f109a },
+    { 0xf867241c, 0x8cc6d4c0 }, { 0x9b407691, 0xd7fc44f8 }, { 0xc2109436, 0x4dfb5636 }, { 0xf294b943, 0xe17a2bc4 },
+    { 0x979cf3ca, 0x6cec5b5a }, { 0xbd8430bd, 0x08277231 }, { 0xece53cec, 0x4a314ebd }, { 0x940f4613, 0xae5ed136 },
+    { 0xb9131798, 0x99f68584 }, { 0xe757dd7e, 0xc07426e5 }, { 0x9096ea6f, 0x3848984f }, { 0xb4bca50b, 0x065abe63 },
+    { 0xe1ebce4d, 0xc7f16dfb }, { 0x8d3360f0, 0x9cf6e4bd }, { 0xb080392c, 0xc4349dec }, { 0xdca04777, 0xf541c567 },
+    { 0x89e42caa, 0xf9491b60 }, { 0xac5d37d5, 0xb79b6239 }, { 0xd77485cb, 0x25823ac7 }, { 0x86a8d39e, 0xf77164bc },
+    { 0xa8530886, 0xb54dbdeb }, { 0xd267caa8, 0x62a12d66 }, { 0x8380dea9, 0x3da4bc60 }, { 0xa4611653, 0x8d0deb78 },
+    { 0xcd795be8, 0x70516656 }, { 0x806bd971, 0x4632dff6 }, { 0xa086cfcd, 0x97bf97f3 }, { 0xc8a883c0, 0xfdaf7df0 },
+    { 0xfad2a4b1, 0x3d1b5d6c }, { 0x9cc3a6ee, 0xc6311a63 }, { 0xc3f490aa, 0x77bd60fc }, { 0xf4f1b4d5, 0x15acb93b },
+    { 0x99171105, 0x2d8bf3c5 }, { 0xbf5cd546, 0x78eef0b6 }, { 0xef340a98, 0x172aace4 }, { 0x9580869f, 0x0e7aac0e },
+    { 0xbae0a846, 0xd2195712 }, { 0xe998d258, 0x869facd7 }, { 0x91ff8377, 0x5423cc06 }, { 0xb67f6455, 0x292cbf08 },
+    { 0xe41f3d6a, 0x7377eeca }, { 0x8e938662, 0x882af53e }, { 0xb23867fb, 0x2a35b28d }, { 0xdec681f9, 0xf4c31f31 },
+    { 0x8b3c113c, 0x38f9f37e }, { 0xae0b158b, 0x4738705e }, { 0xd98ddaee, 0x19068c76 }, { 0x87f8a8d4, 0xcfa417c9 },
+    { 0xa9f6d30a, 0x038d1dbc }, { 0xd47487cc, 0x8470652b }, { 0x84c8d4df, 0xd2c63f3b }, { 0xa5fb0a17, 0xc777cf09 },
+    { 0xcf79cc9d, 0xb955c2cc }, { 0x81ac1fe2, 0x93d599bf }, { 0xa21727db, 0x38cb002f }, { 0xca9cf1d2, 0x06fdc03b },
+    { 0xfd442e46, 0x88bd304a }, { 0x9e4a9cec, 0x15763e2e }, { 0xc5dd4427, 0x1ad3cdba }, { 0xf7549530, 0xe188c128 },
+    { 0x9a94dd3e, 0x8cf578b9 }, { 0xc13a148e, 0x3032d6e7 }, { 0xf18899b1, 0xbc3f8ca1 }, { 0x96f5600f, 0x15a7b7e5 },
+    { 0xbcb2b812, 0xdb11a5de }, { 0xebdf6617, 0x91d60f56 }, { 0x936b9fce, 0xbb25c995 }, { 0xb84687c2, 0x69ef3bfb },
+    { 0xe65829b3, 0x046b0afa }, { 0x8ff71a0f, 0xe2c2e6dc }, { 0xb3f4e093, 0xdb73a093 }, { 0xe0f218b8, 0xd25088b8 },
+    { 0x8c974f73, 0x83725573 }, { 0xafbd2350, 0x644eeacf }, { 0xdbac6c24, 0x7d62a583 }, { 0x894bc396, 0xce5da772 },
+    { 0xab9eb47c, 0x81f5114f }, { 0xd686619b, 0xa27255a2 }, { 0x8613fd01, 0x45877585 }, { 0xa798fc41, 0x96e952e7 },
+    { 0xd17f3b51, 0xfca3a7a0 }, { 0x82ef8513, 0x3de648c4 }, { 0xa3ab6658, 0x0d5fdaf5 }, { 0xcc963fee, 0x10b7d1b3 },
+    { 0xffbbcfe9, 0x94e5c61f }, { 0x9fd561f1, 0xfd0f9bd3 }, { 0xc7caba6e, 0x7c5382c8 }, { 0xf9bd690a, 0x1b68637b },
+    { 0x9c1661a6, 0x51213e2d }, { 0xc31bfa0f, 0xe5698db8 }, { 0xf3e2f893, 0xdec3f126 }, { 0x986ddb5c, 0x6b3a76b7 },
+    { 0xbe895233, 0x86091465 }, { 0xee2ba6c0, 0x678b597f }, { 0x94db4838, 0x40b717ef }, { 0xba121a46, 0x50e4ddeb },
+    { 0xe896a0d7, 0xe51e1566 }, { 0x915e2486, 0xef32cd60 }, { 0xb5b5ada8, 0xaaff80b8 }, { 0xe3231912, 0xd5bf60e6 },
+    { 0x8df5efab, 0xc5979c8f }, { 0xb1736b96, 0xb6fd83b3 }, { 0xddd0467c, 0x64bce4a0 }, { 0x8aa22c0d, 0xbef60ee4 },
+    { 0xad4ab711, 0x2eb3929d }, { 0xd89d64d5, 0x7a607744 }, { 0x87625f05, 0x6c7c4a8b }, { 0xa93af6c6, 0xc79b5d2d },
+    { 0xd389b478, 0x79823479 }, { 0x843610cb, 0x4bf160cb }, { 0xa54394fe, 0x1eedb8fe }, { 0xce947a3d, 0xa6a9273e },
+    { 0x811ccc66, 0x8829b887 }, { 0xa163ff80, 0x2a3426a8 }, { 0xc9bcff60, 0x34c13052 }, { 0xfc2c3f38, 0x41f17c67 },
+    { 0x9d9ba783, 0x2936edc0 }, { 0xc5029163, 0xf384a931 }, { 0xf64335bc, 0xf065d37d }, { 0x99ea0196, 0x163fa42e },
+    { 0xc06481fb, 0x9bcf8d39 }, { 0xf07da27a, 0x82c37088 }, { 0x964e858c, 0x91ba2655 }, { 0xbbe226ef, 0xb628afea },
+    { 0xeadab0ab, 0xa3b2dbe5 }, { 0x92c8ae6b, 0x464fc96f }, { 0xb77ada06, 0x17e3bbcb }, { 0xe5599087, 0x9ddcaabd },
+    { 0x8f57fa54, 0xc2a9eab6 }, { 0xb32df8e9, 0xf3546564 }, { 0xdff97724, 0x70297ebd }, { 0x8bfbea76, 0xc619ef36 },
+    { 0xaefae514, 0x77a06b03 }, { 0xdab99e59, 0x958885c4 }, { 0x88b402f7, 0xfd75539b }, { 0xaae103b5, 0xfcd2a881 },
+    { 0xd59944a3, 0x7c0752a2 }, { 0x857fcae6, 0x2d8493a5 }, { 0xa6dfbd9f, 0xb8e5b88e }, { 0xd097ad07, 0xa71f26b2 },
+    { 0x825ecc24, 0xc873782f }, { 0xa2f67f2d, 0xfa90563b }, { 0xcbb41ef9, 0x79346bca }, { 0xfea126b7, 0xd78186bc },
+    { 0x9f24b832, 0xe6b0f436 }, { 0xc6ede63f, 0xa05d3143 }, { 0xf8a95fcf, 0x88747d94 }, { 0x9b69dbe1, 0xb548ce7c },
+    { 0xc24452da, 0x229b021b }, { 0xf2d56790, 0xab41c2a2 }, { 0x97c560ba, 0x6b0919a5 }, { 0xbdb6b8e9, 0x05cb600f },
+    { 0xed246723, 0x473e3813 }, { 0x9436c076, 0x0c86e30b }, { 0xb9447093, 0x8fa89bce }, { 0xe7958cb8, 0x7392c2c2 },
+    { 0x90bd77f3, 0x483bb9b9 }, { 0xb4ecd5f0, 0x1a4aa828 }, { 0xe2280b6c, 0x20dd5232 }, { 0x8d590723, 0x948a535f },
+    { 0xb0af48ec, 0x79ace837 }, { 0xdcdb1b27, 0x98182244 }, { 0x8a08f0f8, 0xbf0f156b }, { 0xac8b2d36, 0xeed2dac5 },
+    { 0xd7adf884, 0xaa879177 }, { 0x86ccbb52, 0xea94baea }, { 0xa87fea27, 0xa539e9a5 }, { 0xd29fe4b1, 0x8e88640e },
+    { 0x83a3eeee, 0xf9153e89 }, { 0xa48ceaaa, 0xb75a8e2b }, { 0xcdb02555, 0x653131b6 }, { 0x808e1755, 0x5f3ebf11 },
+    { 0xa0b19d2a, 0xb70e6ed6 }, { 0xc8de0475, 0x64d20a8b }, { 0xfb158592, 0xbe068d2e }, { 0x9ced737b, 0xb6c4183d },
+    { 0xc428d05a, 0xa4751e4c }, { 0xf5330471, 0x4d9265df }, { 0x993fe2c6, 0xd07b7fab }, { 0xbf8fdb78, 0x849a5f96 },
+    { 0xef73d256, 0xa5c0f77c }, { 0x95a86376, 0x27989aad }, { 0xbb127c53, 0xb17ec159 }, { 0xe9d71b68, 0x9dde71af },
+    { 0x92267121, 0x62ab070d }, { 0xb6b00d69, 0xbb55c8d1 }, { 0xe45c10c4, 0x2a2b3b05 }, { 0x8eb98a7a, 0x9a5b04e3 },
+    { 0xb267ed19, 0x40f1c61c }, { 0xdf01e85f, 0x912e37a3 }, { 0x8b61313b, 0xbabce2c6 }, { 0xae397d8a, 0xa96c1b77 },
+    { 0xd9c7dced, 0x53c72255 }, { 0x881cea14, 0x545c7575 }, { 0xaa242499, 0x697392d2 }, { 0xd4ad2dbf, 0xc3d07787 },
+    { 0x84ec3c97, 0xda624ab4 }, { 0xa6274bbd, 0xd0fadd61 }, { 0xcfb11ead, 0x453994ba }, { 0x81ceb32c, 0x4b43fcf4 },
+    { 0xa2425ff7, 0x5e14fc31 }, { 0xcad2f7f5, 0x359a3b3e }, { 0xfd87b5f2, 0x8300ca0d }, { 0x9e74d1b7, 0x91e07e48 },
+    { 0xc6120625, 0x76589dda }, { 0xf79687ae, 0xd3eec551 }, { 0x9abe14cd, 0x44753b52 }, { 0xc16d9a00, 0x95928a27 },
+    { 0xf1c90080, 0xbaf72cb1 }, { 0x971da050, 0x74da7bee }, { 0xbce50864, 0x92111aea }, { 0xec1e4a7d, 0xb69561a5 },
+    { 0x9392ee8e, 0x921d5d07 }, { 0xb877aa32, 0x36a4b449 }, { 0xe69594be, 0xc44de15b }, { 0x901d7cf7, 0x3ab0acd9 },
+    { 0xb424dc35, 0x095cd80f }, { 0xe12e1342, 0x4bb40e13 }, { 0x8cbccc09, 0x6f5088cb }, { 0xafebff0b, 0xcb24aafe },
+    { 0xdbe6fece, 0xbdedd5be }, { 0x89705f41, 0x36b4a597 }, { 0xabcc7711, 0x8461cefc }, { 0xd6bf94d5, 0xe57a42bc },
+    { 0x8637bd05, 0xaf6c69b5 }, { 0xa7c5ac47, 0x1b478423 }, { 0xd1b71758, 0xe219652b }, { 0x83126e97, 0x8d4fdf3b },
+    { 0xa3d70a3d, 0x70a3d70a }, { 0xcccccccc, 0xcccccccc }, { 0x80000000, 0x00000000 }, { 0xa0000000, 0x00000000 },
+    { 0xc8000000, 0x00000000 }, { 0xfa000000, 0x00000000 }, { 0x9c400000, 0x00000000 }, { 0xc3500000, 0x00000000 },
+    { 0xf4240000, 0x00000000 }, { 0x98968000, 0x00000000 }, { 0xbebc2000, 0x00000000 }, { 0xee6b2800, 0x00000000 },
+    { 0x9502f900, 0x00000000 }, { 0xba43b740, 0x00000000 }, { 0xe8d4a510, 0x00000000 }, { 0x9184e72a, 0x00000000 },
+    { 0xb5e620f4, 0x80000000 }, { 0xe35fa931, 0xa0000000 }, { 0x8e1bc9bf, 0x04000000 }, { 0xb1a2bc2e, 0xc5000000 },
+    { 0xde0b6b3a, 0x76400000 }, { 0x8ac72304, 0x89e80000 }, { 0xad78ebc5, 0xac620000 }, { 0xd8d726b7, 0x177a8000 },
+    { 0x87867832, 0x6eac9000 }, { 0xa968163f, 0x0a57b400 }, { 0xd3c21bce, 0xcceda100 }, { 0x84595161, 0x401484a0 },
+    { 0xa56fa5b9, 0x9019a5c8 }, { 0xcecb8f27, 0xf4200f3a }, { 0x813f3978, 0xf8940984 }, { 0xa18f07d7, 0x36b90be5 },
+    { 0xc9f2c9cd, 0x04674ede }, { 0xfc6f7c40, 0x45812296 }, { 0x9dc5ada8, 0x2b70b59d }, { 0xc5371912, 0x364ce305 },
+    { 0xf684df56, 0xc3e01bc6 }, { 0x9a130b96, 0x3a6c115c }, { 0xc097ce7b, 0xc90715b3 }, { 0xf0bdc21a, 0xbb48db20 },
+    { 0x96769950, 0xb50d88f4 }, { 0xbc143fa4, 0xe250eb31 }, { 0xeb194f8e, 0x1ae525fd }, { 0x92efd1b8, 0xd0cf37be },
+    { 0xb7abc627, 0x050305ad }, { 0xe596b7b0, 0xc643c719 }, { 0x8f7e32ce, 0x7bea5c6f }, { 0xb35dbf82, 0x1ae4f38b },
+    { 0xe0352f62, 0xa19e306e }, { 0x8c213d9d, 0xa502de45 }, { 0xaf298d05, 0x0e4395d6 }, { 0xdaf3f046, 0x51d47b4c },
+    { 0x88d8762b, 0xf324cd0f }, { 0xab0e93b6, 0xefee0053 }, { 0xd5d238a4, 0xabe98068 }, { 0x85a36366, 0xeb71f041 },
+    { 0xa70c3c40, 0xa64e6c51 }, { 0xd0cf4b50, 0xcfe20765 }, { 0x82818f12, 0x81ed449f }, { 0xa321f2d7, 0x226895c7 },
+    { 0xcbea6f8c, 0xeb02bb39 }, { 0xfee50b70, 0x25c36a08 }, { 0x9f4f2726, 0x179a2245 }, { 0xc722f0ef, 0x9d80aad6 },
+    { 0xf8ebad2b, 0x84e0d58b }, { 0x9b934c3b, 0x330c8577 }, { 0xc2781f49, 0xffcfa6d5 }, { 0xf316271c, 0x7fc3908a },
+    { 0x97edd871, 0xcfda3a56 }, { 0xbde94e8e, 0x43d0c8ec }, { 0xed63a231, 0xd4c4fb27 }, { 0x945e455f, 0x24fb1cf8 },
+    { 0xb975d6b6, 0xee39e436 }, { 0xe7d34c64, 0xa9c85d44 }, { 0x90e40fbe, 0xea1d3a4a }, { 0xb51d13ae, 0xa4a488dd },
+    { 0xe264589a, 0x4dcdab14 }, { 0x8d7eb760, 0x70a08aec }, { 0xb0de6538, 0x8cc8ada8 }, { 0xdd15fe86, 0xaffad912 },
+    { 0x8a2dbf14, 0x2dfcc7ab }, { 0xacb92ed9, 0x397bf996 }, { 0xd7e77a8f, 0x87daf7fb }, { 0x86f0ac99, 0xb4e8dafd },
+    { 0xa8acd7c0, 0x222311bc }, { 0xd2d80db0, 0x2aabd62b }, { 0x83c7088e, 0x1aab65db }, { 0xa4b8cab1, 0xa1563f52 },
+    { 0xcde6fd5e, 0x09abcf26 }, { 0x80b05e5a, 0xc60b6178 }, { 0xa0dc75f1, 0x778e39d6 }, { 0xc913936d, 0xd571c84c },
+    { 0xfb587849, 0x4ace3a5f }, { 0x9d174b2d, 0xcec0e47b }, { 0xc45d1df9, 0x42711d9a }, { 0xf5746577, 0x930d6500 },
+    { 0x9968bf6a, 0xbbe85f20 }, { 0xbfc2ef45, 0x6ae276e8 }, { 0xefb3ab16, 0xc59b14a2 }, { 0x95d04aee, 0x3b80ece5 },
+    { 0xbb445da9, 0xca61281f }, { 0xea157514, 0x3cf97226 }, { 0x924d692c, 0xa61be758 }, { 0xb6e0c377, 0xcfa2e12e },
+    { 0xe498f455, 0xc38b997a }, { 0x8edf98b5, 0x9a373fec }, { 0xb2977ee3, 0x00c50fe7 }, { 0xdf3d5e9b, 0xc0f653e1 },
+    { 0x8b865b21, 0x5899f46c }, { 0xae67f1e9, 0xaec07187 }, { 0xda01ee64, 0x1a708de9 }, { 0x884134fe, 0x908658b2 },
+    { 0xaa51823e, 0x34a7eede }, { 0xd4e5e2cd, 0xc1d1ea96 }, { 0x850fadc0, 0x9923329e }, { 0xa6539930, 0xbf6bff45 },
+    { 0xcfe87f7c, 0xef46ff16 }, { 0x81f14fae, 0x158c5f6e }, { 0xa26da399, 0x9aef7749 }, { 0xcb090c80, 0x01ab551c },
+    { 0xfdcb4fa0, 0x02162a63 }, { 0x9e9f11c4, 0x014dda7e }, { 0xc646d635, 0x01a1511d }, { 0xf7d88bc2, 0x4209a565 },
+    { 0x9ae75759, 0x6946075f }, { 0xc1a12d2f, 0xc3978937 }, { 0xf209787b, 0xb47d6b84 }, { 0x9745eb4d, 0x50ce6332 },
+    { 0xbd176620, 0xa501fbff }, { 0xec5d3fa8, 0xce427aff }, { 0x93ba47c9, 0x80e98cdf }, { 0xb8a8d9bb, 0xe123f017 },
+    { 0xe6d3102a, 0xd96cec1d }, { 0x9043ea1a, 0xc7e41392 }, { 0xb454e4a1, 0x79dd1877 }, { 0xe16a1dc9, 0xd8545e94 },
+    { 0x8ce2529e, 0x2734bb1d }, { 0xb01ae745, 0xb101e9e4 }, { 0xdc21a117, 0x1d42645d }, { 0x899504ae, 0x72497eba },
+    { 0xabfa45da, 0x0edbde69 }, { 0xd6f8d750, 0x9292d603 }, { 0x865b8692, 0x5b9bc5c2 }, { 0xa7f26836, 0xf282b732 },
+    { 0xd1ef0244, 0xaf2364ff }, { 0x8335616a, 0xed761f1f }, { 0xa402b9c5, 0xa8d3a6e7 }, { 0xcd036837, 0x130890a1 },
+    { 0x80222122, 0x6be55a64 }, { 0xa02aa96b, 0x06deb0fd }, { 0xc83553c5, 0xc8965d3d }, { 0xfa42a8b7, 0x3abbf48c },
+    { 0x9c69a972, 0x84b578d7 }, { 0xc38413cf, 0x25e2d70d }, { 0xf46518c2, 0xef5b8cd1 }, { 0x98bf2f79, 0xd5993802 },
+    { 0xbeeefb58, 0x4aff8603 }, { 0xeeaaba2e, 0x5dbf6784 }, { 0x952ab45c, 0xfa97a0b2 }, { 0xba756174, 0x393d88df },
+    { 0xe912b9d1, 0x478ceb17 }, { 0x91abb422, 0xccb812ee }, { 0xb616a12b, 0x7fe617aa }, { 0xe39c4976, 0x5fdf9d94 },
+    { 0x8e41ade9, 0xfbebc27d }, { 0xb1d21964, 0x7ae6b31c }, { 0xde469fbd, 0x99a05fe3 }, { 0x8aec23d6, 0x80043bee },
+    { 0xada72ccc, 0x20054ae9 }, { 0xd910f7ff, 0x28069da4 }, { 0x87aa9aff, 0x79042286 }, { 0xa99541bf, 0x57452b28 },
+    { 0xd3fa922f, 0x2d1675f2 }, { 0x847c9b5d, 0x7c2e09b7 }, { 0xa59bc234, 0xdb398c25 }, { 0xcf02b2c2, 0x1207ef2e },
+    { 0x8161afb9, 0x4b44f57d }, { 0xa1ba1ba7, 0x9e1632dc }, { 0xca28a291, 0x859bbf93 }, { 0xfcb2cb35, 0xe702af78 },
+    { 0x9defbf01, 0xb061adab }, { 0xc56baec2, 0x1c7a1916 }, { 0xf6c69a72, 0xa3989f5b }, { 0x9a3c2087, 0xa63f6399 },
+    { 0xc0cb28a9, 0x8fcf3c7f }, { 0xf0fdf2d3, 0xf3c30b9f }, { 0x969eb7c4, 0x7859e743 }, { 0xbc4665b5, 0x96706114 },
+    { 0xeb57ff22, 0xfc0c7959 }, { 0x9316ff75, 0xdd87cbd8 }, { 0xb7dcbf53, 0x54e9bece }, { 0xe5d3ef28, 0x2a242e81 },
+    { 0x8fa47579, 0x1a569d10 }, { 0xb38d92d7, 0x60ec4455 }, { 0xe070f78d, 0x3927556a }, { 0x8c469ab8, 0x43b89562 },
+    { 0xaf584166, 0x54a6babb }, { 0xdb2e51bf, 0xe9d0696a }, { 0x88fcf317, 0xf22241e2 }, { 0xab3c2fdd, 0xeeaad25a },
+    { 0xd60b3bd5, 0x6a5586f1 }, { 0x85c70565, 0x62757456 }, { 0xa738c6be, 0xbb12d16c }, { 0xd106f86e, 0x69d785c7 },
+    { 0x82a45b45, 0x0226b39c }, { 0xa34d7216, 0x42b06084 }, { 0xcc20ce9b, 0xd35c78a5 }, { 0xff290242, 0xc83396ce },
+    { 0x9f79a169, 0xbd203e41 }, { 0xc75809c4, 0x2c684dd1 }, { 0xf92e0c35, 0x37826145 }, { 0x9bbcc7a1, 0x42b17ccb },
+    { 0xc2abf989, 0x935ddbfe }, { 0xf356f7eb, 0xf83552fe }, { 0x98165af3, 0x7b2153de }, { 0xbe1bf1b0, 0x59e9a8d6 },
+    { 0xeda2ee1c, 0x7064130c }, { 0x9485d4d1, 0xc63e8be7 }, { 0xb9a74a06, 0x37ce2ee1 }, { 0xe8111c87, 0xc5c1ba99 },
+    { 0x910ab1d4, 0xdb9914a0 }, { 0xb54d5e4a, 0x127f59c8 }, { 0xe2a0b5dc, 0x971f303a }, { 0x8da471a9, 0xde737e24 },
+    { 0xb10d8e14, 0x56105dad }, { 0xdd50f199, 0x6b947518 }, { 0x8a5296ff, 0xe33cc92f }, { 0xace73cbf, 0xdc0bfb7b },
+    { 0xd8210bef, 0xd30efa5a }, { 0x8714a775, 0xe3e95c78 }, { 0xa8d9d153, 0x5ce3b396 }, { 0xd31045a8, 0x341ca07c },
+    { 0x83ea2b89, 0x2091e44d }, { 0xa4e4b66b, 0x68b65d60 }, { 0xce1de406, 0x42e3f4b9 }, { 0x80d2ae83, 0xe9ce78f3 },
+    { 0xa1075a24, 0xe4421730 }, { 0xc94930ae, 0x1d529cfc }, { 0xfb9b7cd9, 0xa4a7443c }, { 0x9d412e08, 0x06e88aa5 },
+    { 0xc491798a, 0x08a2ad4e }, { 0xf5b5d7ec, 0x8acb58a2 }, { 0x9991a6f3, 0xd6bf1765 }, { 0xbff610b0, 0xcc6edd3f },
+    { 0xeff394dc, 0xff8a948e }, { 0x95f83d0a, 0x1fb69cd9 }, { 0xbb764c4c, 0xa7a4440f }, { 0xea53df5f, 0xd18d5513 },
+    { 0x92746b9b, 0xe2f8552c }, { 0xb7118682, 0xdbb66a77 }, { 0xe4d5e823, 0x92a40515 }, { 0x8f05b116, 0x3ba6832d },
+    { 0xb2c71d5b, 0xca9023f8 }, { 0xdf78e4b2, 0xbd342cf6 }, { 0x8bab8eef, 0xb6409c1a }, { 0xae9672ab, 0xa3d0c320 },
+    { 0xda3c0f56, 0x8cc4f3e8 }, { 0x88658996, 0x17fb1871 }, { 0xaa7eebfb, 0x9df9de8d }, { 0xd51ea6fa, 0x85785631 },
+    { 0x8533285c, 0x936b35de }, { 0xa67ff273, 0xb8460356 }, { 0xd01fef10, 0xa657842c }, { 0x8213f56a, 0x67f6b29b },
+    { 0xa298f2c5, 0x01f45f42 }, { 0xcb3f2f76, 0x42717713 }, { 0xfe0efb53, 0xd30dd4d7 }, { 0x9ec95d14, 0x63e8a506 },
+    { 0xc67bb459, 0x7ce2ce48 }, { 0xf81aa16f, 0xdc1b81da }, { 0x9b10a4e5, 0xe9913128 }, { 0xc1d4ce1f, 0x63f57d72 },
+    { 0xf24a01a7, 0x3cf2dccf }, { 0x976e4108, 0x8617ca01 }, { 0xbd49d14a, 0xa79dbc82 }, { 0xec9c459d, 0x51852ba2 },
+    { 0x93e1ab82, 0x52f33b45 }, { 0xb8da1662, 0xe7b00a17 }, { 0xe7109bfb, 0xa19c0c9d }, { 0x906a617d, 0x450187e2 },
+    { 0xb484f9dc, 0x9641e9da }, { 0xe1a63853, 0xbbd26451 }, { 0x8d07e334, 0x55637eb2 }, { 0xb049dc01, 0x6abc5e5f },
+    { 0xdc5c5301, 0xc56b75f7 }, { 0x89b9b3e1, 0x1b6329ba }, { 0xac2820d9, 0x623bf429 }, { 0xd732290f, 0xbacaf133 },
+    { 0x867f59a9, 0xd4bed6c0 }, { 0xa81f3014, 0x49ee8c70 }, { 0xd226fc19, 0x5c6a2f8c }, { 0x83585d8f, 0xd9c25db7 },
+    { 0xa42e74f3, 0xd032f525 }, { 0xcd3a1230, 0xc43fb26f }, { 0x80444b5e, 0x7aa7cf85 }, { 0xa0555e36, 0x1951c366 },
+    { 0xc86ab5c3, 0x9fa63440 }, { 0xfa856334, 0x878fc150 }, { 0x9c935e00, 0xd4b9d8d2 }, { 0xc3b83581, 0x09e84f07 },
+    { 0xf4a642e1, 0x4c6262c8 }, { 0x98e7e9cc, 0xcfbd7dbd }, { 0xbf21e440, 0x03acdd2c }, { 0xeeea5d50, 0x04981478 },
+    { 0x95527a52, 0x02df0ccb }, { 0xbaa718e6, 0x8396cffd }, { 0xe950df20, 0x247c83fd }, { 0x91d28b74, 0x16cdd27e },
+    { 0xb6472e51, 0x1c81471d }, { 0xe3d8f9e5, 0x63a198e5 }, { 0x8e679c2f, 0x5e44ff8f }
+};
+
+static void lept_decimal_push(lept_decimal* d, char ch) {
+    if (d->digits < LEPT_DECIMAL_W_DIGITS) {
+        d->w = d->w * 10 + (ch - '0');
+        if (d->w)
+            d->digits++;  /* leading zeros are not significant */
     }
-    if (*p == 'e' || *p == 'E') {
-        p++;
-        if (*p == '+' || *p == '-') p++;
-        if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
-        for (p++; ISDIGIT(*p); p++);
+    else {
+        d->digits++;
+        d->e++;
     }
-    errno = 0;
-    v->u.n = strtod(c->json, NULL);
-    if (errno == ERANGE && (v->u.n == HUGE_VAL || v->u.n == -HUGE_VAL))
-        return LEPT_PARSE_NUMBER_TOO_BIG;
-    v->type = LEPT_NUMBER;
-    c->json = p;
-    return LEPT_PARSE_OK;
 }
 
-static const char* lept_parse_hex4(const char* p, unsigned* u) {
-    /* \TODO */
-    return p;
+static int lept_clz64(uint64_t x) {
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    while (!(x & ((uint64_t)1 << 63))) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+#endif
 }
 
-static void lept_encode_utf8(lept_context* c, unsigned u) {
-    /* \TODO */
+/* returns the high word of a * b, the low word goes to *lo */
+static uint64_t lept_mul64(uint64_t a, uint64_t b, uint64_t* lo) {
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 lept_uint128;
+    lept_uint128 r = (lept_uint128)a * b;
+    *lo = (uint64_t)r;
+    return (uint64_t)(r >> 64);
+#else
+    uint64_t a0 = a & 0xFFFFFFFF, a1 = a >> 32, b0 = b & 0xFFFFFFFF, b1 = b >> 32;
+    uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    uint64_t mid = (p00 >> 32) + (p01 & 0xFFFFFFFF) + (p10 & 0xFFFFFFFF);
+    *lo = (mid << 32) | (p00 & 0xFFFFFFFF);
+    return p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
 }
 
-#define STRING_ERROR(ret) do { c->top = head; return ret; } while(0)
-
-static int lept_parse_string(lept_context* c, lept_value* v) {
-    size_t head = c->top, len;
-    unsigned u;
-    const char* p;
-    EXPECT(c, '\"');
-    p = c->json;
-    for (;;) {
-        char ch = *p++;
-        switch (ch) {
-            case '\"':
-                len = c->top - head;
-                lept_set_string(v, (const char*)lept_context_pop(c, len), len);
-                c->json = p;
-                return LEPT_PARSE_OK;
-            case '\\':
-                switch (*p++) {
-                    case '\"': PUTC(c, '\"'); break;
-                    case '\\': PUTC(c, '\\'); break;
-                    case '/':  PUTC(c, '/' ); break;
-                    case 'b':  PUTC(c, '\b'); break;
-                    case 'f':  PUTC(c, '\f'); break;
-                    case 'n':  PUTC(c, '\n'); break;
-                    case 'r':  PUTC(c, '\r'); break;
-                    case 't':  PUTC(c, '\t'); break;
-                    case 'u':
-                        if (!(p = lept_parse_hex4(p, &u)))
-                            STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
-                        /* \TODO surrogate handling */
-                        lept_encode_utf8(c, u);
-                        break;
-                    default:
-                        STRING_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE);
-                }
-                break;
-            case '\0':
-                STRING_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK);
-            default:
-                if ((unsigned char)ch < 0x20)
-                    STRING_ERROR(LEPT_PARSE_INVALID_STRING_CHAR);
-                PUTC(c, ch);
+/*
+ * Rounds w * 10^q to the bits of a double. Returns 0 when the truncated power of five
+ * leaves the rounding undecided, *bits is then within one ulp of the answer.
+ */
+static int lept_eisel_lemire(uint64_t w, long q, uint64_t* bits) {
+    const uint32_t* t = lept_pow5_table[q + 342];
+    uint64_t hi, lo, m, low, half;
+    int lz = lept_clz64(w), upper, shift;
+    long log2_5q = q >= 0 ? q * 152170L / 65536 : -((-q * 152170L + 65535) / 65536);
+    long e2;
+    w <<= lz;
+    hi = lept_mul64(w, ((uint64_t)t[0] << 32) | t[1], &lo);
+    upper = (int)(hi >> 63);
+    /* w * 10^q = hi:lo * 2^(q - lz - 63 + log2_5q), keep 53 bits of hi */
+    shift = 10 + upper;
+    e2 = 11 + upper + q - lz + log2_5q;
+    if (e2 < -1074) {
+        /* subnormal, fewer bits survive */
+        if (-1074 - e2 >= 64 - shift) {
+            *bits = 0;
+            return 0;
+        }
+        shift += (int)(-1074 - e2);
+        e2 = -1074;
+    }
+    m = hi >> shift;
+    low = hi & (((uint64_t)1 << shift) - 1);
+    half = (uint64_t)1 << (shift - 1);
+    if (q >= 0 && q <= 27) {
+        /* 5^q is exact, so is the product: round half to even */
+        if (low > half || (low == half && (lo != 0 || (m & 1))))
+            m++;
+    }
+    else {
+        /* the true product lies in (hi:lo, hi:lo + w) */
+        if (low + 1 == half && lo + w < lo) {
+            *bits = ((uint64_t)(e2 + 1074) << 52) + m;
+            return 0;
         }
+        if (low >= half)
+            m++;
     }
+    /* a carry out of m moves into the exponent field by itself */
+    *bits = ((uint64_t)(e2 + 1074) << 52) + m;
+    if (*bits > LEPT_DOUBLE_INF_BITS)
+        *bits = LEPT_DOUBLE_INF_BITS;
+    return 1;
 }
 
-static int lept_parse_value(lept_context* c, lept_value* v) {
-    switch (*c->json) {
-        case 't':  return lept_parse_literal(c, v, "true", LEPT_TRUE);
-        case 'f':  return lept_parse_literal(c, v, "false", LEPT_FALSE);
-        case 'n':  return lept_parse_literal(c, v, "null", LEPT_NULL);
-        default:   return lept_parse_number(c, v);
-        case '"':  return lept_parse_string(c, v);
-        case '\0': return LEPT_PARSE_EXPECT_VALUE;
+typedef struct {
+    uint32_t v[LEPT_BIGINT_CAPACITY];  /* little-endian words */
+    int n;
+}lept_bigint;
+
+static void lept_bigint_set(lept_bigint* b, uint64_t x) {
+    b->v[0] = (uint32_t)x;
+    b->v[1] = (uint32_t)(x >> 32);
+    b->n = b->v[1] ? 2 : b->v[0] ? 1 : 0;
+}
+
+/* b = b * m + a */
+static void lept_bigint_mul_add(lept_bigint* b, uint32_t m, uint32_t a) {
+    uint64_t carry = a;
+    int i;
+    for (i = 0; i < b->n; i++) {
+        carry += (uint64_t)b->v[i] * m;
+        b->v[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    if (carry) {
+        assert(b->n < LEPT_BIGINT_CAPACITY);
+        b->v[b->n++] = (uint32_t)carry;
     }
 }
 
-int lept_parse(lept_value* v, const char* json) {
-    lept_context c;
-    int ret;
-    assert(v != NULL);
-    c.json = json;
-    c.stack = NULL;
-    c.size = c.top = 0;
-    lept_init(v);
-    lept_parse_whitespace(&c);
-    if ((ret = lept_parse_value(&c, v)) == LEPT_PARSE_OK) {
-        lept_parse_whitespace(&c);
-        if (*c.json != '\0') {
-            v->type = LEPT_NULL;
-            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
-        }
+static void lept_bigint_mul_pow5(lept_bigint* b, long n) {
+    static const uint32_t pow5[] = { 1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125,
+        9765625, 48828125, 244140625, 1220703125 };
+    for (; n >= 13; n -= 13)
+        lept_bigint_mul_add(b, pow5[13], 0);
+    if (n > 0)
+        lept_bigint_mul_add(b, pow5[n], 0);
+}
+
+static void lept_bigint_shl(lept_bigint* b, long bits) {
+    int words = (int)(bits / 32), s = (int)(bits % 32), i;
+    if (b->n == 0)
+        return;
+    assert(b->n + words < LEPT_BIGINT_CAPACITY);
+    b->v[b->n + words] = 0;
+    for (i = b->n - 1; i >= 0; i--) {
+        if (s)
+            b->v[i + words + 1] |= b->v[i] >> (32 - s);
+        b->v[i + words] = b->v[i] << s;
     }
-    assert(c.top == 0);
-    free(c.stack);
-    return ret;
+    for (i = 0; i < words; i++)
+        b->v[i] = 0;
+    b->n += words + 1;
+    if (b->v[b->n - 1] == 0)
+        b->n--;
 }
 
-void lept_free(lept_value* v) {
-    assert(v != NULL);
-    if (v->type == LEPT_STRING)
-        free(v->u.s.s);
-    v->type = LEPT_NULL;
+static int lept_bigint_cmp(const lept_bigint* a, const lept_bigint* b) {
+    int i;
+    if (a->n != b->n)
+        return a->n < b->n ? -1 : 1;
+    for (i = a->n - 1; i >= 0; i--)
+        if (a->v[i] != b->v[i])
+            return a->v[i] < b->v[i] ? -1 : 1;
+    return 0;
 }
 
-lept_type lept_get_type(const lept_value* v) {
-    assert(v != NULL);
-    return v->type;
+/* all significant digits as an integer D, the value being D * 10^*e (plus a nonzero tail if *sticky) */
+static void lept_decimal_bigint(const lept_decimal* d, lept_bigint* b, long* e, int* sticky) {
+    const char* p = d->int_begin;
+    long kept = 0, dropped = 0;
+    uint32_t chunk = 0, scale = 1;
+    lept_bigint_set(b, 0);
+    *sticky = 0;
+    for (;;) {
+        if (p == d->int_end)
+            p = d->frac_begin;
+        if (p == d->frac_end)
+            break;
+        if (kept == 0 && *p == '0')
+            ;
+        else if (kept < LEPT_BIGINT_MAX_DIGITS) {
+            chunk = chunk * 10 + (*p - '0');
+            scale *= 10;
+            if (++kept % 9 == 0) {
+                lept_bigint_mul_add(b, scale, chunk);
+                chunk = 0;
+                scale = 1;
+            }
+        }
+        else {
+            dropped++;
+            if (*p != '0')
+                *sticky = 1;
+        }
+        p++;
+    }
+    if (scale > 1)
+        lept_bigint_mul_add(b, scale, chunk);
+    *e = d->exp - (long)(d->frac_end - d->frac_begin) + dropped;
 }
 
-int lept_get_boolean(const lept_value* v) {
-    assert(v != NULL && (v->type == LEPT_TRUE || v->type == LEPT_FALSE));
-    return v->type == LEPT_TRUE;
+/* compares D * 10^e against the midpoint between the double given by bits and its successor */
+static int lept_decimal_cmp_halfway(const lept_bigint* digits, long e, int sticky, uint64_t bits) {
+    lept_bigint lhs, rhs;
+    uint64_t m = bits & (LEPT_DOUBLE_HIDDEN_BIT - 1);
+    long k = -1074, le2 = 0, re2;
+    int ret;
+    if (bits >> 52) {
+        m |= LEPT_DOUBLE_HIDDEN_BIT;
+        k = (long)(bits >> 52) - 1075;
+    }
+    lhs = *digits;
+    lept_bigint_set(&rhs, 2 * m + 1);
+    re2 = k - 1;
+    if (e >= 0) {
+        lept_bigint_mul_pow5(&lhs, e);
+        le2 = e;
+    }
+    else {
+        lept_bigint_mul_pow5(&rhs, -e);
+        re2 -= e;
+    }
+    if (le2 > re2)
+        lept_bigint_shl(&lhs, le2 - re2);
+    else
+        lept_bigint_shl(&rhs, re2 - le2);
+    ret = lept_bigint_cmp(&lhs, &rhs);
+    return ret == 0 && sticky ? 1 : ret;
 }
 
-void lept_set_boolean(lept_value* v, int b) {
-    lept_free(v);
-    v->type = b ? LEPT_TRUE : LEPT_FALSE;
+/* moves a candidate within a few ulps to the correctly rounded double */
+static uint64_t lept_decimal_refine(const lept_decimal* d, uint64_t bits) {
+    lept_bigint digits;
+    long e;
+    int sticky, c;
+    lept_decimal_bigint(d, &digits, &e, &sticky);
+    if (bits >= LEPT_DOUBLE_INF_BITS)
+        bits = LEPT_DOUBLE_INF_BITS - 1;
+    for (;;) {
+        if ((c = lept_decimal_cmp_halfway(&digits, e, sticky, bits)) > 0 || (c == 0 && (bits & 1))) {
+            if (++bits == LEPT_DOUBLE_INF_BITS)
+                break;
+        }
+        else if (bits > 0 && ((c = lept_decimal_cmp_halfway(&digits, e, sticky, bits - 1)) < 0 ||
+            (c == 0 && !((bits - 1) & 1))))
+            bits--;
+        else
+            break;
+    }
+    return bits;
 }
 
-double lept_get_number(const lept_value* v) {
-    assert(v != NULL && v->type == LEPT_NUMBER);
-    return v->u.n;
+static int lept_decimal_to_double(const lept_decimal* d, double* n) {
+    long q = d->e + d->exp;
+    long w_digits = d->digits < LEPT_DECIMAL_W_DIGITS ? d->digits : LEPT_DECIMAL_W_DIGITS;
+    uint64_t bits, bits1;
+    if (d->w == 0 || q + w_digits <= -324) {
+        *n = 0.0;  /* below half of the smallest denormal */
+        return LEPT_PARSE_OK;
+    }
+    if (q + w_digits > 309)
+        return LEPT_PARSE_NUMBER_TOO_BIG;
+    if (d->digits <= LEPT_DECIMAL_W_DIGITS && d->w <= (uint64_t)1 << 53) {
+        double x = (double)d->w;
+        if (q >= -22 && q <= 22) {
+            *n = q < 0 ? x / lept_pow10[-q] : x * lept_pow10[q];
+            return LEPT_PARSE_OK;
+        }
+        if (q > 22 && q <= 22 + 15 && (x *= lept_pow10[q - 22]) <= LEPT_DOUBLE_MAX_EXACT) {
+            *n = x * 1e22;
+            return LEPT_PARSE_OK;
+        }
+    }
+    if (d->digits <= LEPT_DECIMAL_W_DIGITS) {
+        if (!lept_eisel_lemire(d->w, q, &bits))
+            bits = lept_decimal_refine(d, bits);
+    }
+    else if (!lept_eisel_lemire(d->w, q, &bits) || !lept_eisel_lemire(d->w + 1, q, &bits1) || bits != bits1)
+        /* digits beyond w: the value lies in [w, w + 1) * 10^q */
+        bits = lept_decimal_refine(d, bits);
+    if (bits >= LEPT_DOUBLE_INF_BITS)
+        return LEPT_PARSE_NUMBER_TOO_BIG;
+    memcpy(n, &bits, sizeof(double));
+    return LEPT_PARSE_OK;
 }
 
-void lept_set_number(lept_value* v, double n) {
-    lept_free(v);
-    v->u.n = n;
+static int lept_parse_number(lept_context* c, lept_value* v) {
+    const char* p = c->json;
+    lept_decimal d;
+    int neg = 0, exp = 0, ret;
+    d.w = 0;
+    d.digits = d.e = d.exp = 0;
+    if (PEEK(c, p) == '-') {
+        neg = 1;
+        p++;
+    }
+    d.int_begin = p;
+    if (PEEK(c, p) == '0') p++;
+    else {
+        if (!ISDIGIT1TO9(PEEK(c, p))) return LEPT_PARSE_INVALID_VALUE;
+        for (; ISDIGIT(PEEK(c, p)); p++)
+            lept_decimal_push(&d, *p);
+    }
+    d.int_end = d.frac_begin = d.frac_end = p;
+    if (PEEK(c, p) == '.') {
+        p++;
+        if (!ISDIGIT(PEEK(c, p))) return LEPT_PARSE_INVALID_VALUE;
+        for (d.frac_begin = p; ISDIGIT(PEEK(c, p)); p++) {
+            lept_decimal_push(&d, *p);
+            d.e--;
+        }
+        d.frac_end = p;
+    }
+    if (PEEK(c, p) == 'e' || PEEK(c, p) == 'E') {
+        int exp_neg = 0;
+        exp = 1;
+        p++;
+        if (PEEK(c, p) == '+') p++;
+        else if (PEEK(c, p) == '-') {
+            exp_neg = 1;
+            p++;
+        }
+        if (!ISDIGIT(PEEK(c, p))) return LEPT_PARSE_INVALID_VALUE;
+        for (; ISDIGIT(PEEK(c, p)); p++)
+            if (d.exp < LEPT_DECIMAL_EXP_MAX)
+                d.exp = d.exp * 10 + (*p - '0');
+        if (exp_neg)
+            d.exp = -d.exp;
+    }
+    if (!exp && d.frac_begin == d.frac_end && d.digits <= LEPT_DECIMAL_W_DIGITS &&
+        d.w <= (uint64_t)INT64_MAX + neg && !(neg && d.w == 0)) {
+        /* integers stay exact and skip the conversion, "-0" remains a double to keep its sign */
+        v->u.i = neg ? -(int64_t)(d.w - 1) - 1 : (int64_t)d.w;
+        v->flags |= LEPT_VALUE_INT64;
+    }
+    else {
+        if ((ret = lept_decimal_to_double(&d, &v->u.n)) != LEPT_PARSE_OK)
+            return ret;
+        if (neg)
+            v->u.n = -v->u.n;
+    }
     v->type = LEPT_NUMBER;
+    c->json = p;
+    return LEPT_PARSE_OK;
 }
 
-const char* lept_get_string(const lept_value* v) {
-    assert(v != NULL && v->type == LEPT_STRING);
-    return v->u.s.s;
-}
+/* the value of every hex digit, -1 for any other character */
+static const signed char lept_hex_digit[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
 
-size_t lept_get_string_length(const lept_value* v) {
-    assert(v != NULL && v->type == LEPT_STRING);
-    return v->u.s.len;
+static const char* lept_parse_hex4(const char* p, unsigned* u) {
+    int h0 = lept_hex_digit[(unsigned char)p[0]], h1 = lept_hex_digit[(unsigned char)p[1]];
+    int h2 = lept_hex_digit[(unsigned char)p[2]], h3 = lept_hex_digit[(unsigned char)p[3]];
+    if ((h0 | h1 | h2 | h3) < 0)
+        return NULL;
+    *u = (unsigned)(h0 << 12 | h1 << 8 | h2 << 4 | h3);
+    return p + 4;
 }
 
-void lept_set_string(lept_value* v, const char* s, size_t len) {
+/* writes at most 4 bytes, returns their end */
+static char* lept_encode_utf8(char* p, unsigned u) {
+    if (u <= 0x7F)
+        *p++ = (char)u;
+    else if (u <= 0x7FF) {
+        *p++ = (char)(0xC0 | (u >> 6));
+        *p++ = (char)(0x80 | (u & 0x3F));
+    }
+    else if (u <= 0xFFFF) {
+        *p++ = (char)(0xE0 | (u >> 12));
+        *p++ = (char)(0x80 | ((u >> 6) & 0x3F));
+        *p++ = (char)(0x80 | (u & 0x3F));
+    }
+    else {
+        assert(u <= 0x10FFFF);
+        *p++ = (char)(0xF0 | (u >> 18));
+        *p++ = (char)(0x80 | ((u >> 12) & 0x3F));
+        *p++ = (char)(0x80 | ((u >> 6) & 0x3F));
+        *p++ = (char)(0x80 | (u & 0x3F));
+    }
+    return p;
+}
+
+#define LEPT_IS_SURROGATE(u)      ((u) >= 0xD800 && (u) <= 0xDFFF)
+#define LEPT_IS_LOW_SURROGATE(u)  ((u) >= 0xDC00 && (u) <= 0xDFFF)
+#define LEPT_SURROGATE_PAIR(h, l) (0x10000 + (((h) - 0xD800) << 10 | ((l) - 0xDC00)))
+
+/* returns the first '\"', '\\' or control character in [p, end), or end */
+static const char* lept_scan_string(const char* p, const char* end) {
+#if defined(LEPT_SIMD_AVX2)
+    const __m256i quote32 = _mm256_set1_epi8('\"'), backslash32 = _mm256_set1_epi8('\\'), ctrl32 = _mm256_set1_epi8(0x1F);
+#endif
+#if defined(LEPT_SIMD_SSE2)
+    const __m128i quote = _mm_set1_epi8('\"'), backslash = _mm_set1_epi8('\\'), ctrl = _mm_set1_epi8(0x1F);
+#elif defined(LEPT_SIMD_NEON)
+    const uint8x16_t quote = vdupq_n_u8('\"'), backslash = vdupq_n_u8('\\'), space = vdupq_n_u8(0x20);
+#endif
+#if defined(LEPT_SIMD_AVX2)
+    for (; end - p >= 32; p += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)p);
+        __m256i t = _mm256_or_si256(_mm256_cmpeq_epi8(s, quote32), _mm256_cmpeq_epi8(s, backslash32));
+        unsigned mask;
+        t = _mm256_or_si256(t, _mm256_cmpeq_epi8(_mm256_min_epu8(s, ctrl32), s)); /* s <= 0x1F */
+        if ((mask = (unsigned)_mm256_movemask_epi8(t)) != 0)
+            return p + LEPT_CTZ(mask);
+    }
+#endif
+#if defined(LEPT_SIMD_SSE2)
+    for (; end - p >= 16; p += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)p);
+        __m128i t = _mm_or_si128(_mm_cmpeq_epi8(s, quote), _mm_cmpeq_epi8(s, backslash));
+        unsigned mask;
+        t = _mm_or_si128(t, _mm_cmpeq_epi8(_mm_min_epu8(s, ctrl), s)); /* s <= 0x1F */
+        if ((mask = (unsigned)_mm_movemask_epi8(t)) != 0)
+            return p + LEPT_CTZ(mask);
+    }
+#elif defined(LEPT_SIMD_NEON)
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t s = vld1q_u8((const uint8_t*)p);
+        uint8x16_t t = vorrq_u8(vorrq_u8(vceqq_u8(s, quote), vceqq_u8(s, backslash)), vcltq_u8(s, space));
+        if (vmaxvq_u8(t)) {
+            /* narrow to one nibble per byte, then find the first set nibble */
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(t), 4)), 0);
+            unsigned lo = (unsigned)mask;
+            return p + (lo ? LEPT_CTZ(lo) : 32 + LEPT_CTZ((unsigned)(mask >> 32))) / 4;
+        }
+    }
+#endif
+    for (; p != end; p++)
+        if (*p == '\"' || *p == '\\' || (unsigned char)*p < 0x20)
+            break;
+    return p;
+}
+
+/*
+ * Stage one of the two-stage parser classifies 64 bytes at a time into bitmaps, bit i for byte
+ * i. An unescaped quotation mark toggles being inside a string, a prefix XOR of them marks
+ * every byte inside from the opening mark on, closing marks excluded.
+ */
+typedef struct {
+    uint64_t quote, backslash, space, op, ctrl;
+}lept_block_masks;
+
+typedef struct {
+    uint64_t inside;    /* all ones when the previous block ended inside a string */
+    int escaped;        /* the first byte is escaped */
+    int scalar;         /* the previous block ended within a literal or number */
+    int dirty;          /* the open string holds escapes or control characters */
+}lept_block_state;
+
+#if defined(LEPT_SIMD_NEON)
+static unsigned lept_movemask_neon(uint8x16_t t) {
+    static const uint8_t bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t m = vandq_u8(t, vld1q_u8(bits));
+    return vaddv_u8(vget_low_u8(m)) | (unsigned)vaddv_u8(vget_high_u8(m)) << 8;
+}
+#endif
+
+static void lept_classify_block(const char* p, lept_block_masks* m) {
+#if defined(LEPT_SIMD_AVX2)
+    const __m256i ctrl = _mm256_set1_epi8(0x1F), lower = _mm256_set1_epi8(0x20);
+    int i;
+    m->quote = m->backslash = m->space = m->op = m->ctrl = 0;
+    for (i = 0; i < 64; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i l = _mm256_or_si256(s, lower);  /* '[' and ']' become '{' and '}' */
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(l, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(l, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(s, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(s, _mm256_set1_epi8(','))));
+        __m256i space = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(s, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(s, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(s, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(s, _mm256_set1_epi8('\r'))));
+        m->quote |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, _mm256_set1_epi8('\"'))) << i;
+        m->backslash |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, _mm256_set1_epi8('\\'))) << i;
+        m->space |= (uint64_t)(unsigned)_mm256_movemask_epi8(space) << i;
+        m->op |= (uint64_t)(unsigned)_mm256_movemask_epi8(op) << i;
+        m->ctrl |= (uint64_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(s, ctrl), s)) << i;
+    }
+#elif defined(LEPT_SIMD_SSE2)
+    const __m128i ctrl = _mm_set1_epi8(0x1F), lower = _mm_set1_epi8(0x20);
+    int i;
+    m->quote = m->backslash = m->space = m->op = m->ctrl = 0;
+    for (i = 0; i < 64; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i l = _mm_or_si128(s, lower);     /* '[' and ']' become '{' and '}' */
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(l, _mm_set1_epi8('{')), _mm_cmpeq_epi8(l, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(s, _mm_set1_epi8(':')), _mm_cmpeq_epi8(s, _mm_set1_epi8(','))));
+        __m128i space = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(s, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(s, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(s, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(s, _mm_set1_epi8('\r'))));
+        m->quote |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(s, _mm_set1_epi8('\"'))) << i;
+        m->backslash |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(s, _mm_set1_epi8('\\'))) << i;
+        m->space |= (uint64_t)_mm_movemask_epi8(space) << i;
+        m->op |= (uint64_t)_mm_movemask_epi8(op) << i;
+        m->ctrl |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(s, ctrl), s)) << i;
+    }
+#elif defined(LEPT_SIMD_NEON)
+    const uint8x16_t lower = vdupq_n_u8(0x20);
+    int i;
+    m->quote = m->backslash = m->space = m->op = m->ctrl = 0;
+    for (i = 0; i < 64; i += 16) {
+        uint8x16_t s = vld1q_u8((const uint8_t*)p + i);
+        uint8x16_t l = vorrq_u8(s, lower);      /* '[' and ']' become '{' and '}' */
+        uint8x16_t op = vorrq_u8(
+            vorrq_u8(vceqq_u8(l, vdupq_n_u8('{')), vceqq_u8(l, vdupq_n_u8('}'))),
+            vorrq_u8(vceqq_u8(s, vdupq_n_u8(':')), vceqq_u8(s, vdupq_n_u8(','))));
+        uint8x16_t space = vorrq_u8(
+            vorrq_u8(vceqq_u8(s, vdupq_n_u8(' ')), vceqq_u8(s, vdupq_n_u8('\t'))),
+            vorrq_u8(vceqq_u8(s, vdupq_n_u8('\n')), vceqq_u8(s, vdupq_n_u8('\r'))));
+        m->quote |= (uint64_t)lept_movemask_neon(vceqq_u8(s, vdupq_n_u8('\"'))) << i;
+        m->backslash |= (uint64_t)lept_movemask_neon(vceqq_u8(s, vdupq_n_u8('\\'))) << i;
+        m->space |= (uint64_t)lept_movemask_neon(space) << i;
+        m->op |= (uint64_t)lept_movemask_neon(op) << i;
+        m->ctrl |= (uint64_t)lept_movemask_neon(vcltq_u8(s, lower)) << i;
+    }
+#else
+    int i;
+    m->quote = m->backslash = m->space = m->op = m->ctrl = 0;
+    for (i = 0; i < 64; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        switch (p[i]) {
+            case '\"': m->quote |= bit; break;
+            case '\\': m->backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',': m->op |= bit; break;
+            case ' ': m->space |= bit; break;
+            case '\t': case '\n': case '\r': m->space |= bit; m->ctrl |= bit; break;
+            default:
+                if ((unsigned char)p[i] < 0x20)
+                    m->ctrl |= bit;
+        }
+    }
+#endif
+}
+
+#define LEPT_ODD_BITS (((uint64_t)0xAAAAAAAAu << 32) | 0xAAAAAAAAu)
+
+/* bit i becomes the XOR of bits 0 to i */
+static uint64_t lept_prefix_xor(uint64_t x) {
+#if defined(LEPT_SIMD_CLMUL)
+    return (uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_cvtsi64_si128((int64_t)x), _mm_set1_epi8(-1), 0));
+#else
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+#endif
+}
+
+/*
+ * The bytes escaped by backslash, *carry tells whether the first one is and becomes whether
+ * the next block's is. A run of backslashes escapes the byte after it when its length is odd.
+ * Adding each run to its first bit carries out of the run and flips the parity of the carry's
+ * position, runs that start on odd and on even bits are told apart by the odd bits.
+ */
+static uint64_t lept_escaped_bits(uint64_t backslash, int* carry) {
+    uint64_t escaped = (uint64_t)*carry, first, code;
+    if (!backslash) {
+        *carry = 0;
+        return escaped;
+    }
+    first = backslash & ~escaped;
+    code = (((first << 1) | LEPT_ODD_BITS) - first) ^ LEPT_ODD_BITS;
+    *carry = (int)((code & backslash) >> 63);
+    return code ^ (backslash | escaped);
+}
+
+/* appends the tokens of the block at offset, t has room for 64 more */
+static void lept_tokens_block(lept_tokens* t, const lept_block_masks* m, uint32_t offset, lept_block_state* s) {
+    uint64_t escaped = lept_escaped_bits(m->backslash, &s->escaped), quote, inside, closing, scalar, special, bits;
+    uint32_t* pos = t->pos + t->size;
+    quote = m->quote & ~escaped;
+    inside = lept_prefix_xor(quote) ^ s->inside;
+    s->inside = (uint64_t)0 - (inside >> 63);
+    closing = quote & ~inside;
+    /* literals and numbers are recorded by their first byte */
+    scalar = ~(m->op | m->space | m->quote | inside);
+    bits = (m->op & ~inside) | quote | (scalar & ~(scalar << 1 | (uint64_t)s->scalar));
+    s->scalar = (int)(scalar >> 63);
+    special = (m->backslash | m->ctrl) & inside;
+    if (!special && !s->dirty) {
+        for (; bits; bits &= bits - 1)
+            *pos++ = offset + LEPT_CTZ64(bits);
+    }
+    else {
+        for (bits |= special; bits; bits &= bits - 1) {
+            unsigned i = LEPT_CTZ64(bits);
+            if (special >> i & 1)
+                s->dirty = 1;
+            else if (closing >> i & 1) {
+                *pos++ = (offset + i) | (s->dirty ? LEPT_TOKEN_DIRTY : 0);
+                s->dirty = 0;
+            }
+            else
+                *pos++ = offset + i;
+        }
+    }
+    t->size = pos - t->pos;
+}
+
+/* stage one, fails for input too long for the offsets */
+static int lept_tokens_build(lept_tokens* t, const char* json, size_t len) {
+    lept_block_state s;
+    lept_block_masks m;
+    char tail[64];
+    size_t i;
+    if (len >= LEPT_TOKEN_DIRTY)
+        return 0;
+    s.inside = 0;
+    s.escaped = s.scalar = s.dirty = 0;
+    t->base = json;
+    t->size = t->next = 0;
+    for (i = 0; ; i += 64) {
+        const char* p = json + i;
+        if (t->capacity - t->size < 64 + 1) {
+            t->capacity += t->capacity >> 1;
+            if (t->capacity < t->size + 64 + 1)
+                t->capacity = t->size + 64 + 1 + len / 8;
+            t->pos = (uint32_t*)LEPT_REALLOC(t->pos, t->capacity * sizeof(uint32_t));
+        }
+        if (len - i < 64) {
+            if (len == i)
+                break;
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, p, len - i);
+            p = tail;
+        }
+        lept_classify_block(p, &m);
+        lept_tokens_block(t, &m, (uint32_t)i, &s);
+        if (len - i <= 64)
+            break;
+    }
+    t->pos[t->size++] = (uint32_t)len;
+    return 1;
+}
+
+#if defined(LEPT_SIMD_AVX2) || defined(LEPT_SIMD_SSSE3) || defined(LEPT_SIMD_NEON)
+/*
+ * Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte": three nibble
+ * lookups classify every pair of adjacent bytes, the third and fourth bytes of sequences are
+ * checked against the leads two and three bytes back. The tables serve every vector width.
+ */
+#define LEPT_UTF8_TOO_SHORT  0x01
+#define LEPT_UTF8_TOO_LONG   0x02
+#define LEPT_UTF8_OVERLONG_3 0x04
+#define LEPT_UTF8_TOO_LARGE  0x08
+#define LEPT_UTF8_SURROGATE  0x10
+#define LEPT_UTF8_OVERLONG_2 0x20
+#define LEPT_UTF8_TOO_LARGE_1000 0x40
+#define LEPT_UTF8_OVERLONG_4 0x40
+#define LEPT_UTF8_TWO_CONTS  0x80
+#define LEPT_UTF8_CARRY      (LEPT_UTF8_TOO_SHORT | LEPT_UTF8_TOO_LONG | LEPT_UTF8_TWO_CONTS)
+
+static const char lept_utf8_byte_1_high[16] = {
+    LEPT_UTF8_TOO_LONG, LEPT_UTF8_TOO_LONG, LEPT_UTF8_TOO_LONG, LEPT_UTF8_TOO_LONG,
+    LEPT_UTF8_TOO_LONG, LEPT_UTF8_TOO_LONG, LEPT_UTF8_TOO_LONG, LEPT_UTF8_TOO_LONG,
+    (char)LEPT_UTF8_TWO_CONTS, (char)LEPT_UTF8_TWO_CONTS, (char)LEPT_UTF8_TWO_CONTS, (char)LEPT_UTF8_TWO_CONTS,
+    LEPT_UTF8_TOO_SHORT | LEPT_UTF8_OVERLONG_2,
+    LEPT_UTF8_TOO_SHORT,
+    LEPT_UTF8_TOO_SHORT | LEPT_UTF8_OVERLONG_3 | LEPT_UTF8_SURROGATE,
+    LEPT_UTF8_TOO_SHORT | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000 | LEPT_UTF8_OVERLONG_4
+};
+static const char lept_utf8_byte_1_low[16] = {
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_OVERLONG_3 | LEPT_UTF8_OVERLONG_2 | LEPT_UTF8_OVERLONG_4),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_OVERLONG_2),
+    (char)LEPT_UTF8_CARRY,
+    (char)LEPT_UTF8_CARRY,
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000 | LEPT_UTF8_SURROGATE),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000),
+    (char)(LEPT_UTF8_CARRY | LEPT_UTF8_TOO_LARGE | LEPT_UTF8_TOO_LARGE_1000)
+};
+static const char lept_utf8_byte_2_high[16] = {
+    LEPT_UTF8_TOO_SHORT, LEPT_UTF8_TOO_SHORT, LEPT_UTF8_TOO_SHORT, LEPT_UTF8_TOO_SHORT,
+    LEPT_UTF8_TOO_SHORT, LEPT_UTF8_TOO_SHORT, LEPT_UTF8_TOO_SHORT, LEPT_UTF8_TOO_SHORT,
+    (char)(LEPT_UTF8_TOO_LONG | LEPT_UTF8_OVERLONG_2 | LEPT_UTF8_TWO_CONTS | LEPT_UTF8_OVERLONG_3 | LEPT_UTF8_TOO_LARGE_1000 | LEPT_UTF8_OVERLONG_4),
+    (char)(LEPT_UTF8_TOO_LONG | LEPT_UTF8_OVERLONG_2 | LEPT_UTF8_TWO_CONTS | LEPT_UTF8_OVERLONG_3 | LEPT_UTF8_TOO_LARGE),
+    (char)(LEPT_UTF8_TOO_LONG | LEPT_UTF8_OVERLONG_2 | LEPT_UTF8_TWO_CONTS | LEPT_UTF8_SURROGATE | LEPT_UTF8_TOO_LARGE),
+    (char)(LEPT_UTF8_TOO_LONG | LEPT_UTF8_OVERLONG_2 | LEPT_UTF8_TWO_CONTS | LEPT_UTF8_SURROGATE | LEPT_UTF8_TOO_LARGE),
+    LEPT_UTF8_TOO_SHORT, LEPT_UTF8_TOO_SHORT, LEPT_UTF8_TOO_SHORT, LEPT_UTF8_TOO_SHORT
+};
+#endif
+
+#if defined(LEPT_SIMD_AVX2)
+static __m256i lept_utf8_lookup(const char* table, __m256i index) {
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)table)), index);
+}
+
+static __m256i lept_utf8_check(__m256i input, __m256i prev_input) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    /* the input shifted right by one to three bytes, continued from the previous block */
+    __m256i carry = _mm256_permute2x128_si256(prev_input, input, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(input, carry, 15);
+    __m256i prev2 = _mm256_alignr_epi8(input, carry, 14);
+    __m256i prev3 = _mm256_alignr_epi8(input, carry, 13);
+    __m256i sc = _mm256_and_si256(
+        _mm256_and_si256(
+            lept_utf8_lookup(lept_utf8_byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+            lept_utf8_lookup(lept_utf8_byte_1_low, _mm256_and_si256(prev1, nibble))),
+        lept_utf8_lookup(lept_utf8_byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+    /* only leads of three and four bytes have a 0x80 here */
+    __m256i must23 = _mm256_or_si256(
+        _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80))),
+        _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80))));
+    return _mm256_xor_si256(_mm256_and_si256(must23, _mm256_set1_epi8((char)0x80)), sc);
+}
+#elif defined(LEPT_SIMD_SSSE3)
+static __m128i lept_utf8_lookup(const char* table, __m128i index) {
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)table), index);
+}
+
+static __m128i lept_utf8_check(__m128i input, __m128i prev_input) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+    __m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+    __m128i sc = _mm_and_si128(
+        _mm_and_si128(
+            lept_utf8_lookup(lept_utf8_byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+            lept_utf8_lookup(lept_utf8_byte_1_low, _mm_and_si128(prev1, nibble))),
+        lept_utf8_lookup(lept_utf8_byte_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+    __m128i must23 = _mm_or_si128(
+        _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80))),
+        _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80))));
+    return _mm_xor_si128(_mm_and_si128(must23, _mm_set1_epi8((char)0x80)), sc);
+}
+#elif defined(LEPT_SIMD_NEON)
+static uint8x16_t lept_utf8_lookup(const char* table, uint8x16_t index) {
+    return vqtbl1q_u8(vld1q_u8((const uint8_t*)table), index);
+}
+
+static uint8x16_t lept_utf8_check(uint8x16_t input, uint8x16_t prev_input) {
+    const uint8x16_t nibble = vdupq_n_u8(0x0F);
+    uint8x16_t prev1 = vextq_u8(prev_input, input, 15);
+    uint8x16_t prev2 = vextq_u8(prev_input, input, 14);
+    uint8x16_t prev3 = vextq_u8(prev_input, input, 13);
+    uint8x16_t sc = vandq_u8(
+        vandq_u8(
+            lept_utf8_lookup(lept_utf8_byte_1_high, vshrq_n_u8(prev1, 4)),
+            lept_utf8_lookup(lept_utf8_byte_1_low, vandq_u8(prev1, nibble))),
+        lept_utf8_lookup(lept_utf8_byte_2_high, vshrq_n_u8(input, 4)));
+    uint8x16_t must23 = vorrq_u8(
+        vqsubq_u8(prev2, vdupq_n_u8(0xE0 - 0x80)),
+        vqsubq_u8(prev3, vdupq_n_u8(0xF0 - 0x80)));
+    return veorq_u8(vandq_u8(must23, vdupq_n_u8(0x80)), sc);
+}
+#else
+/* one ill-formed sequence by Table 3-7 of the Unicode standard, p[0] >= 0x80 */
+static int lept_utf8_invalid(const unsigned char* p, const unsigned char* end, size_t* n) {
+    unsigned char lo = 0x80, hi = 0xBF;
+    size_t i;
+    if (*p < 0xC2 || *p > 0xF4)
+        return 1;
+    *n = *p < 0xE0 ? 2 : *p < 0xF0 ? 3 : 4;
+    if ((size_t)(end - p) < *n)
+        return 1;
+    switch (*p) {
+        case 0xE0: lo = 0xA0; break;
+        case 0xED: hi = 0x9F; break;  /* no surrogates */
+        case 0xF0: lo = 0x90; break;
+        case 0xF4: hi = 0x8F; break;  /* nothing beyond U+10FFFF */
+    }
+    if (p[1] < lo || p[1] > hi)
+        return 1;
+    for (i = 2; i < *n; i++)
+        if ((p[i] & 0xC0) != 0x80)
+            return 1;
+    return 0;
+}
+#endif
+
+/* returns non-zero when [p, end) is well-formed UTF-8 */
+static int lept_validate_utf8(const char* p, const char* end) {
+    const unsigned char* u = (const unsigned char*)p;
+    const unsigned char* e = (const unsigned char*)end;
+#if defined(LEPT_SIMD_AVX2)
+    /* a block that ends inside a sequence must be followed by its continuation bytes */
+    const __m256i incomplete = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    __m256i prev_input = _mm256_setzero_si256(), prev_incomplete = _mm256_setzero_si256(), error = _mm256_setzero_si256();
+    unsigned char tail[32];
+    for (;; u += 32) {
+        __m256i input;
+        if (e - u >= 32)
+            input = _mm256_loadu_si256((const __m256i*)u);
+        else {
+            /* padding with ASCII ends any sequence cut short */
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, u, e - u);
+            input = _mm256_loadu_si256((const __m256i*)tail);
+        }
+        if (_mm256_movemask_epi8(input) == 0)
+            error = _mm256_or_si256(error, prev_incomplete);
+        else {
+            error = _mm256_or_si256(error, lept_utf8_check(input, prev_input));
+            prev_incomplete = _mm256_subs_epu8(input, incomplete);
+        }
+        prev_input = input;
+        if (e - u <= 32)
+            break;
+    }
+    error = _mm256_or_si256(error, prev_incomplete);
+    return _mm256_testz_si256(error, error);
+#elif defined(LEPT_SIMD_SSSE3)
+    const __m128i incomplete = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    __m128i prev_input = _mm_setzero_si128(), prev_incomplete = _mm_setzero_si128(), error = _mm_setzero_si128();
+    unsigned char tail[16];
+    for (;; u += 16) {
+        __m128i input;
+        if (e - u >= 16)
+            input = _mm_loadu_si128((const __m128i*)u);
+        else {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, u, e - u);
+            input = _mm_loadu_si128((const __m128i*)tail);
+        }
+        if (_mm_movemask_epi8(input) == 0)
+            error = _mm_or_si128(error, prev_incomplete);
+        else {
+            error = _mm_or_si128(error, lept_utf8_check(input, prev_input));
+            prev_incomplete = _mm_subs_epu8(input, incomplete);
+        }
+        prev_input = input;
+        if (e - u <= 16)
+            break;
+    }
+    error = _mm_or_si128(error, prev_incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+#elif defined(LEPT_SIMD_NEON)
+    static const uint8_t incomplete_bytes[16] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+    };
+    const uint8x16_t incomplete = vld1q_u8(incomplete_bytes);
+    uint8x16_t prev_input = vdupq_n_u8(0), prev_incomplete = vdupq_n_u8(0), error = vdupq_n_u8(0);
+    unsigned char tail[16];
+    for (;; u += 16) {
+        uint8x16_t input;
+        if (e - u >= 16)
+            input = vld1q_u8(u);
+        else {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, u, e - u);
+            input = vld1q_u8(tail);
+        }
+        if (vmaxvq_u8(input) < 0x80)
+            error = vorrq_u8(error, prev_incomplete);
+        else {
+            error = vorrq_u8(error, lept_utf8_check(input, prev_input));
+            prev_incomplete = vqsubq_u8(input, incomplete);
+        }
+        prev_input = input;
+        if (e - u <= 16)
+            break;
+    }
+    error = vorrq_u8(error, prev_incomplete);
+    return vmaxvq_u8(error) == 0;
+#else
+    size_t n;
+    while (u != e) {
+        /* skip ASCII a word at a time */
+        while (e - u >= 8) {
+            uint64_t w;
+            memcpy(&w, u, sizeof(w));
+            if (w & ((uint64_t)0x80808080 << 32 | 0x80808080))
+                break;
+            u += 8;
+        }
+        for (; u != e && *u < 0x80; u++);
+        if (u == e)
+            break;
+        if (lept_utf8_invalid(u, e, &n))
+            return 0;
+        u += n;
+    }
+    return 1;
+#endif
+}
+
+#define STRING_ERROR(ret) do { c->top = head; LEPT_STATS_STOP(c, LEPT_PHASE_STRING); return ret; } while(0)
+
+/* in-situ parsing decodes into the input itself, the output never overtakes the input */
+#define STRING_PUTC(c, dst, ch) do { if (dst) *dst++ = (ch); else PUTC(c, ch); } while(0)
+
+/* decodes onto the stack and pops it again, *str stays valid until the next push */
+static int lept_parse_string_raw(lept_context* c, const char** str, size_t* len) {
+    size_t head = c->top;
+    unsigned u;
+    const char* p;
+    char *begin = NULL, *dst = NULL;
+    EXPECT(c, '\"');
+    LEPT_STATS_START(c, LEPT_PHASE_STRING);
+    p = c->json;
+    /* the index knows where a clean string ends, no need to look at it before the check */
+    if (c->tokens) {
+        lept_tokens* t = c->tokens;
+        size_t i = lept_tokens_find(t, p - 1);
+        if (t->pos[i] == (uint32_t)(p - 1 - t->base) && t->pos[i + 1] < t->pos[t->size - 1]) {
+            const char* q = t->base + t->pos[i + 1];
+            t->next = i + 2;
+            if (c->insitu)
+                *(char*)q = '\0';
+            *str = p;
+            *len = q - p;
+            if (c->utf8 && !lept_validate_utf8(*str, *str + *len))
+                STRING_ERROR(LEPT_PARSE_INVALID_UTF8);
+            c->json = q + 1;
+            LEPT_STATS_STOP(c, LEPT_PHASE_STRING);
+            return LEPT_PARSE_OK;
+        }
+    }
+    if (c->insitu)
+        begin = dst = (char*)p;
+    for (;;) {
+        char ch;
+        /* runs of escapes, as in text of \uXXXX, skip the scan */
+        const char* q = p != c->end && *p == '\\' ? p : lept_scan_string(p, c->end);
+        if (q != p) {
+            /* copy the run of unescaped characters in one go */
+            if (!dst)
+                memcpy(lept_context_push(c, q - p), p, q - p);
+            else {
+                if (dst != p)
+                    memmove(dst, p, q - p);
+                dst += q - p;
+            }
+            p = q;
+        }
+        if (p == c->end)
+            STRING_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK);
+        ch = *p++;
+        switch (ch) {
+            case '\"':
+                if (dst) {
+                    *dst = '\0';  /* at most overwrites the closing quotation mark */
+                    *str = begin;
+                    *len = dst - begin;
+                }
+                else {
+                    /* the stack may not even exist for an empty string */
+                    *len = c->top - head;
+                    *str = *len ? (const char*)lept_context_pop(c, *len) : "";
+                }
+                /* escapes decode to whole sequences, checking the result checks the input */
+                if (c->utf8 && !lept_validate_utf8(*str, *str + *len))
+                    STRING_ERROR(LEPT_PARSE_INVALID_UTF8);
+                c->json = p;
+                LEPT_STATS_STOP(c, LEPT_PHASE_STRING);
+                return LEPT_PARSE_OK;
+            case '\\':
+                if (p == c->end)
+                    STRING_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE);
+                LEPT_STATS_ADD(c, escapes, 1);
+                switch (*p++) {
+                    case '\"': STRING_PUTC(c, dst, '\"'); break;
+                    case '\\': STRING_PUTC(c, dst, '\\'); break;
+                    case '/':  STRING_PUTC(c, dst, '/' ); break;
+                    case 'b':  STRING_PUTC(c, dst, '\b'); break;
+                    case 'f':  STRING_PUTC(c, dst, '\f'); break;
+                    case 'n':  STRING_PUTC(c, dst, '\n'); break;
+                    case 'r':  STRING_PUTC(c, dst, '\r'); break;
+                    case 't':  STRING_PUTC(c, dst, '\t'); break;
+                    case 'u':
+                        if (c->end - p < 4 || !(p = lept_parse_hex4(p, &u)))
+                            STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
+                        if (LEPT_IS_SURROGATE(u)) {
+                            unsigned low;
+                            if (LEPT_IS_LOW_SURROGATE(u) || c->end - p < 2 || p[0] != '\\' || p[1] != 'u')
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+                            if (c->end - (p += 2) < 4 || !(p = lept_parse_hex4(p, &low)))
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
+                            if (!LEPT_IS_LOW_SURROGATE(low))
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+                            u = LEPT_SURROGATE_PAIR(u, low);
+                        }
+                        /* an escape is longer than its UTF-8, in-situ output stays behind p */
+                        if (dst)
+                            dst = lept_encode_utf8(dst, u);
+                        else
+                            c->top = lept_encode_utf8((char*)lept_context_push(c, 4), u) - c->stack;
+                        break;
+                    default:
+                        STRING_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE);
+                }
+                break;
+            default:
+                if ((unsigned char)ch < 0x20)
+                    STRING_ERROR(LEPT_PARSE_INVALID_STRING_CHAR);
+                STRING_PUTC(c, dst, ch);
+        }
+    }
+}
+
+static int lept_parse_string(lept_context* c) {
+    const char* s;
+    size_t len;
+    int ret;
+    if ((ret = lept_parse_string_raw(c, &s, &len)) != LEPT_PARSE_OK)
+        return ret;
+    return LEPT_EMIT(c, on_string, (c->handler_ctx, s, len));
+}
+
+/* checks the grammar of a number without converting it */
+static int lept_skip_number(lept_context* c) {
+    const char* p = c->json;
+    if (PEEK(c, p) == '-') p++;
+    if (PEEK(c, p) == '0') p++;
+    else {
+        if (!ISDIGIT1TO9(PEEK(c, p))) return LEPT_PARSE_INVALID_VALUE;
+        for (p++; ISDIGIT(PEEK(c, p)); p++);
+    }
+    if (PEEK(c, p) == '.') {
+        p++;
+        if (!ISDIGIT(PEEK(c, p))) return LEPT_PARSE_INVALID_VALUE;
+        for (p++; ISDIGIT(PEEK(c, p)); p++);
+    }
+    if (PEEK(c, p) == 'e' || PEEK(c, p) == 'E') {
+        p++;
+        if (PEEK(c, p) == '+' || PEEK(c, p) == '-') p++;
+        if (!ISDIGIT(PEEK(c, p))) return LEPT_PARSE_INVALID_VALUE;
+        for (p++; ISDIGIT(PEEK(c, p)); p++);
+    }
+    c->json = p;
+    return LEPT_PARSE_OK;
+}
+
+static lept_value* lept_build_push(void* ctx);
+
+/* records the span of a number or an escape-free string, anything else is parsed as usual */
+static int lept_parse_lazy_value(lept_context* c) {
+    const char* begin = c->json;
+    size_t len;
+    lept_type type = LEPT_NUMBER;
+    lept_value* v;
+    int ret;
+    if (*begin == '"') {
+        const char* q = lept_scan_string(++begin, c->end);
+        if (q == c->end || *q != '"')
+            return lept_parse_string(c);
+        if (c->utf8 && !lept_validate_utf8(begin, q))
+            return LEPT_PARSE_INVALID_UTF8;
+        len = q - begin;
+        c->json = q + 1;
+        type = LEPT_STRING;
+    }
+    else {
+        if ((ret = lept_skip_number(c)) != LEPT_PARSE_OK)
+            return ret;
+        len = c->json - begin;
+    }
+    v = lept_build_push(c);
+    v->type = type;
+    v->flags = LEPT_VALUE_LAZY | LEPT_VALUE_EXTERNAL;
+    v->u.s.s = (char*)begin;
+    v->u.s.len = len;
+    return LEPT_PARSE_OK;
+}
+
+/* decodes a lazy value where it lies on its first access, the accessors see no difference */
+static void lept_materialize(const lept_value* v) {
+    lept_value* m = (lept_value*)v;
+    const char* s = v->u.s.s;
+    size_t len = v->u.s.len;
+    if (v->type == LEPT_STRING)
+        lept_set_string(m, s, len);
+    else {
+        lept_context c;
+        lept_value n;
+        lept_context_init(&c, NULL);
+        c.json = s;
+        c.end = s + len;
+        lept_init(&n);
+        if (lept_parse_number(&c, &n) != LEPT_PARSE_OK) {
+            /* out of range, which lept_parse() reports as LEPT_PARSE_NUMBER_TOO_BIG */
+            uint64_t bits = LEPT_DOUBLE_INF_BITS;
+            memcpy(&n.u.n, &bits, sizeof(double));
+            if (*s == '-')
+                n.u.n = -n.u.n;
+            n.type = LEPT_NUMBER;
+        }
+        *m = n;
+    }
+}
+
+#define LEPT_MATERIALIZE(v) do { if ((v)->flags & LEPT_VALUE_LAZY) lept_materialize(v); } while(0)
+
+static int lept_parse_value(lept_context* c);
+
+/* a key with the colon and whitespace around it, c->json is after the '{' or ',' */
+static int lept_parse_member_key(lept_context* c) {
+    const char* k;
+    size_t klen;
+    int ret;
+    if (PEEK(c, c->json) != '"')
+        return LEPT_PARSE_MISS_KEY;
+    if ((ret = lept_parse_string_raw(c, &k, &klen)) != LEPT_PARSE_OK ||
+        (ret = LEPT_EMIT(c, on_key, (c->handler_ctx, k, klen))) != LEPT_PARSE_OK)
+        return ret;
+    lept_parse_whitespace(c);
+    if (PEEK(c, c->json) != ':')
+        return LEPT_PARSE_MISS_COLON;
+    c->json++;
+    lept_parse_whitespace(c);
+    return LEPT_PARSE_OK;
+}
+
+/*
+ * Arrays and objects nest in a loop rather than by recursion, so the C stack stays flat
+ * whatever the input. The innermost container is kept in locals, a frame per outer one
+ * keeps its kind and member count: the first LEPT_PARSE_FRAMES of them here and deeper
+ * ones on the heap, up to c->max_depth.
+ */
+static int lept_parse_nested(lept_context* c) {
+    lept_stream_frame local[LEPT_PARSE_FRAMES], *frames = local;
+    size_t depth = 0, capacity = LEPT_PARSE_FRAMES, size = 0;
+    int object = 0, ret = LEPT_PARSE_OK;
+    assert(*c->json == '[' || *c->json == '{');
+    do {
+        if (c->json != c->end && (*c->json == '[' || *c->json == '{')) {
+            if (depth == c->max_depth) {
+                ret = LEPT_PARSE_TOO_DEEP;
+                break;
+            }
+            if (depth) {
+                if (depth - 1 == capacity) {
+                    capacity += capacity >> 1;
+                    if (frames == local)
+                        frames = (lept_stream_frame*)memcpy(LEPT_MALLOC(capacity * sizeof(lept_stream_frame)), local, sizeof(local));
+                    else
+                        frames = (lept_stream_frame*)LEPT_REALLOC(frames, capacity * sizeof(lept_stream_frame));
+                }
+                frames[depth - 1].size = size;
+                frames[depth - 1].object = object;
+                /* the root was counted by lept_parse_value() */
+                LEPT_STATS_ADD(c, values[*c->json == '{' ? LEPT_OBJECT : LEPT_ARRAY], 1);
+            }
+            depth++;
+            size = 0;
+            object = *c->json++ == '{';
+            if ((ret = object ?
+                LEPT_EMIT(c, on_start_object, (c->handler_ctx)) :
+                LEPT_EMIT(c, on_start_array, (c->handler_ctx))) != LEPT_PARSE_OK)
+                break;
+            lept_parse_whitespace(c);
+            if (PEEK(c, c->json) != (object ? '}' : ']')) {
+                if (object)
+                    ret = lept_parse_member_key(c);
+                continue;
+            }
+        }
+        else {
+            if ((ret = lept_parse_value(c)) != LEPT_PARSE_OK)
+                break;
+            size++;
+            lept_parse_whitespace(c);
+        }
+        /* after a member: a comma, or the end of this container and perhaps of more */
+        for (;;) {
+            if (PEEK(c, c->json) == ',') {
+                c->json++;
+                lept_parse_whitespace(c);
+                if (object)
+                    ret = lept_parse_member_key(c);
+                break;
+            }
+            if (PEEK(c, c->json) != (object ? '}' : ']')) {
+                ret = object ? LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+                break;
+            }
+            c->json++;
+            if ((ret = object ?
+                LEPT_EMIT(c, on_end_object, (c->handler_ctx, size)) :
+                LEPT_EMIT(c, on_end_array, (c->handler_ctx, size))) != LEPT_PARSE_OK || --depth == 0)
+                break;
+            size = frames[depth - 1].size + 1;
+            object = frames[depth - 1].object;
+            lept_parse_whitespace(c);
+        }
+    } while (ret == LEPT_PARSE_OK && depth);
+    if (frames != local)
+        LEPT_FREE(frames);
+    return ret;
+}
+
+/* the type a value starting with ch has, LEPT_NULL for null and for garbage alike */
+static lept_type lept_peek_type(char ch) {
+    switch (ch) {
+        case 't':  return LEPT_TRUE;
+        case 'f':  return LEPT_FALSE;
+        case '"':  return LEPT_STRING;
+        case '[':  return LEPT_ARRAY;
+        case '{':  return LEPT_OBJECT;
+        default:   return ch == '-' || ISDIGIT(ch) ? LEPT_NUMBER : LEPT_NULL;
+    }
+}
+
+static int lept_parse_value(lept_context* c) {
+    lept_value n;
+    int ret;
+    if (c->json == c->end)
+        return LEPT_PARSE_EXPECT_VALUE;
+#ifdef LEPT_STATS
+    if (c->stats && (lept_peek_type(*c->json) != LEPT_NULL || *c->json == 'n'))
+        c->stats->values[lept_peek_type(*c->json)]++;
+#endif
+    switch (*c->json) {
+        case 't':  return lept_parse_literal(c, "true", LEPT_TRUE);
+        case 'f':  return lept_parse_literal(c, "false", LEPT_FALSE);
+        case 'n':  return lept_parse_literal(c, "null", LEPT_NULL);
+        default:
+            if (c->lazy)
+                return lept_parse_lazy_value(c);
+            lept_init(&n);
+            LEPT_STATS_START(c, LEPT_PHASE_NUMBER);
+            ret = lept_parse_number(c, &n);
+            LEPT_STATS_STOP(c, LEPT_PHASE_NUMBER);
+            if (ret != LEPT_PARSE_OK)
+                return ret;
+            return lept_emit_number(c, &n);
+        case '"':  return c->lazy ? lept_parse_lazy_value(c) : lept_parse_string(c);
+        case '[':
+        case '{':  return lept_parse_nested(c);
+    }
+}
+
+static lept_stats_func lept_stats_handler = NULL;
+static void* lept_stats_ctx = NULL;
+
+void lept_set_stats_handler(lept_stats_func func, void* ctx) {
+    lept_stats_handler = func;
+    lept_stats_ctx = ctx;
+}
+
+#ifdef LEPT_STATS
+/* the sample is picked from the clock rather than a shared counter, parsers may run in several threads */
+static void lept_stats_begin(lept_context* c) {
+    uint64_t t;
+    c->stats = NULL;
+    if (!lept_stats_handler)
+        return;
+    memset(&c->counted, 0, sizeof(c->counted));
+    t = lept_ticks();
+    c->counted.timed = LEPT_STATS_SAMPLE > 0 &&
+        ((uint32_t)(t ^ (t >> 17)) * 2654435761u >> 16) % (LEPT_STATS_SAMPLE > 0 ? LEPT_STATS_SAMPLE : 1) == 0;
+    c->stats = &c->counted;
+}
+
+static void lept_stats_end(lept_context* c, const char* json, int ret) {
+    if (!c->stats)
+        return;
+    c->stats->bytes = (size_t)(c->json - json);
+    c->stats->stack_size = c->size;
+    c->stats->error = ret;
+    c->stats = NULL;
+    lept_stats_handler(lept_stats_ctx, &c->counted);
+}
+#endif
+
+/* the stack keeps its capacity between documents, only the top is reset */
+static int lept_parse_root(lept_context* c, const char* json, size_t len) {
+    int ret;
+    assert(json != NULL || len == 0);
+    c->json = json;
+    c->end = json + len;
+    c->top = 0;
+    LEPT_STATS_BEGIN(c);
+    lept_parse_whitespace(c);
+    if ((ret = lept_parse_value(c)) == LEPT_PARSE_OK) {
+        lept_parse_whitespace(c);
+        if (c->json != c->end)
+            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+    }
+    LEPT_STATS_END(c, json, ret);
+    return ret;
+}
+
+/*
+ * The DOM is one more handler: finished values wait on the stack until their container ends,
+ * an object keeps each key as a string value right below its member value.
+ */
+static void* lept_context_alloc(lept_context* c, size_t size) {
+    return c->arena ? lept_arena_alloc(c->arena, size) : LEPT_MALLOC(size);
+}
+
+static lept_value* lept_build_push(void* ctx) {
+    lept_value* v = (lept_value*)lept_context_push((lept_context*)ctx, sizeof(lept_value));
+    lept_init(v);
+    return v;
+}
+
+static int lept_build_null(void* ctx) {
+    lept_build_push(ctx);
+    return 0;
+}
+
+static int lept_build_boolean(void* ctx, int b) {
+    lept_build_push(ctx)->type = b ? LEPT_TRUE : LEPT_FALSE;
+    return 0;
+}
+
+/* object keys by FNV-1a */
+static uint32_t lept_hash_key(const char* k, size_t klen) {
+    uint32_t h = 2166136261u;
+    while (klen--)
+        h = (h ^ (unsigned char)*k++) * 16777619u;
+    return h;
+}
+
+/* members are numbered from 1 in the slots, 0 marks a free one */
+#define LEPT_OBJECT_INDEX_MAX ((size_t)0x7FFFFFFF)
+
+/* the open addressing index of an object of size members, a power of two at most half full */
+static size_t lept_index_slots(size_t size) {
+    size_t n = 1;
+    while (n < 2 * size)
+        n <<= 1;
+    return n;
+}
+
+/* members are inserted in order, so the first of duplicate keys is found first */
+static void lept_index_build(lept_value* v) {
+    uint32_t* index = (uint32_t*)(v->u.o.m + v->u.o.size);
+    size_t mask = lept_index_slots(v->u.o.size) - 1, i, j;
+    memset(index, 0, (mask + 1) * sizeof(uint32_t));
+    for (i = 0; i < v->u.o.size; i++) {
+        for (j = lept_hash_key(v->u.o.m[i].k, v->u.o.m[i].klen) & mask; index[j]; j = (j + 1) & mask)
+            ;
+        index[j] = (uint32_t)(i + 1);
+    }
+}
+
+static int lept_build_number(void* ctx, double n) {
+    lept_set_number(lept_build_push(ctx), n);
+    return 0;
+}
+
+static int lept_build_int64(void* ctx, int64_t i) {
+    lept_set_int64(lept_build_push(ctx), i);
+    return 0;
+}
+
+static int lept_build_string(void* ctx, const char* s, size_t len) {
+    lept_context* c = (lept_context*)ctx;
+    lept_value v;
+    lept_init(&v);
+    if (c->insitu) {
+        v.u.s.s = (char*)s;  /* decoded and null-terminated in the input */
+        v.u.s.len = len;
+        v.type = LEPT_STRING;
+        v.flags |= LEPT_VALUE_EXTERNAL;
+    }
+    else if (!c->arena || len <= LEPT_SHORT_STRING_MAX)
+        lept_set_string(&v, s, len);
+    else {
+        v.u.s.s = (char*)lept_arena_alloc(c->arena, len + 1);
+        memcpy(v.u.s.s, s, len);
+        v.u.s.s[len] = '\0';
+        v.u.s.len = len;
+        v.type = LEPT_STRING;
+        v.flags |= LEPT_VALUE_EXTERNAL;
+    }
+    /* s may lie just above the top of the stack, it is copied before the push */
+    *(lept_value*)lept_context_push(c, sizeof(lept_value)) = v;
+    return 0;
+}
+
+static int lept_build_end_array(void* ctx, size_t size) {
+    lept_context* c = (lept_context*)ctx;
+    lept_value v;
+    lept_init(&v);
+    v.u.a.e = NULL;
+    v.u.a.size = size;
+    v.type = LEPT_ARRAY;
+    if (size) {
+        size_t bytes = size * sizeof(lept_value);
+        v.u.a.e = (lept_value*)lept_context_alloc(c, bytes);
+        memcpy(v.u.a.e, lept_context_pop(c, bytes), bytes);
+    }
+    if (c->arena)
+        v.flags |= LEPT_VALUE_EXTERNAL;
+    *(lept_value*)lept_context_push(c, sizeof(lept_value)) = v;
+    return 0;
+}
+
+static int lept_build_end_object(void* ctx, size_t size) {
+    lept_context* c = (lept_context*)ctx;
+    lept_value v;
+    size_t i;
+    lept_init(&v);
+    v.u.o.m = NULL;
+    v.u.o.size = size;
+    v.type = LEPT_OBJECT;
+    if (size) {
+        lept_value* e = (lept_value*)lept_context_pop(c, 2 * size * sizeof(lept_value));
+        size_t bytes = size * sizeof(lept_member), slots = 0;
+        char* k;
+        /* keys are copied behind the members and the index, one allocation holds them all */
+        if (c->index && size >= LEPT_OBJECT_INDEX_MIN && size <= LEPT_OBJECT_INDEX_MAX) {
+            slots = lept_index_slots(size);
+            bytes += slots * sizeof(uint32_t);
+            v.flags |= LEPT_VALUE_INDEXED;
+        }
+        if (!c->insitu)
+            for (i = 0; i < size; i++)
+                bytes += lept_get_string_length(&e[2 * i]) + 1;
+        v.u.o.m = (lept_member*)lept_context_alloc(c, bytes);
+        k = (char*)((uint32_t*)(v.u.o.m + size) + slots);
+        for (i = 0; i < size; i++, e += 2) {
+            lept_member* m = &v.u.o.m[i];
+            m->klen = lept_get_string_length(&e[0]);
+            if (c->insitu)
+                m->k = e[0].u.s.s;
+            else {
+                memcpy(m->k = k, lept_get_string(&e[0]), m->klen + 1);
+                k += m->klen + 1;
+                lept_free(&e[0]);
+            }
+            m->v = e[1];
+        }
+        if (slots)
+            lept_index_build(&v);
+    }
+    if (c->arena)
+        v.flags |= LEPT_VALUE_EXTERNAL;
+    *(lept_value*)lept_context_push(c, sizeof(lept_value)) = v;
+    return 0;
+}
+
+static const lept_handler lept_build_handler = {
+    lept_build_null,
+    lept_build_boolean,
+    lept_build_number,
+    lept_build_int64,
+    lept_build_string,
+    NULL,
+    lept_build_end_array,
+    NULL,
+    lept_build_string,
+    lept_build_end_object
+};
+
+/* frees whatever the builder left on the stack after an error */
+static void lept_build_unwind(lept_context* c) {
+    assert(c->top % sizeof(lept_value) == 0);
+    while (c->top)
+        lept_free((lept_value*)lept_context_pop(c, sizeof(lept_value)));
+}
+
+static int lept_parse_context(lept_context* c, lept_value* v, const char* json, size_t len) {
+    int ret;
+    assert(v != NULL);
+    c->handler = &lept_build_handler;
+    c->handler_ctx = c;
+    lept_init(v);
+    if ((ret = lept_parse_root(c, json, len)) == LEPT_PARSE_OK)
+        *v = *(lept_value*)lept_context_pop(c, sizeof(lept_value));
+    else
+        lept_build_unwind(c);
+    assert(c->top == 0);
+    return ret;
+}
+
+int lept_parse(lept_value* v, const char* json) {
+    assert(json != NULL);
+    return lept_parse_n(v, json, strlen(json));
+}
+
+int lept_parse_n(lept_value* v, const char* json, size_t len) {
+    return lept_parse_arena(v, json, len, NULL);
+}
+
+int lept_parse_arena(lept_value* v, const char* json, size_t len, lept_arena* a) {
+    lept_context c;
+    int ret;
+    lept_context_init(&c, a);
+    ret = lept_parse_context(&c, v, json, len);
+    LEPT_FREE(c.stack);
+    return ret;
+}
+
+int lept_parse_insitu(lept_value* v, char* json, size_t len) {
+    lept_context c;
+    int ret;
+    lept_context_init(&c, NULL);
+    c.insitu = 1;
+    ret = lept_parse_context(&c, v, json, len);
+    LEPT_FREE(c.stack);
+    return ret;
+}
+
+int lept_parse_lazy(lept_value* v, const char* json, size_t len) {
+    lept_context c;
+    int ret;
+    lept_context_init(&c, NULL);
+    c.lazy = 1;
+    ret = lept_parse_context(&c, v, json, len);
+    LEPT_FREE(c.stack);
+    return ret;
+}
+
+int lept_parse_sax(const char* json, size_t len, const lept_handler* h, void* ctx) {
+    lept_context c;
+    int ret;
+    assert(h != NULL);
+    lept_context_init(&c, NULL);
+    c.handler = h;
+    c.handler_ctx = ctx;
+    ret = lept_parse_root(&c, json, len);
+    LEPT_FREE(c.stack);
+    return ret;
+}
+
+/* stage two is the reference parser, skipping whitespace and clean strings by the index */
+static int lept_parse_tokens(lept_context* c, lept_tokens* t, lept_value* v, const char* json, size_t len) {
+    int ret;
+    c->tokens = lept_tokens_build(t, json, len) ? t : NULL;
+    ret = lept_parse_context(c, v, json, len);
+    c->tokens = NULL;
+    return ret;
+}
+
+int lept_parse_indexed(lept_value* v, const char* json, size_t len) {
+    lept_context c;
+    lept_tokens t;
+    int ret;
+    lept_context_init(&c, NULL);
+    t.pos = NULL;
+    t.capacity = 0;
+    ret = lept_parse_tokens(&c, &t, v, json, len);
+    LEPT_FREE(t.pos);
+    LEPT_FREE(c.stack);
+    return ret;
+}
+
+/*
+ * Maps a whole file read-only. *handle goes back to lept_unmap_file(). Where mapping is
+ * not available the file is read into memory instead. Empty files map to "".
+ */
+static const char* lept_map_file(const char* path, size_t* size, void** handle) {
+#if defined(LEPT_WIN32)
+    HANDLE file, mapping;
+    LARGE_INTEGER file_size;
+    const char* data = NULL;
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+    *handle = NULL;
+    if (GetFileSizeEx(file, &file_size) && (ULONGLONG)file_size.QuadPart <= (size_t)-1) {
+        if ((*size = (size_t)file_size.QuadPart) == 0)
+            data = "";
+        else if ((mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL)) != NULL) {
+            data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            *handle = (void*)data;
+            CloseHandle(mapping); /* the view keeps it */
+        }
+    }
+    CloseHandle(file);
+    return data;
+#elif defined(LEPT_POSIX)
+    struct stat st;
+    void* data;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size > (size_t)-1) {
+        close(fd);
+        return NULL;
+    }
+    *handle = NULL;
+    if ((*size = (size_t)st.st_size) == 0) {
+        close(fd);
+        return "";
+    }
+    data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    posix_madvise(data, *size, POSIX_MADV_SEQUENTIAL);
+    return (const char*)(*handle = data);
+#else
+    FILE* fp = fopen(path, "rb");
+    char* data = NULL;
+    size_t capacity = 0, n;
+    if (!fp)
+        return NULL;
+    for (*size = 0, n = 1; n != 0; *size += n) {
+        if (*size == capacity)
+            data = (char*)LEPT_REALLOC(data, capacity += capacity ? capacity >> 1 : LEPT_ARENA_BLOCK_SIZE);
+        n = fread(data + *size, 1, capacity - *size, fp);
+    }
+    if (ferror(fp)) {
+        LEPT_FREE(data);
+        data = NULL;
+    }
+    fclose(fp);
+    return *handle = data;
+#endif
+}
+
+static void lept_unmap_file(const char* data, size_t size, void* handle) {
+    if (!handle)
+        return;
+#if defined(LEPT_WIN32)
+    (void)size;
+    UnmapViewOfFile(data);
+#elif defined(LEPT_POSIX)
+    (void)data;
+    munmap(handle, size);
+#else
+    (void)data;
+    (void)size;
+    LEPT_FREE(handle);
+#endif
+}
+
+int lept_parse_file(lept_value* v, const char* path) {
+    const char* json;
+    size_t size;
+    void* handle;
+    int ret;
+    assert(v != NULL && path != NULL);
+    lept_init(v);
+    if ((json = lept_map_file(path, &size, &handle)) == NULL)
+        return LEPT_PARSE_FILE_ERROR;
+    ret = lept_parse_n(v, json, size);
+    lept_unmap_file(json, size, handle);
+    return ret;
+}
+
+typedef struct {
+    void (*func)(void* part);
+    void* part;
+}lept_task;
+
+#if defined(LEPT_WIN32)
+static DWORD WINAPI lept_task_thread(LPVOID task) {
+    ((lept_task*)task)->func(((lept_task*)task)->part);
+    return 0;
+}
+#elif defined(LEPT_POSIX)
+static void* lept_task_thread(void* task) {
+    ((lept_task*)task)->func(((lept_task*)task)->part);
+    return NULL;
+}
+#endif
+
+/*
+ * Calls func on each of the n parts of size bytes, each in a thread of its own but the first
+ * one, which is done here. Parts whose thread cannot be started are done here as well.
+ */
+static void lept_run_parts(void (*func)(void*), void* parts, size_t size, size_t n) {
+    lept_task* tasks = (lept_task*)LEPT_MALLOC(n * sizeof(lept_task));
+    size_t i;
+#if defined(LEPT_WIN32)
+    HANDLE* handles = (HANDLE*)LEPT_MALLOC(n * sizeof(HANDLE));
+#elif defined(LEPT_POSIX)
+    pthread_t* handles = (pthread_t*)LEPT_MALLOC(n * sizeof(pthread_t));
+    char* started = (char*)LEPT_MALLOC(n);
+#endif
+    for (i = 0; i < n; i++) {
+        tasks[i].func = func;
+        tasks[i].part = (char*)parts + i * size;
+    }
+#if defined(LEPT_WIN32)
+    for (i = 1; i < n; i++)
+        handles[i] = CreateThread(NULL, 0, lept_task_thread, &tasks[i], 0, NULL);
+    func(tasks[0].part);
+    for (i = 1; i < n; i++) {
+        if (handles[i]) {
+            WaitForSingleObject(handles[i], INFINITE);
+            CloseHandle(handles[i]);
+        }
+        else
+            func(tasks[i].part);
+    }
+    LEPT_FREE(handles);
+#elif defined(LEPT_POSIX)
+    for (i = 1; i < n; i++)
+        started[i] = pthread_create(&handles[i], NULL, lept_task_thread, &tasks[i]) == 0;
+    func(tasks[0].part);
+    for (i = 1; i < n; i++) {
+        if (started[i])
+            pthread_join(handles[i], NULL);
+        else
+            func(tasks[i].part);
+    }
+    LEPT_FREE(started);
+    LEPT_FREE(handles);
+#else
+    for (i = 0; i < n; i++)
+        func(tasks[i].part);
+#endif
+    LEPT_FREE(tasks);
+}
+
+/* a run of whole lines, parsed by one thread into values of its own */
+typedef struct {
+    const char* json;
+    const char* end;
+    lept_value* values;
+    size_t size, capacity;
+    size_t lines;   /* lines begun, the failing one included */
+    int ret;
+}lept_ndjson_part;
+
+static void lept_ndjson_parse_part(void* data) {
+    lept_ndjson_part* part = (lept_ndjson_part*)data;
+    lept_parser* p = lept_parser_create();
+    const char* line = part->json;
+    while (line != part->end) {
+        const char* eol = (const char*)memchr(line, '\n', part->end - line);
+        const char* q = line;
+        if (!eol)
+            eol = part->end;
+        part->lines++;
+        while (q != eol && ISWHITESPACE(*q))
+            q++;
+        if (q != eol) {
+            if (part->size == part->capacity) {
+                part->capacity += part->capacity ? part->capacity >> 1 : LEPT_TAPE_INIT_SIZE;
+                part->values = (lept_value*)LEPT_REALLOC(part->values, part->capacity * sizeof(lept_value));
+            }
+            if ((part->ret = lept_parser_parse(p, &part->values[part->size], q, eol - q)) != LEPT_PARSE_OK)
+                break;
+            part->size++;
+        }
+        line = eol != part->end ? eol + 1 : eol;
+    }
+    lept_parser_destroy(p);
+}
+
+
+/* splits the input into one run of lines per thread, values are moved into v in input order */
+int lept_parse_ndjson(lept_value* v, const char* json, size_t len, unsigned threads, size_t* line) {
+    lept_ndjson_part* parts;
+    size_t n, i, size = 0, lines = 0;
+    int ret = LEPT_PARSE_OK;
+    assert(v != NULL && (json != NULL || len == 0));
+    lept_init(v);
+    n = len / LEPT_THREAD_PART_SIZE + 1;
+    if (threads < n)
+        n = threads ? threads : 1;
+    parts = (lept_ndjson_part*)LEPT_MALLOC(n * sizeof(lept_ndjson_part));
+    for (i = 0; i < n; i++) {
+        const char* q = json;
+        if (i > 0) {
+            q += len / n * i;
+            if (q < parts[i - 1].json)
+                q = parts[i - 1].json;
+            while (q != json + len && *q++ != '\n')
+                ;
+            parts[i - 1].end = q;
+        }
+        parts[i].json = q;
+        parts[i].end = json + len;
+        parts[i].values = NULL;
+        parts[i].size = parts[i].capacity = parts[i].lines = 0;
+        parts[i].ret = LEPT_PARSE_OK;
+    }
+    lept_run_parts(lept_ndjson_parse_part, parts, sizeof(lept_ndjson_part), n);
+    for (i = 0; i < n; i++) {
+        if (parts[i].ret != LEPT_PARSE_OK) {
+            ret = parts[i].ret;
+            if (line)
+                *line = lines + parts[i].lines - 1;
+            break;
+        }
+        lines += parts[i].lines;
+        size += parts[i].size;
+    }
+    if (ret == LEPT_PARSE_OK) {
+        v->type = LEPT_ARRAY;
+        v->u.a.size = size;
+        v->u.a.e = size ? (lept_value*)LEPT_MALLOC(size * sizeof(lept_value)) : NULL;
+        for (i = 0, size = 0; i < n; size += parts[i++].size)
+            if (parts[i].size)
+                memcpy(v->u.a.e + size, parts[i].values, parts[i].size * sizeof(lept_value));
+    }
+    for (i = 0; i < n; i++) {
+        if (ret != LEPT_PARSE_OK) {
+            size_t j;
+            for (j = 0; j < parts[i].size; j++)
+                lept_free(&parts[i].values[j]);
+        }
+        LEPT_FREE(parts[i].values);
+    }
+    LEPT_FREE(parts);
+    return ret;
+}
+
+/*
+ * A share of the elements of a top-level array. Its input is first scanned for how it changes
+ * the depth, both as if it began outside a string and inside one, so that the state where it
+ * begins follows from the shares before it. Its elements then run from the first comma between
+ * elements in its share to the first one in the next share.
+ */
+typedef struct lept_array_part {
+    const char* first;  /* just after the opening bracket */
+    const char* json;
+    const char* end;
+    const char* close;  /* the closing bracket */
+    const struct lept_array_part* next;
+    long delta[2];      /* the change in depth from json to end, outside a string at json and inside */
+    long depth;
+    int escaped, parity, inside;
+    lept_value* values;
+    size_t size;
+    int ret;
+}lept_array_part;
+
+static void lept_array_scan_part(void* data) {
+    lept_array_part* part = (lept_array_part*)data;
+    lept_block_masks m;
+    uint64_t in = 0;
+    const char* p, *q;
+    char tail[64];
+    int carry;
+    for (q = part->json; q != part->first && q[-1] == '\\'; q--)
+        ;
+    carry = part->escaped = (int)((part->json - q) & 1);
+    part->delta[0] = part->delta[1] = 0;
+    for (p = part->json; p < part->end; p += 64) {
+        uint64_t escaped, inside, bits;
+        q = p;
+        if (part->end - p < 64) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, p, part->end - p);
+            q = tail;
+        }
+        lept_classify_block(q, &m);
+        escaped = lept_escaped_bits(m.backslash, &carry);
+        inside = lept_prefix_xor(m.quote & ~escaped) ^ in;
+        in = (uint64_t)0 - (inside >> 63);
+        /* set bits of inside are outside a string when the share begins inside one */
+        for (bits = m.op; bits; bits &= bits - 1) {
+            unsigned i = LEPT_CTZ64(bits);
+            if ((q[i] | 0x20) == '{')
+                part->delta[inside >> i & 1]++;
+            else if ((q[i] | 0x20) == '}')
+                part->delta[inside >> i & 1]--;
+        }
+    }
+    part->parity = (int)(in & 1);
+}
+
+/* the first comma between elements from p on, or the closing bracket */
+static const char* lept_array_split(const char* p, const char* close, int inside, long depth, int escaped) {
+    for (; p != close; p++) {
+        if (escaped)
+            escaped = 0;
+        else if (*p == '\\')
+            escaped = 1;
+        else if (*p == '\"')
+            inside = !inside;
+        else if (!inside) {
+            if (*p == ',' && depth == 1)
+                return p;
+            if (*p == '[' || *p == '{')
+                depth++;
+            else if (*p == ']' || *p == '}')
+                depth--;
+        }
+    }
+    return close;
+}
+
+/* the elements are left on the part's own stack, which becomes its values */
+static void lept_array_parse_part(void* data) {
+    lept_array_part* part = (lept_array_part*)data;
+    const lept_array_part* next = part->next;
+    const char* from = part->json, *to = part->close;
+    lept_context c;
+    if (part->json != part->first)
+        from = lept_array_split(part->json, part->close, part->inside, part->depth, part->escaped) + 1;
+    if (next)
+        to = lept_array_split(next->json, next->close, next->inside, next->depth, next->escaped);
+    if (from > to)
+        return;     /* no comma in the share */
+    lept_context_init(&c, NULL);
+    c.json = from;
+    c.end = to;
+    c.max_depth = LEPT_PARSE_MAX_DEPTH - 1;  /* the array is one */
+    c.handler = &lept_build_handler;
+    c.handler_ctx = &c;
+    lept_parse_whitespace(&c);
+    while ((part->ret = lept_parse_value(&c)) == LEPT_PARSE_OK) {
+        lept_parse_whitespace(&c);
+        if (c.json == c.end)
+            break;
+        if (*c.json != ',') {
+            part->ret = LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            break;
+        }
+        c.json++;
+        lept_parse_whitespace(&c);
+    }
+    if (part->ret != LEPT_PARSE_OK) {
+        lept_build_unwind(&c);
+        LEPT_FREE(c.stack);
+        return;
+    }
+    part->values = (lept_value*)c.stack;
+    part->size = c.top / sizeof(lept_value);
+}
+
+/*
+ * Only a top-level array is split. Any other document, or one that fails in a part, is parsed
+ * again by lept_parse_n(), so the result and the error are the same as its.
+ */
+int lept_parse_parallel(lept_value* v, const char* json, size_t len, unsigned threads) {
+    const char* open = json, *close = json + len;
+    lept_array_part* parts;
+    size_t n, i, size = 0;
+    long depth = 1;
+    int inside = 0, ret = LEPT_PARSE_OK;
+    assert(v != NULL && (json != NULL || len == 0));
+    lept_init(v);
+    n = len / LEPT_THREAD_PART_SIZE + 1;
+    if (threads < n)
+        n = threads ? threads : 1;
+    while (open != close && ISWHITESPACE(*open))
+        open++;
+    while (close != open && ISWHITESPACE(close[-1]))
+        close--;
+    if (n < 2 || close - open < 2 || *open != '[' || *--close != ']')
+        return lept_parse_n(v, json, len);
+    parts = (lept_array_part*)LEPT_MALLOC(n * sizeof(lept_array_part));
+    for (i = 0; i < n; i++) {
+        parts[i].first = open + 1;
+        parts[i].json = open + 1 + (size_t)(close - open - 1) / n * i;
+        parts[i].close = close;
+        parts[i].next = i + 1 < n ? &parts[i + 1] : NULL;
+        parts[i].values = NULL;
+        parts[i].size = 0;
+        parts[i].ret = LEPT_PARSE_OK;
+        if (i > 0)
+            parts[i - 1].end = parts[i].json;
+    }
+    parts[n - 1].end = close;
+    lept_run_parts(lept_array_scan_part, parts, sizeof(lept_array_part), n);
+    for (i = 0; i < n; i++) {
+        parts[i].inside = inside;
+        parts[i].depth = depth;
+        depth += parts[i].delta[inside];
+        inside ^= parts[i].parity;
+    }
+    lept_run_parts(lept_array_parse_part, parts, sizeof(lept_array_part), n);
+    for (i = 0; i < n; i++) {
+        if (parts[i].ret != LEPT_PARSE_OK)
+            ret = parts[i].ret;
+        size += parts[i].size;
+    }
+    if (ret == LEPT_PARSE_OK) {
+        v->type = LEPT_ARRAY;
+        v->u.a.size = size;
+        v->u.a.e = size ? (lept_value*)LEPT_MALLOC(size * sizeof(lept_value)) : NULL;
+        for (i = 0, size = 0; i < n; size += parts[i++].size)
+            if (parts[i].size)
+                memcpy(v->u.a.e + size, parts[i].values, parts[i].size * sizeof(lept_value));
+    }
+    for (i = 0; i < n; i++) {
+        if (ret != LEPT_PARSE_OK) {
+            size_t j;
+            for (j = 0; j < parts[i].size; j++)
+                lept_free(&parts[i].values[j]);
+        }
+        LEPT_FREE(parts[i].values);
+    }
+    LEPT_FREE(parts);
+    return ret == LEPT_PARSE_OK ? ret : lept_parse_n(v, json, len);
+}
+
+static void lept_stream_reset(lept_parser* p) {
+    lept_stream* s = &p->s;
+    switch (s->state) {
+        case LEPT_STREAM_NUMBER:
+        case LEPT_STREAM_STRING:
+        case LEPT_STREAM_ESCAPE:
+        case LEPT_STREAM_HEX:
+        case LEPT_STREAM_SURROGATE:
+            p->c.top = s->head;  /* drop the unfinished token */
+            break;
+    }
+    lept_build_unwind(&p->c);
+    s->state = LEPT_STREAM_VALUE;
+    s->error = LEPT_PARSE_OK;
+    s->depth = 0;
+}
+
+/* a value is complete, count it in its container */
+static void lept_stream_done(lept_stream* s) {
+    if (s->depth)
+        s->frames[s->depth - 1].size++;
+    s->state = LEPT_STREAM_AFTER;
+}
+
+/* what lept_parse() reports for an unexpected character after a value */
+static int lept_stream_after_error(const lept_stream* s) {
+    if (!s->depth)
+        return LEPT_PARSE_ROOT_NOT_SINGULAR;
+    return s->frames[s->depth - 1].object ?
+        LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+}
+
+static int lept_stream_open(lept_parser* p, int object) {
+    lept_stream* s = &p->s;
+    lept_context* c = &p->c;
+    if (s->depth == c->max_depth)
+        return LEPT_PARSE_TOO_DEEP;
+    if (s->depth == s->capacity) {
+        s->capacity = s->capacity ? s->capacity + (s->capacity >> 1) : LEPT_STREAM_DEPTH_INIT_SIZE;
+        s->frames = (lept_stream_frame*)LEPT_REALLOC(s->frames, s->capacity * sizeof(lept_stream_frame));
+    }
+    s->frames[s->depth].size = 0;
+    s->frames[s->depth++].object = object;
+    s->state = object ? LEPT_STREAM_OBJECT : LEPT_STREAM_ARRAY;
+    if (object)
+        return LEPT_EMIT(c, on_start_object, (c->handler_ctx));
+    return LEPT_EMIT(c, on_start_array, (c->handler_ctx));
+}
+
+static int lept_stream_close(lept_parser* p) {
+    lept_stream* s = &p->s;
+    lept_context* c = &p->c;
+    const lept_stream_frame* f = &s->frames[--s->depth];
+    int ret = f->object ?
+        LEPT_EMIT(c, on_end_object, (c->handler_ctx, f->size)) :
+        LEPT_EMIT(c, on_end_array, (c->handler_ctx, f->size));
+    lept_stream_done(s);
+    return ret;
+}
+
+#define ISNUMBERCHAR(ch)    (ISDIGIT(ch) || (ch) == '-' || (ch) == '+' || (ch) == '.' || (ch) == 'e' || (ch) == 'E')
+
+/* the number text sits on the stack, parse it as a bounded input of its own */
+static int lept_stream_number(lept_parser* p) {
+    lept_context t;
+    lept_value n;
+    int ret, rest;
+    lept_context_init(&t, NULL);
+    t.json = p->c.stack + p->s.head;
+    t.end = p->c.stack + p->c.top;
+    lept_init(&n);
+    ret = lept_parse_number(&t, &n);
+    rest = t.json != t.end;
+    p->c.top = p->s.head;
+    if (ret != LEPT_PARSE_OK)
+        return ret;
+    if (rest)
+        return lept_stream_after_error(&p->s);
+    ret = lept_emit_number(&p->c, &n);
+    lept_stream_done(&p->s);
+    return ret;
+}
+
+/* consumes as much of c->json as the current state allows */
+static int lept_stream_step(lept_parser* p) {
+    lept_context* c = &p->c;
+    lept_stream* s = &p->s;
+    const char* q;
+    size_t len;
+    unsigned u;
+    int ret;
+    char ch;
+    switch (s->state) {
+        case LEPT_STREAM_VALUE:
+            lept_parse_whitespace(c);
+            if (c->json == c->end)
+                return LEPT_PARSE_OK;
+            switch (*c->json) {
+                case 't': s->literal = "true";  s->literal_type = LEPT_TRUE;  break;
+                case 'f': s->literal = "false"; s->literal_type = LEPT_FALSE; break;
+                case 'n': s->literal = "null";  s->literal_type = LEPT_NULL;  break;
+                case '[': c->json++; return lept_stream_open(p, 0);
+                case '{': c->json++; return lept_stream_open(p, 1);
+                case '"':
+                    c->json++;
+                    s->key = 0;
+                    s->head = c->top;
+                    s->state = LEPT_STREAM_STRING;
+                    return LEPT_PARSE_OK;
+                default:
+                    if (*c->json != '-' && !ISDIGIT(*c->json))
+                        return LEPT_PARSE_INVALID_VALUE;
+                    s->head = c->top;
+                    s->state = LEPT_STREAM_NUMBER;
+                    return LEPT_PARSE_OK;
+            }
+            s->state = LEPT_STREAM_LITERAL;
+            s->matched = 0;
+            return LEPT_PARSE_OK;
+        case LEPT_STREAM_LITERAL:
+            for (; c->json != c->end && s->literal[s->matched]; c->json++, s->matched++)
+                if (*c->json != s->literal[s->matched])
+                    return LEPT_PARSE_INVALID_VALUE;
+            if (s->literal[s->matched])
+                return LEPT_PARSE_OK;
+            ret = lept_emit_literal(c, s->literal_type);
+            lept_stream_done(s);
+            return ret;
+        case LEPT_STREAM_NUMBER:
+            for (q = c->json; q != c->end && ISNUMBERCHAR(*q); q++);
+            if (q != c->json)
+                memcpy(lept_context_push(c, q - c->json), c->json, q - c->json);
+            c->json = q;
+            return q != c->end ? lept_stream_number(p) : LEPT_PARSE_OK;
+        case LEPT_STREAM_STRING:
+            q = lept_scan_string(c->json, c->end);
+            if (q != c->json)
+                memcpy(lept_context_push(c, q - c->json), c->json, q - c->json);
+            if ((c->json = q) == c->end)
+                return LEPT_PARSE_OK;
+            switch (ch = *c->json++) {
+                case '\"':
+                    len = c->top - s->head;
+                    q = len ? (const char*)lept_context_pop(c, len) : "";
+                    if (c->utf8 && !lept_validate_utf8(q, q + len))
+                        return LEPT_PARSE_INVALID_UTF8;
+                    if (s->key) {
+                        s->state = LEPT_STREAM_COLON;
+                        return LEPT_EMIT(c, on_key, (c->handler_ctx, q, len));
+                    }
+                    ret = LEPT_EMIT(c, on_string, (c->handler_ctx, q, len));
+                    lept_stream_done(s);
+                    return ret;
+                case '\\':
+                    s->state = LEPT_STREAM_ESCAPE;
+                    return LEPT_PARSE_OK;
+                default:
+                    assert((unsigned char)ch < 0x20);
+                    return LEPT_PARSE_INVALID_STRING_CHAR;
+            }
+        case LEPT_STREAM_ESCAPE:
+            s->state = LEPT_STREAM_STRING;
+            switch (*c->json++) {
+                case '\"': PUTC(c, '\"'); break;
+                case '\\': PUTC(c, '\\'); break;
+                case '/':  PUTC(c, '/' ); break;
+                case 'b':  PUTC(c, '\b'); break;
+                case 'f':  PUTC(c, '\f'); break;
+                case 'n':  PUTC(c, '\n'); break;
+                case 'r':  PUTC(c, '\r'); break;
+                case 't':  PUTC(c, '\t'); break;
+                case 'u':
+                    s->state = LEPT_STREAM_HEX;
+                    s->matched = 0;
+                    s->high = 0;
+                    break;
+                default:
+                    return LEPT_PARSE_INVALID_STRING_ESCAPE;
+            }
+            return LEPT_PARSE_OK;
+        case LEPT_STREAM_HEX:
+            /* a hex quad may straddle chunks, collect it first */
+            for (; c->json != c->end && s->matched < 4; c->json++)
+                s->hex[s->matched++] = *c->json;
+            if (s->matched < 4)
+                return LEPT_PARSE_OK;
+            if (!lept_parse_hex4(s->hex, &u))
+                return LEPT_PARSE_INVALID_UNICODE_HEX;
+            if (s->high) {
+                if (!LEPT_IS_LOW_SURROGATE(u))
+                    return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+                u = LEPT_SURROGATE_PAIR(s->high, u);
+            }
+            else if (LEPT_IS_SURROGATE(u)) {
+                if (LEPT_IS_LOW_SURROGATE(u))
+                    return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+                s->high = u;
+                s->state = LEPT_STREAM_SURROGATE;
+                s->matched = 0;
+                return LEPT_PARSE_OK;
+            }
+            c->top = lept_encode_utf8((char*)lept_context_push(c, 4), u) - c->stack;
+            s->state = LEPT_STREAM_STRING;
+            return LEPT_PARSE_OK;
+        case LEPT_STREAM_SURROGATE:
+            if (*c->json++ != "\\u"[s->matched++])
+                return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+            if (s->matched == 2) {
+                s->state = LEPT_STREAM_HEX;
+                s->matched = 0;
+            }
+            return LEPT_PARSE_OK;
+        case LEPT_STREAM_ARRAY:
+            lept_parse_whitespace(c);
+            if (c->json == c->end)
+                return LEPT_PARSE_OK;
+            if (*c->json == ']') {
+                c->json++;
+                return lept_stream_close(p);
+            }
+            s->state = LEPT_STREAM_VALUE;
+            return LEPT_PARSE_OK;
+        case LEPT_STREAM_OBJECT:
+        case LEPT_STREAM_KEY:
+            lept_parse_whitespace(c);
+            if (c->json == c->end)
+                return LEPT_PARSE_OK;
+            if (*c->json == '}' && s->state == LEPT_STREAM_OBJECT) {
+                c->json++;
+                return lept_stream_close(p);
+            }
+            if (*c->json != '"')
+                return LEPT_PARSE_MISS_KEY;
+            c->json++;
+            s->key = 1;
+            s->head = c->top;
+            s->state = LEPT_STREAM_STRING;
+            return LEPT_PARSE_OK;
+        case LEPT_STREAM_COLON:
+            lept_parse_whitespace(c);
+            if (c->json == c->end)
+                return LEPT_PARSE_OK;
+            if (*c->json != ':')
+                return LEPT_PARSE_MISS_COLON;
+            c->json++;
+            s->state = LEPT_STREAM_VALUE;
+            return LEPT_PARSE_OK;
+        default:
+            assert(s->state == LEPT_STREAM_AFTER);
+            lept_parse_whitespace(c);
+            if (c->json == c->end)
+                return LEPT_PARSE_OK;
+            if (s->depth) {
+                const lept_stream_frame* f = &s->frames[s->depth - 1];
+                if (*c->json == ',') {
+                    c->json++;
+                    s->state = f->object ? LEPT_STREAM_KEY : LEPT_STREAM_VALUE;
+                    return LEPT_PARSE_OK;
+                }
+                if (*c->json == (f->object ? '}' : ']')) {
+                    c->json++;
+                    return lept_stream_close(p);
+                }
+            }
+            return lept_stream_after_error(s);
+    }
+}
+
+lept_parser* lept_parser_create(void) {
+    lept_parser* p = (lept_parser*)LEPT_MALLOC(sizeof(lept_parser));
+    lept_context_init(&p->c, NULL);
+    p->s.frames = NULL;
+    p->s.capacity = 0;
+    p->s.state = LEPT_STREAM_VALUE;
+    p->t.pos = NULL;
+    p->t.capacity = 0;
+    lept_stream_reset(p);
+    return p;
+}
+
+void lept_parser_destroy(lept_parser* p) {
+    if (p) {
+        lept_stream_reset(p);
+        LEPT_FREE(p->s.frames);
+        LEPT_FREE(p->t.pos);
+        LEPT_FREE(p->c.stack);
+        LEPT_FREE(p);
+    }
+}
+
+void lept_parser_set_arena(lept_parser* p, lept_arena* a) {
+    assert(p != NULL);
+    p->c.arena = a;
+}
+
+void lept_parser_set_strict_utf8(lept_parser* p, int strict) {
+    assert(p != NULL);
+    p->c.utf8 = strict;
+}
+
+void lept_parser_set_object_index(lept_parser* p, int index) {
+    assert(p != NULL);
+    p->c.index = index;
+}
+
+void lept_parser_set_max_depth(lept_parser* p, size_t depth) {
+    assert(p != NULL);
+    p->c.max_depth = depth ? depth : (size_t)-1;
+}
+
+int lept_parser_parse(lept_parser* p, lept_value* v, const char* json, size_t len) {
+    assert(p != NULL);
+    lept_stream_reset(p);
+    p->c.insitu = 0;
+    p->c.lazy = 0;
+    return lept_parse_context(&p->c, v, json, len);
+}
+
+int lept_parser_parse_insitu(lept_parser* p, lept_value* v, char* json, size_t len) {
+    assert(p != NULL);
+    lept_stream_reset(p);
+    p->c.insitu = 1;
+    p->c.lazy = 0;
+    return lept_parse_context(&p->c, v, json, len);
+}
+
+int lept_parser_parse_lazy(lept_parser* p, lept_value* v, const char* json, size_t len) {
+    assert(p != NULL && p->c.arena == NULL);
+    lept_stream_reset(p);
+    p->c.insitu = 0;
+    p->c.lazy = 1;
+    return lept_parse_context(&p->c, v, json, len);
+}
+
+int lept_parser_parse_indexed(lept_parser* p, lept_value* v, const char* json, size_t len) {
+    assert(p != NULL);
+    lept_stream_reset(p);
+    p->c.insitu = 0;
+    p->c.lazy = 0;
+    return lept_parse_tokens(&p->c, &p->t, v, json, len);
+}
+
+int lept_parser_parse_sax(lept_parser* p, const char* json, size_t len, const lept_handler* h, void* ctx) {
+    assert(p != NULL && h != NULL);
+    lept_stream_reset(p);
+    p->c.insitu = 0;
+    p->c.lazy = 0;
+    p->c.handler = h;
+    p->c.handler_ctx = ctx;
+    return lept_parse_root(&p->c, json, len);
+}
+
+int lept_parser_feed(lept_parser* p, const char* chunk, size_t len) {
+    lept_stream* s;
+    assert(p != NULL && (chunk != NULL || len == 0));
+    s = &p->s;
+    p->c.json = chunk;
+    p->c.end = chunk + len;
+    p->c.insitu = 0;
+    p->c.lazy = 0;
+    p->c.handler = &lept_build_handler;
+    p->c.handler_ctx = &p->c;
+    while (s->error == LEPT_PARSE_OK && p->c.json != p->c.end)
+        s->error = lept_stream_step(p);
+    return s->error;
+}
+
+int lept_parser_finish(lept_parser* p, lept_value* v) {
+    lept_stream* s;
+    int ret;
+    assert(p != NULL && v != NULL);
+    s = &p->s;
+    if ((ret = s->error) == LEPT_PARSE_OK && s->state == LEPT_STREAM_NUMBER) {
+        p->c.handler = &lept_build_handler;
+        p->c.handler_ctx = &p->c;
+        ret = lept_stream_number(p);
+    }
+    if (ret == LEPT_PARSE_OK) {
+        /* the end of input means what it does to lept_parse() */
+        switch (s->state) {
+            case LEPT_STREAM_VALUE:
+            case LEPT_STREAM_ARRAY:   ret = LEPT_PARSE_EXPECT_VALUE; break;
+            case LEPT_STREAM_LITERAL: ret = LEPT_PARSE_INVALID_VALUE; break;
+            case LEPT_STREAM_STRING:  ret = LEPT_PARSE_MISS_QUOTATION_MARK; break;
+            case LEPT_STREAM_ESCAPE:  ret = LEPT_PARSE_INVALID_STRING_ESCAPE; break;
+            case LEPT_STREAM_HEX:     ret = LEPT_PARSE_INVALID_UNICODE_HEX; break;
+            case LEPT_STREAM_SURROGATE: ret = LEPT_PARSE_INVALID_UNICODE_SURROGATE; break;
+            case LEPT_STREAM_OBJECT:
+            case LEPT_STREAM_KEY:     ret = LEPT_PARSE_MISS_KEY; break;
+            case LEPT_STREAM_COLON:   ret = LEPT_PARSE_MISS_COLON; break;
+            default:
+                if (s->depth)
+                    ret = lept_stream_after_error(s);
+        }
+    }
+    lept_init(v);
+    if (ret == LEPT_PARSE_OK)
+        *v = *(lept_value*)lept_context_pop(&p->c, sizeof(lept_value));
+    lept_stream_reset(p);
+    return ret;
+}
+
+/*
+ * JSON Pointer queries: the paths form a trie walked along with the input. Members and
+ * elements off every path are stepped over, counting brackets instead of parsing, and
+ * only the values at the ends of the paths are built.
+ */
+#define LEPT_QUERY_INIT_SIZE 8
+
+/* returns the first '\"' or bracket in [p, end), or end */
+static const char* lept_scan_bracket(const char* p, const char* end) {
+#if defined(LEPT_SIMD_AVX2)
+    const __m256i quote32 = _mm256_set1_epi8('\"'), case32 = _mm256_set1_epi8(0x20);
+    const __m256i open32 = _mm256_set1_epi8('{'), close32 = _mm256_set1_epi8('}');
+#endif
+#if defined(LEPT_SIMD_SSE2)
+    const __m128i quote = _mm_set1_epi8('\"'), lower = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{'), close = _mm_set1_epi8('}');
+#elif defined(LEPT_SIMD_NEON)
+    const uint8x16_t quote = vdupq_n_u8('\"'), lower = vdupq_n_u8(0x20);
+    const uint8x16_t open = vdupq_n_u8('{'), close = vdupq_n_u8('}');
+#endif
+    /* '[' and ']' are '{' and '}' without 0x20, nothing else is */
+#if defined(LEPT_SIMD_AVX2)
+    for (; end - p >= 32; p += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)p);
+        __m256i b = _mm256_or_si256(s, case32);
+        __m256i t = _mm256_or_si256(_mm256_cmpeq_epi8(s, quote32),
+            _mm256_or_si256(_mm256_cmpeq_epi8(b, open32), _mm256_cmpeq_epi8(b, close32)));
+        unsigned mask;
+        if ((mask = (unsigned)_mm256_movemask_epi8(t)) != 0)
+            return p + LEPT_CTZ(mask);
+    }
+#endif
+#if defined(LEPT_SIMD_SSE2)
+    for (; end - p >= 16; p += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)p);
+        __m128i b = _mm_or_si128(s, lower);
+        __m128i t = _mm_or_si128(_mm_cmpeq_epi8(s, quote),
+            _mm_or_si128(_mm_cmpeq_epi8(b, open), _mm_cmpeq_epi8(b, close)));
+        unsigned mask;
+        if ((mask = (unsigned)_mm_movemask_epi8(t)) != 0)
+            return p + LEPT_CTZ(mask);
+    }
+#elif defined(LEPT_SIMD_NEON)
+    for (; end - p >= 16; p += 16) {
+        uint8x16_t s = vld1q_u8((const uint8_t*)p);
+        uint8x16_t b = vorrq_u8(s, lower);
+        uint8x16_t t = vorrq_u8(vceqq_u8(s, quote), vorrq_u8(vceqq_u8(b, open), vceqq_u8(b, close)));
+        if (vmaxvq_u8(t)) {
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(t), 4)), 0);
+            unsigned lo = (unsigned)mask;
+            return p + (lo ? LEPT_CTZ(lo) : 32 + LEPT_CTZ((unsigned)(mask >> 32))) / 4;
+        }
+    }
+#endif
+    for (; p != end; p++)
+        if (*p == '\"' || (*p | 0x20) == '{' || (*p | 0x20) == '}')
+            break;
+    return p;
+}
+
+/* steps over a string, escapes are not decoded nor checked */
+static int lept_skip_string(lept_context* c) {
+    const char* p = c->json + 1;
+    for (;;) {
+        p = lept_scan_string(p, c->end);
+        if (p == c->end)
+            return LEPT_PARSE_MISS_QUOTATION_MARK;
+        if (*p == '\"') {
+            c->json = p + 1;
+            return LEPT_PARSE_OK;
+        }
+        if (*p != '\\')
+            return LEPT_PARSE_INVALID_STRING_CHAR;
+        if (c->end - p < 2)
+            return LEPT_PARSE_INVALID_STRING_ESCAPE;
+        p += 2;
+    }
+}
+
+static int lept_skip_literal(lept_context* c, const char* literal) {
+    size_t n = strlen(literal);
+    if ((size_t)(c->end - c->json) < n || memcmp(c->json, literal, n) != 0)
+        return LEPT_PARSE_INVALID_VALUE;
+    c->json += n;
+    return LEPT_PARSE_OK;
+}
+
+/* steps over a value, the brackets of a container are counted and not matched */
+static int lept_skip_value(lept_context* c) {
+    const char *begin = c->json, *p;
+    size_t depth = 0;
+    int ret;
+    if (c->json == c->end)
+        return LEPT_PARSE_EXPECT_VALUE;
+    switch (*c->json) {
+        case 't':  return lept_skip_literal(c, "true");
+        case 'f':  return lept_skip_literal(c, "false");
+        case 'n':  return lept_skip_literal(c, "null");
+        case '"':  return lept_skip_string(c);
+        case '[':
+        case '{':  break;
+        default:   return lept_skip_number(c);
+    }
+    for (p = begin;; p++) {
+        if ((p = lept_scan_bracket(p, c->end)) == c->end)
+            return *begin == '[' ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        if (*p == '\"') {
+            c->json = p;
+            if ((ret = lept_skip_string(c)) != LEPT_PARSE_OK)
+                return ret;
+            p = c->json - 1;
+        }
+        else if (*p == '[' || *p == '{')
+            depth++;
+        else if (--depth == 0) {
+            c->json = p + 1;
+            return LEPT_PARSE_OK;
+        }
+    }
+}
+
+static size_t lept_query_child(lept_query* q, size_t parent, const char* token, size_t len) {
+    lept_query_node* n;
+    size_t i;
+    for (i = q->nodes[parent].child; i; i = q->nodes[i].sibling)
+        if (q->nodes[i].len == len && memcmp(q->nodes[i].token, token, len) == 0)
+            return i;
+    if (q->size == q->capacity) {
+        q->capacity += q->capacity >> 1;
+        q->nodes = (lept_query_node*)LEPT_REALLOC(q->nodes, q->capacity * sizeof(lept_query_node));
+    }
+    n = &q->nodes[i = q->size++];
+    n->token = token;
+    n->len = len;
+    /* digits without a leading zero, "-" is past the end of every array */
+    n->index = LEPT_KEY_NOT_EXIST;
+    if (len > 0 && len < 19 && (len == 1 || *token != '0')) {
+        size_t j;
+        for (j = 0; j < len && ISDIGIT(token[j]); j++)
+            ;
+        if (j == len)
+            for (n->index = j = 0; j < len; j++)
+                n->index = n->index * 10 + (token[j] - '0');
+    }
+    n->child = 0;
+    n->sibling = q->nodes[parent].child;
+    n->path = 0;
+    q->nodes[parent].child = i;
+    return i;
+}
+
+lept_query* lept_query_create(const char* const* paths, size_t count) {
+    lept_query* q = (lept_query*)LEPT_MALLOC(sizeof(lept_query));
+    size_t i, total = 1;
+    char* t;
+    assert(paths != NULL || count == 0);
+    for (i = 0; i < count; i++)
+        total += strlen(paths[i]);
+    q->tokens = t = (char*)LEPT_MALLOC(total);
+    q->next = count ? (size_t*)LEPT_MALLOC(count * sizeof(size_t)) : NULL;
+    q->paths = count;
+    q->nodes = (lept_query_node*)LEPT_MALLOC(LEPT_QUERY_INIT_SIZE * sizeof(lept_query_node));
+    q->size = 1;
+    q->capacity = LEPT_QUERY_INIT_SIZE;
+    q->nodes[0].token = t;  /* the root, "" */
+    q->nodes[0].len = 0;
+    q->nodes[0].index = LEPT_KEY_NOT_EXIST;
+    q->nodes[0].child = q->nodes[0].sibling = q->nodes[0].path = 0;
+    for (i = 0; i < count; i++) {
+        const char* p = paths[i];
+        size_t node = 0;
+        while (*p) {
+            const char* token = t;
+            if (*p++ != '/') {
+                lept_query_destroy(q);
+                return NULL;
+            }
+            for (; *p && *p != '/'; p++) {
+                if (*p != '~')
+                    *t++ = *p;
+                else if (p[1] == '0' || p[1] == '1')
+                    *t++ = *++p == '0' ? '~' : '/';
+                else {
+                    lept_query_destroy(q);
+                    return NULL;
+                }
+            }
+            node = lept_query_child(q, node, token, t - token);
+        }
+        q->next[i] = q->nodes[node].path;
+        q->nodes[node].path = i + 1;
+    }
+    return q;
+}
+
+void lept_query_destroy(lept_query* q) {
+    if (q) {
+        LEPT_FREE(q->nodes);
+        LEPT_FREE(q->next);
+        LEPT_FREE(q->tokens);
+        LEPT_FREE(q);
+    }
+}
+
+size_t lept_query_get_size(const lept_query* q) {
+    assert(q != NULL);
+    return q->paths;
+}
+
+typedef struct {
+    lept_context* c;
+    const lept_query* q;
+    lept_value* values;
+    int* found;
+    size_t left;            /* paths not found yet, the walk stops at 0 */
+}lept_query_state;
+
+static int lept_query_value(lept_query_state* s, size_t node);
+
+static int lept_query_array(lept_query_state* s, size_t node) {
+    lept_context* c = s->c;
+    size_t index = 0, i;
+    int ret;
+    c->json++;
+    lept_parse_whitespace(c);
+    if (PEEK(c, c->json) == ']') {
+        c->json++;
+        return LEPT_PARSE_OK;
+    }
+    for (;; index++) {
+        for (i = s->q->nodes[node].child; i && s->q->nodes[i].index != index; i = s->q->nodes[i].sibling)
+            ;
+        if ((ret = i ? lept_query_value(s, i) : lept_skip_value(c)) != LEPT_PARSE_OK || !s->left)
+            return ret;
+        lept_parse_whitespace(c);
+        if (PEEK(c, c->json) == ',') {
+            c->json++;
+            lept_parse_whitespace(c);
+        }
+        else if (PEEK(c, c->json) == ']') {
+            c->json++;
+            return LEPT_PARSE_OK;
+        }
+        else
+            return LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+    }
+}
+
+static int lept_query_object(lept_query_state* s, size_t node) {
+    lept_context* c = s->c;
+    const lept_query_node* nodes = s->q->nodes;
+    const char* k;
+    size_t klen, i;
+    int ret;
+    c->json++;
+    lept_parse_whitespace(c);
+    if (PEEK(c, c->json) == '}') {
+        c->json++;
+        return LEPT_PARSE_OK;
+    }
+    for (;;) {
+        if (PEEK(c, c->json) != '"')
+            return LEPT_PARSE_MISS_KEY;
+        if ((ret = lept_parse_string_raw(c, &k, &klen)) != LEPT_PARSE_OK)
+            return ret;
+        for (i = nodes[node].child; i; i = nodes[i].sibling)
+            if (nodes[i].len == klen && memcmp(nodes[i].token, k, klen) == 0)
+                break;
+        lept_parse_whitespace(c);
+        if (PEEK(c, c->json) != ':')
+            return LEPT_PARSE_MISS_COLON;
+        c->json++;
+        lept_parse_whitespace(c);
+        if ((ret = i ? lept_query_value(s, i) : lept_skip_value(c)) != LEPT_PARSE_OK || !s->left)
+            return ret;
+        lept_parse_whitespace(c);
+        if (PEEK(c, c->json) == ',') {
+            c->json++;
+            lept_parse_whitespace(c);
+        }
+        else if (PEEK(c, c->json) == '}') {
+            c->json++;
+            return LEPT_PARSE_OK;
+        }
+        else
+            return LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+    }
+}
+
+/* the first occurrence of a path wins, later duplicate keys are passed over */
+static int lept_query_value(lept_query_state* s, size_t node) {
+    lept_context* c = s->c;
+    const lept_query_node* n = &s->q->nodes[node];
+    const char *begin = c->json, *end = NULL;
+    size_t i;
+    int ret;
+    for (i = n->path; i; i = s->q->next[i - 1])
+        if (!s->found[i - 1]) {
+            c->json = begin;
+            if ((ret = lept_parse_value(c)) != LEPT_PARSE_OK)
+                return ret;
+            s->values[i - 1] = *(lept_value*)lept_context_pop(c, sizeof(lept_value));
+            s->found[i - 1] = 1;
+            s->left--;
+            end = c->json;
+        }
+    /* a path through a value found itself walks the value again */
+    if (s->left && n->child && (PEEK(c, begin) == '{' || PEEK(c, begin) == '[')) {
+        c->json = begin;
+        return *begin == '{' ? lept_query_object(s, node) : lept_query_array(s, node);
+    }
+    if (end)
+        return LEPT_PARSE_OK;
+    return lept_skip_value(c);
+}
+
+static int lept_query_context(lept_context* c, const lept_query* q, const char* json, size_t len, lept_value* values, int* found) {
+    lept_query_state s;
+    size_t i;
+    int ret = LEPT_PARSE_OK;
+    assert(q != NULL && (json != NULL || len == 0));
+    assert((values != NULL && found != NULL) || q->paths == 0);
+    c->handler = &lept_build_handler;
+    c->handler_ctx = c;
+    c->json = json;
+    c->end = json + len;
+    c->top = 0;
+    for (i = 0; i < q->paths; i++) {
+        lept_init(&values[i]);
+        found[i] = 0;
+    }
+    s.c = c;
+    s.q = q;
+    s.values = values;
+    s.found = found;
+    s.left = q->paths;
+    if (s.left) {
+        LEPT_STATS_BEGIN(c);
+        lept_parse_whitespace(c);
+        if ((ret = lept_query_value(&s, 0)) == LEPT_PARSE_OK && s.left) {
+            lept_parse_whitespace(c);
+            if (c->json != c->end)
+                ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+        }
+        LEPT_STATS_END(c, json, ret);
+    }
+    if (ret != LEPT_PARSE_OK) {
+        lept_build_unwind(c);
+        for (i = 0; i < q->paths; i++)
+            if (found[i]) {
+                lept_free(&values[i]);
+                found[i] = 0;
+            }
+    }
+    assert(c->top == 0);
+    return ret;
+}
+
+int lept_query_run(const lept_query* q, const char* json, size_t len, lept_value* values, int* found) {
+    lept_context c;
+    int ret;
+    lept_context_init(&c, NULL);
+    ret = lept_query_context(&c, q, json, len, values, found);
+    LEPT_FREE(c.stack);
+    return ret;
+}
+
+int lept_parser_query(lept_parser* p, const lept_query* q, const char* json, size_t len, lept_value* values, int* found) {
+    assert(p != NULL);
+    lept_stream_reset(p);
+    p->c.insitu = 0;
+    p->c.lazy = 0;
+    return lept_query_context(&p->c, q, json, len, values, found);
+}
+
+/*
+ * Schema parsing: the field tables are compiled into one array of tables, each with an open
+ * addressing index of its names, and members are decoded straight into the caller's struct.
+ */
+static void lept_schema_count(const lept_field* f, size_t* tables, size_t* entries, size_t* slots) {
+    size_t n;
+    for (n = 0; f[n].name; n++)
+        if (f[n].type == LEPT_OBJECT && f[n].fields)
+            lept_schema_count(f[n].fields, tables, entries, slots);
+    (*tables)++;
+    *entries += n;
+    *slots += lept_index_slots(n);
+}
+
+static size_t lept_schema_fill(lept_schema* s, const lept_field* f) {
+    size_t t = s->tables_size++, n, i, j;
+    lept_schema_table* table = &s->tables[t];
+    for (n = 0; f[n].name; n++)
+        ;
+    table->entry = s->entries_size;
+    table->count = n;
+    table->slot = s->slots_size;
+    table->mask = lept_index_slots(n) - 1;
+    s->entries_size += n;
+    s->slots_size += table->mask + 1;
+    memset(s->slots + table->slot, 0, (table->mask + 1) * sizeof(uint32_t));
+    for (i = 0; i < n; i++) {
+        lept_schema_entry* e = &s->entries[table->entry + i];
+        e->field = &f[i];
+        e->len = strlen(f[i].name);
+        e->hash = lept_hash_key(f[i].name, e->len);
+        e->table = 0;
+        for (j = e->hash & table->mask; s->slots[table->slot + j]; j = (j + 1) & table->mask)
+            ;
+        s->slots[table->slot + j] = (uint32_t)(i + 1);
+    }
+    /* nested tables come after this one, the arrays are allocated once and do not move */
+    for (i = 0; i < n; i++)
+        if (f[i].type == LEPT_OBJECT && f[i].fields)
+            s->entries[table->entry + i].table = lept_schema_fill(s, f[i].fields);
+    return t;
+}
+
+lept_schema* lept_schema_create(const lept_field* fields) {
+    lept_schema* s = (lept_schema*)LEPT_MALLOC(sizeof(lept_schema));
+    size_t tables = 0, entries = 0, slots = 0;
+    assert(fields != NULL);
+    lept_schema_count(fields, &tables, &entries, &slots);
+    s->tables = (lept_schema_table*)LEPT_MALLOC(tables * sizeof(lept_schema_table));
+    s->entries = (lept_schema_entry*)LEPT_MALLOC(entries ? entries * sizeof(lept_schema_entry) : 1);
+    s->slots = (uint32_t*)LEPT_MALLOC(slots * sizeof(uint32_t));
+    s->tables_size = s->entries_size = s->slots_size = 0;
+    lept_schema_fill(s, fields);
+    return s;
+}
+
+void lept_schema_destroy(lept_schema* s) {
+    if (s) {
+        LEPT_FREE(s->tables);
+        LEPT_FREE(s->entries);
+        LEPT_FREE(s->slots);
+        LEPT_FREE(s);
+    }
+}
+
+static void lept_schema_free_table(const lept_schema* s, size_t t, char* out) {
+    const lept_schema_table* table = &s->tables[t];
+    size_t i;
+    for (i = 0; i < table->count; i++) {
+        const lept_schema_entry* e = &s->entries[table->entry + i];
+        char* p = out + e->field->offset;
+        switch (e->field->type) {
+            case LEPT_FALSE:
+            case LEPT_TRUE:
+            case LEPT_NUMBER:
+                break;
+            case LEPT_STRING:
+                LEPT_FREE(*(char**)p);
+                *(char**)p = NULL;
+                break;
+            case LEPT_OBJECT:
+                if (e->field->fields) {
+                    lept_schema_free_table(s, e->table, p);
+                    break;
+                }
+                /* fall through */
+            default:
+                lept_free((lept_value*)p);
+        }
+    }
+}
+
+/* out must not have been filled through an arena, its strings were not malloc()ed */
+void lept_schema_free(const lept_schema* s, void* out) {
+    assert(s != NULL && out != NULL);
+    lept_schema_free_table(s, 0, (char*)out);
+}
+
+/* the entry of key among those of table t, LEPT_KEY_NOT_EXIST if none */
+static size_t lept_schema_find(const lept_schema* s, size_t t, const char* key, size_t klen) {
+    const lept_schema_table* table = &s->tables[t];
+    const uint32_t* slots = s->slots + table->slot;
+    size_t i;
+    uint32_t hash = lept_hash_key(key, klen);
+    for (i = hash & table->mask; slots[i]; i = (i + 1) & table->mask) {
+        const lept_schema_entry* e = &s->entries[table->entry + slots[i] - 1];
+        if (e->hash == hash && e->len == klen && memcmp(e->field->name, key, klen) == 0)
+            return slots[i] - 1;
+    }
+    return LEPT_KEY_NOT_EXIST;
+}
+
+#define LEPT_IS_BOOLEAN(type) ((type) == LEPT_FALSE || (type) == LEPT_TRUE)
+
+static int lept_schema_object(lept_context* c, const lept_schema* s, size_t t, char* out, const lept_field** field);
+
+static int lept_schema_value(lept_context* c, const lept_schema* s, const lept_schema_entry* e, char* out, const lept_field** field) {
+    const lept_field* f = e->field;
+    char* p = out + f->offset;
+    lept_type type = lept_peek_type(PEEK(c, c->json));
+    const char* str;
+    size_t len, top;
+    lept_value v;
+    int ret;
+    /* anything may go into a lept_value, the others take one type */
+    if (f->type != LEPT_NULL && type != f->type && !(LEPT_IS_BOOLEAN(f->type) && LEPT_IS_BOOLEAN(type))) {
+        if (type == LEPT_NULL && (ret = lept_skip_value(c)) != LEPT_PARSE_OK)
+            return ret;  /* garbage rather than null */
+        *field = f;
+        return LEPT_PARSE_TYPE_MISMATCH;
+    }
+    switch (f->type) {
+        case LEPT_FALSE:
+        case LEPT_TRUE:
+            if ((ret = lept_skip_literal(c, type == LEPT_TRUE ? "true" : "false")) == LEPT_PARSE_OK)
+                *(int*)p = type == LEPT_TRUE;
+            return ret;
+        case LEPT_NUMBER:
+            lept_init(&v);
+            if ((ret = lept_parse_number(c, &v)) == LEPT_PARSE_OK)
+                *(double*)p = v.flags & LEPT_VALUE_INT64 ? (double)v.u.i : v.u.n;
+            return ret;
+        case LEPT_STRING:
+            if ((ret = lept_parse_string_raw(c, &str, &len)) == LEPT_PARSE_OK) {
+                char* copy = (char*)lept_context_alloc(c, len + 1);
+                memcpy(copy, str, len);
+                copy[len] = '\0';
+                *(char**)p = copy;
+            }
+            return ret;
+        case LEPT_OBJECT:
+            if (f->fields)
+                return lept_schema_object(c, s, e->table, p, field);
+            /* fall through */
+        default:
+            top = c->top;
+            if ((ret = lept_parse_value(c)) == LEPT_PARSE_OK)
+                *(lept_value*)p = *(lept_value*)lept_context_pop(c, sizeof(lept_value));
+            else {
+                /* what was built of it, the caller's reset of top would drop it */
+                while (c->top > top)
+                    lept_free((lept_value*)lept_context_pop(c, sizeof(lept_value)));
+            }
+            return ret;
+    }
+}
+
+/* members of table t go to out, the first of duplicate keys wins and unknown keys are skipped */
+static int lept_schema_object(lept_context* c, const lept_schema* s, size_t t, char* out, const lept_field** field) {
+    size_t seen = c->top, bytes, klen, i;
+    const char* k;
+    int ret;
+    if (PEEK(c, c->json) != '{') {
+        if (lept_peek_type(PEEK(c, c->json)) == LEPT_NULL && (ret = lept_skip_value(c)) != LEPT_PARSE_OK)
+            return ret;
+        return LEPT_PARSE_TYPE_MISMATCH;
+    }
+    c->json++;
+    lept_parse_whitespace(c);
+    if (PEEK(c, c->json) == '}') {
+        c->json++;
+        return LEPT_PARSE_OK;
+    }
+    /* a bit per field on the stack, in whole values to keep the values above it aligned */
+    bytes = (s->tables[t].count + 8 * sizeof(lept_value) - 1) / (8 * sizeof(lept_value)) * sizeof(lept_value);
+    if (bytes)
+        memset(lept_context_push(c, bytes), 0, bytes);
+    for (;;) {
+        if (PEEK(c, c->json) != '"') {
+            ret = LEPT_PARSE_MISS_KEY;
+            break;
+        }
+        if ((ret = lept_parse_string_raw(c, &k, &klen)) != LEPT_PARSE_OK)
+            break;
+        i = lept_schema_find(s, t, k, klen);
+        lept_parse_whitespace(c);
+        if (PEEK(c, c->json) != ':') {
+            ret = LEPT_PARSE_MISS_COLON;
+            break;
+        }
+        c->json++;
+        lept_parse_whitespace(c);
+        if (i == LEPT_KEY_NOT_EXIST || (c->stack[seen + i / 8] & (1 << i % 8)))
+            ret = lept_skip_value(c);
+        else {
+            c->stack[seen + i / 8] |= (char)(1 << i % 8);
+            ret = lept_schema_value(c, s, &s->entries[s->tables[t].entry + i], out, field);
+        }
+        if (ret != LEPT_PARSE_OK)
+            break;
+        lept_parse_whitespace(c);
+        if (PEEK(c, c->json) == ',') {
+            c->json++;
+            lept_parse_whitespace(c);
+        }
+        else if (PEEK(c, c->json) == '}') {
+            c->json++;
+            break;
+        }
+        else {
+            ret = LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+            break;
+        }
+    }
+    c->top = seen;
+    return ret;
+}
+
+static int lept_schema_context(lept_context* c, const lept_schema* s, void* out, const char* json, size_t len, const lept_field** field) {
+    const lept_field* f = NULL;
+    int ret;
+    assert(s != NULL && out != NULL && (json != NULL || len == 0));
+    c->handler = &lept_build_handler;
+    c->handler_ctx = c;
+    c->json = json;
+    c->end = json + len;
+    c->top = 0;
+    LEPT_STATS_BEGIN(c);
+    lept_parse_whitespace(c);
+    if (c->json == c->end)
+        ret = LEPT_PARSE_EXPECT_VALUE;
+    else if ((ret = lept_schema_object(c, s, 0, (char*)out, &f)) == LEPT_PARSE_OK) {
+        lept_parse_whitespace(c);
+        if (c->json != c->end)
+            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+    }
+    LEPT_STATS_END(c, json, ret);
+    if (ret != LEPT_PARSE_OK) {
+        lept_build_unwind(c);
+        if (!c->arena)
+            lept_schema_free(s, out);
+    }
+    if (field)
+        *field = ret == LEPT_PARSE_TYPE_MISMATCH ? f : NULL;
+    assert(c->top == 0);
+    return ret;
+}
+
+int lept_schema_parse(const lept_schema* s, void* out, const char* json, size_t len, const lept_field** field) {
+    lept_context c;
+    int ret;
+    lept_context_init(&c, NULL);
+    ret = lept_schema_context(&c, s, out, json, len, field);
+    LEPT_FREE(c.stack);
+    return ret;
+}
+
+int lept_parser_parse_schema(lept_parser* p, const lept_schema* s, void* out, const char* json, size_t len, const lept_field** field) {
+    assert(p != NULL);
+    lept_stream_reset(p);
+    p->c.insitu = 0;
+    p->c.lazy = 0;
+    return lept_schema_context(&p->c, s, out, json, len, field);
+}
+
+/*
+ * Double to shortest decimal with Grisu2: the boundaries of the double are scaled by a
+ * cached power of ten into a 64-bit window, then as few digits as the window allows are
+ * generated. The result always reads back as the same double.
+ */
+typedef struct {
+    uint64_t f;
+    int e;
+}lept_diyfp;
+
+/* normalized 10^k for k = -348, -340, ..., 340, rounded */
+static const uint32_t lept_cached_powers[][2] = {
+    { 0xfa8fd5a0, 0x081c0288 }, { 0xbaaee17f, 0xa23ebf76 }, { 0x8b16fb20, 0x3055ac76 }, { 0xcf42894a, 0x5dce35ea },
+    { 0x9a6bb0aa, 0x55653b2d }, { 0xe61acf03, 0x3d1a45df }, { 0xab70fe17, 0xc79ac6ca }, { 0xff77b1fc, 0xbebcdc4f },
+    { 0xbe5691ef, 0x416bd60c }, { 0x8dd01fad, 0x907ffc3c }, { 0xd3515c28, 0x31559a83 }, { 0x9d71ac8f, 0xada6c9b5 },
+    { 0xea9c2277, 0x23ee8bcb }, { 0xaecc4991, 0x4078536d }, { 0x823c1279, 0x5db6ce57 }, { 0xc2109436, 0x4dfb5637 },
+    { 0x9096ea6f, 0x3848984f }, { 0xd77485cb, 0x25823ac7 }, { 0xa086cfcd, 0x97bf97f4 }, { 0xef340a98, 0x172aace5 },
+    { 0xb23867fb, 0x2a35b28e }, { 0x84c8d4df, 0xd2c63f3b }, { 0xc5dd4427, 0x1ad3cdba }, { 0x936b9fce, 0xbb25c996 },
+    { 0xdbac6c24, 0x7d62a584 }, { 0xa3ab6658, 0x0d5fdaf6 }, { 0xf3e2f893, 0xdec3f126 }, { 0xb5b5ada8, 0xaaff80b8 },
+    { 0x87625f05, 0x6c7c4a8b }, { 0xc9bcff60, 0x34c13053 }, { 0x964e858c, 0x91ba2655 }, { 0xdff97724, 0x70297ebd },
+    { 0xa6dfbd9f, 0xb8e5b88f }, { 0xf8a95fcf, 0x88747d94 }, { 0xb9447093, 0x8fa89bcf }, { 0x8a08f0f8, 0xbf0f156b },
+    { 0xcdb02555, 0x653131b6 }, { 0x993fe2c6, 0xd07b7fac }, { 0xe45c10c4, 0x2a2b3b06 }, { 0xaa242499, 0x697392d3 },
+    { 0xfd87b5f2, 0x8300ca0e }, { 0xbce50864, 0x92111aeb }, { 0x8cbccc09, 0x6f5088cc }, { 0xd1b71758, 0xe219652c },
+    { 0x9c400000, 0x00000000 }, { 0xe8d4a510, 0x00000000 }, { 0xad78ebc5, 0xac620000 }, { 0x813f3978, 0xf8940984 },
+    { 0xc097ce7b, 0xc90715b3 }, { 0x8f7e32ce, 0x7bea5c70 }, { 0xd5d238a4, 0xabe98068 }, { 0x9f4f2726, 0x179a2245 },
+    { 0xed63a231, 0xd4c4fb27 }, { 0xb0de6538, 0x8cc8ada8 }, { 0x83c7088e, 0x1aab65db }, { 0xc45d1df9, 0x42711d9a },
+    { 0x924d692c, 0xa61be758 }, { 0xda01ee64, 0x1a708dea }, { 0xa26da399, 0x9aef774a }, { 0xf209787b, 0xb47d6b85 },
+    { 0xb454e4a1, 0x79dd1877 }, { 0x865b8692, 0x5b9bc5c2 }, { 0xc83553c5, 0xc8965d3d }, { 0x952ab45c, 0xfa97a0b3 },
+    { 0xde469fbd, 0x99a05fe3 }, { 0xa59bc234, 0xdb398c25 }, { 0xf6c69a72, 0xa3989f5c }, { 0xb7dcbf53, 0x54e9bece },
+    { 0x88fcf317, 0xf22241e2 }, { 0xcc20ce9b, 0xd35c78a5 }, { 0x98165af3, 0x7b2153df }, { 0xe2a0b5dc, 0x971f303a },
+    { 0xa8d9d153, 0x5ce3b396 }, { 0xfb9b7cd9, 0xa4a7443c }, { 0xbb764c4c, 0xa7a44410 }, { 0x8bab8eef, 0xb6409c1a },
+    { 0xd01fef10, 0xa657842c }, { 0x9b10a4e5, 0xe9913129 }, { 0xe7109bfb, 0xa19c0c9d }, { 0xac2820d9, 0x623bf429 },
+    { 0x80444b5e, 0x7aa7cf85 }, { 0xbf21e440, 0x03acdd2d }, { 0x8e679c2f, 0x5e44ff8f }, { 0xd433179d, 0x9c8cb841 },
+    { 0x9e19db92, 0xb4e31ba9 }, { 0xeb96bf6e, 0xbadf77d9 }, { 0xaf87023b, 0x9bf0ee6b }
+};
+
+static const short lept_cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static const uint32_t lept_pow10_u32[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static lept_diyfp lept_diyfp_mul(lept_diyfp a, lept_diyfp b) {
+    lept_diyfp r;
+    uint64_t lo;
+    r.f = lept_mul64(a.f, b.f, &lo) + (lo >> 63);  /* rounded */
+    r.e = a.e + b.e + 64;
+    return r;
+}
+
+static lept_diyfp lept_diyfp_normalize(lept_diyfp x) {
+    int s = lept_clz64(x.f);
+    x.f <<= s;
+    x.e -= s;
+    return x;
+}
+
+/* a power of ten that brings binary exponent e into [-60, -32], *k is its decimal exponent */
+static lept_diyfp lept_cached_power(int e, int* k) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347;  /* positive, so the cast truncates up to the ceiling below */
+    int ik = (int)dk;
+    unsigned index;
+    lept_diyfp c;
+    if (dk - ik > 0.0)
+        ik++;
+    index = (unsigned)((ik >> 3) + 1);
+    *k = -(-348 + (int)(index << 3));
+    c.f = (uint64_t)lept_cached_powers[index][0] << 32 | lept_cached_powers[index][1];
+    c.e = lept_cached_powers_e[index];
+    return c;
+}
+
+/* moves the last digit towards w while it stays inside the window */
+static void lept_grisu_round(char* buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+        (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static void lept_digit_gen(lept_diyfp w, lept_diyfp mp, uint64_t delta, char* buffer, int* len, int* k) {
+    int shift = -mp.e, kappa;
+    uint64_t one = (uint64_t)1 << shift, wp_w = mp.f - w.f, p2 = mp.f & (one - 1), scale = 1;
+    uint32_t p1 = (uint32_t)(mp.f >> shift);
+    for (kappa = 1; kappa < 10 && p1 >= lept_pow10_u32[kappa]; kappa++);
+    *len = 0;
+    /* integral part */
+    while (kappa > 0) {
+        uint32_t d = p1 / lept_pow10_u32[kappa - 1];
+        uint64_t rest;
+        p1 %= lept_pow10_u32[kappa - 1];
+        if (d || *len)
+            buffer[(*len)++] = (char)('0' + d);
+        kappa--;
+        if ((rest = ((uint64_t)p1 << shift) + p2) <= delta) {
+            *k += kappa;
+            lept_grisu_round(buffer, *len, delta, rest, (uint64_t)lept_pow10_u32[kappa] << shift, wp_w);
+            return;
+        }
+    }
+    /* fractional part */
+    for (;;) {
+        char d;
+        p2 *= 10;
+        delta *= 10;
+        scale = kappa > -19 ? scale * 10 : 0;   /* wp_w is meaningless once 10^-kappa overflows */
+        d = (char)(p2 >> shift);
+        if (d || *len)
+            buffer[(*len)++] = (char)('0' + d);
+        p2 &= one - 1;
+        kappa--;
+        if (p2 < delta) {
+            *k += kappa;
+            lept_grisu_round(buffer, *len, delta, p2, one, wp_w * scale);
+            return;
+        }
+    }
+}
+
+/* digits of a positive finite double into buffer, the value is buffer * 10^k */
+static void lept_grisu2(uint64_t bits, char* buffer, int* len, int* k) {
+    lept_diyfp v, w, wp, wm, c;
+    int biased_e = (int)(bits >> 52) & 0x7FF;
+    v.f = bits & (LEPT_DOUBLE_HIDDEN_BIT - 1);
+    if (biased_e) {
+        v.f += LEPT_DOUBLE_HIDDEN_BIT;
+        v.e = biased_e - 1075;
+    }
+    else
+        v.e = -1074;
+    /* the halfway points to the neighbours are the ends of the window */
+    wp.f = (v.f << 1) + 1;
+    wp.e = v.e - 1;
+    wp = lept_diyfp_normalize(wp);
+    if (v.f == LEPT_DOUBLE_HIDDEN_BIT) {
+        wm.f = (v.f << 2) - 1;    /* the gap below a power of two is half as wide */
+        wm.e = v.e - 2;
+    }
+    else {
+        wm.f = (v.f << 1) - 1;
+        wm.e = v.e - 1;
+    }
+    wm.f <<= wm.e - wp.e;
+    wm.e = wp.e;
+    c = lept_cached_power(wp.e, k);
+    w = lept_diyfp_mul(lept_diyfp_normalize(v), c);
+    wp = lept_diyfp_mul(wp, c);
+    wm = lept_diyfp_mul(wm, c);
+    wm.f++;
+    wp.f--;
+    lept_digit_gen(w, wp, wp.f - wm.f, buffer, len, k);
+}
+
+static char* lept_write_exponent(int k, char* p) {
+    *p++ = k < 0 ? '-' : '+';
+    if (k < 0)
+        k = -k;
+    if (k >= 100) {
+        *p++ = (char)('0' + k / 100);
+        k %= 100;
+        *p++ = (char)('0' + k / 10);
+    }
+    else if (k >= 10)
+        *p++ = (char)('0' + k / 10);
+    *p++ = (char)('0' + k % 10);
+    return p;
+}
+
+/* lays out buffer * 10^k the way ECMAScript prints numbers */
+static char* lept_prettify(char* buffer, int len, int k) {
+    int kk = len + k, i;  /* 10^(kk-1) <= v < 10^kk */
+    if (k >= 0 && kk <= 21) {
+        /* 1234e7 -> 12340000000 */
+        for (i = len; i < kk; i++)
+            buffer[i] = '0';
+        return buffer + kk;
+    }
+    if (kk > 0 && kk <= 21) {
+        /* 1234e-2 -> 12.34 */
+        memmove(buffer + kk + 1, buffer + kk, len - kk);
+        buffer[kk] = '.';
+        return buffer + len + 1;
+    }
+    if (kk > -6 && kk <= 0) {
+        /* 1234e-6 -> 0.001234 */
+        int offset = 2 - kk;
+        memmove(buffer + offset, buffer, len);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        for (i = 2; i < offset; i++)
+            buffer[i] = '0';
+        return buffer + len + offset;
+    }
+    if (len == 1) {
+        /* 1e30 -> 1e+30 */
+        buffer[1] = 'e';
+        return lept_write_exponent(kk - 1, buffer + 2);
+    }
+    /* 1234e30 -> 1.234e+33 */
+    memmove(buffer + 2, buffer + 1, len - 1);
+    buffer[1] = '.';
+    buffer[len + 1] = 'e';
+    return lept_write_exponent(kk - 1, buffer + len + 2);
+}
+
+#define LEPT_DTOA_SIZE 32   /* "-0.00000" and 17 digits, or "-1." 16 digits "e-308" */
+
+/* the shortest text that reads back as n, "null" for what JSON cannot represent */
+static char* lept_dtoa(double n, char* p) {
+    uint64_t bits;
+    int len, k;
+    memcpy(&bits, &n, sizeof(double));
+    if ((bits & LEPT_DOUBLE_INF_BITS) == LEPT_DOUBLE_INF_BITS) {
+        memcpy(p, "null", 4);
+        return p + 4;
+    }
+    if (bits >> 63) {
+        *p++ = '-';
+        bits &= ~((uint64_t)1 << 63);
+    }
+    if (bits == 0) {
+        *p++ = '0';
+        return p;
+    }
+    lept_grisu2(bits, p, &len, &k);
+    return lept_prettify(p, len, k);
+}
+
+static char* lept_write_int64(int64_t i, char* p) {
+    char buf[20], *q = buf + sizeof(buf);
+    uint64_t u = (uint64_t)i;
+    if (i < 0) {
+        *p++ = '-';
+        u = 0 - u;
+    }
+    do {
+        *--q = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    memcpy(p, q, buf + sizeof(buf) - q);
+    return p + (buf + sizeof(buf) - q);
+}
+
+static void lept_stringify_chars(lept_context* c, const char* s, size_t len) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+    const char *p = s, *end = s + len;
+    for (;;) {
+        /* runs that need no escaping are copied as they are */
+        const char* q = lept_scan_string(p, end);
+        unsigned char ch;
+        if (q != p)
+            PUTS(c, p, q - p);
+        if (q == end)
+            break;
+        switch (ch = (unsigned char)*q) {
+            case '\"': PUTS(c, "\\\"", 2); break;
+            case '\\': PUTS(c, "\\\\", 2); break;
+            case '\b': PUTS(c, "\\b", 2); break;
+            case '\f': PUTS(c, "\\f", 2); break;
+            case '\n': PUTS(c, "\\n", 2); break;
+            case '\r': PUTS(c, "\\r", 2); break;
+            case '\t': PUTS(c, "\\t", 2); break;
+            default: {
+                char* u = (char*)lept_context_push(c, 6);
+                memcpy(u, "\\u00", 4);
+                u[4] = hex_digits[ch >> 4];
+                u[5] = hex_digits[ch & 15];
+            }
+        }
+        p = q + 1;
+    }
+}
+
+static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
+    PUTC(c, '"');
+    lept_stringify_chars(c, s, len);
+    PUTC(c, '"');
+}
+
+static void lept_stringify_number(lept_context* c, const lept_value* v) {
+    char* p = (char*)lept_context_push(c, LEPT_DTOA_SIZE);
+    LEPT_MATERIALIZE(v);
+    p = v->flags & LEPT_VALUE_INT64 ? lept_write_int64(v->u.i, p) : lept_dtoa(v->u.n, p);
+    c->top = p - c->stack;
+}
+
+static void lept_stringify_value(lept_context* c, const lept_value* v) {
+    size_t i;
+    switch (v->type) {
+        case LEPT_NULL:   PUTS(c, "null",  4); break;
+        case LEPT_FALSE:  PUTS(c, "false", 5); break;
+        case LEPT_TRUE:   PUTS(c, "true",  4); break;
+        case LEPT_NUMBER: lept_stringify_number(c, v); break;
+        case LEPT_STRING: lept_stringify_string(c, lept_get_string(v), lept_get_string_length(v)); break;
+        case LEPT_ARRAY:
+            PUTC(c, '[');
+            for (i = 0; i < v->u.a.size; i++) {
+                if (i > 0)
+                    PUTC(c, ',');
+                lept_stringify_value(c, &v->u.a.e[i]);
+            }
+            PUTC(c, ']');
+            break;
+        case LEPT_OBJECT:
+            PUTC(c, '{');
+            for (i = 0; i < v->u.o.size; i++) {
+                if (i > 0)
+                    PUTC(c, ',');
+                lept_stringify_string(c, v->u.o.m[i].k, v->u.o.m[i].klen);
+                PUTC(c, ':');
+                lept_stringify_value(c, &v->u.o.m[i].v);
+            }
+            PUTC(c, '}');
+            break;
+        default: assert(0 && "invalid type");
+    }
+}
+
+int lept_stringify(const lept_value* v, char** json, size_t* length) {
+    lept_context c;
+    assert(v != NULL);
+    assert(json != NULL);
+    lept_context_init(&c, NULL);
+    c.stack = (char*)LEPT_MALLOC(c.size = LEPT_PARSE_STRINGIFY_INIT_SIZE);
+    lept_stringify_value(&c, v);
+    if (length)
+        *length = c.top;
+    PUTC(&c, '\0');
+    *json = c.stack;
+    return LEPT_STRINGIFY_OK;
+}
+
+/*
+ * The binary encoding: a tag byte, then little-endian payloads and LEB128 sizes. Strings and
+ * keys keep a terminating '\0' behind their bytes so that a view can point right into them.
+ */
+enum {
+    LEPT_BINARY_NULL,
+    LEPT_BINARY_FALSE,
+    LEPT_BINARY_TRUE,
+    LEPT_BINARY_DOUBLE,     /* 8 bytes IEEE 754 */
+    LEPT_BINARY_INT64,      /* 8 bytes two's complement */
+    LEPT_BINARY_STRING,     /* size, bytes, '\0' */
+    LEPT_BINARY_ARRAY,      /* size, elements */
+    LEPT_BINARY_OBJECT,     /* size, then a string without tag and a value per member */
+    LEPT_BINARY_SMALL = 0x80 /* integers 0 to 127 in the tag itself */
+};
+
+#define LEPT_BINARY_SIZE_MAX ((sizeof(size_t) * 8 + 6) / 7)
+
+static void lept_encode_size(lept_context* c, size_t n) {
+    unsigned char* p = (unsigned char*)lept_context_push(c, LEPT_BINARY_SIZE_MAX);
+    for (; n > 0x7F; n >>= 7)
+        *p++ = (unsigned char)(n | 0x80);
+    *p++ = (unsigned char)n;
+    c->top = (char*)p - c->stack;
+}
+
+static void lept_encode_u64(lept_context* c, int tag, uint64_t u) {
+    unsigned char* p = (unsigned char*)lept_context_push(c, 9);
+    int i;
+    *p++ = (unsigned char)tag;
+    for (i = 0; i < 8; i++, u >>= 8)
+        p[i] = (unsigned char)u;
+}
+
+static void lept_encode_string(lept_context* c, const char* s, size_t len) {
+    lept_encode_size(c, len);
+    memcpy(lept_context_push(c, len + 1), s, len);
+    c->stack[c->top - 1] = '\0';
+}
+
+static void lept_encode_value(lept_context* c, const lept_value* v) {
+    uint64_t u;
+    size_t i;
+    switch (v->type) {
+        case LEPT_NULL:   PUTC(c, LEPT_BINARY_NULL); break;
+        case LEPT_FALSE:  PUTC(c, LEPT_BINARY_FALSE); break;
+        case LEPT_TRUE:   PUTC(c, LEPT_BINARY_TRUE); break;
+        case LEPT_NUMBER:
+            LEPT_MATERIALIZE(v);
+            if (!(v->flags & LEPT_VALUE_INT64)) {
+                memcpy(&u, &v->u.n, sizeof(u));
+                lept_encode_u64(c, LEPT_BINARY_DOUBLE, u);
+            }
+            else if (v->u.i >= 0 && v->u.i < 0x80)
+                PUTC(c, (char)(LEPT_BINARY_SMALL | (int)v->u.i));
+            else
+                lept_encode_u64(c, LEPT_BINARY_INT64, (uint64_t)v->u.i);
+            break;
+        case LEPT_STRING:
+            PUTC(c, LEPT_BINARY_STRING);
+            lept_encode_string(c, lept_get_string(v), lept_get_string_length(v));
+            break;
+        case LEPT_ARRAY:
+            PUTC(c, LEPT_BINARY_ARRAY);
+            lept_encode_size(c, v->u.a.size);
+            for (i = 0; i < v->u.a.size; i++)
+                lept_encode_value(c, &v->u.a.e[i]);
+            break;
+        case LEPT_OBJECT:
+            PUTC(c, LEPT_BINARY_OBJECT);
+            lept_encode_size(c, v->u.o.size);
+            for (i = 0; i < v->u.o.size; i++) {
+                lept_encode_string(c, v->u.o.m[i].k, v->u.o.m[i].klen);
+                lept_encode_value(c, &v->u.o.m[i].v);
+            }
+            break;
+        default: assert(0 && "invalid type");
+    }
+}
+
+int lept_encode(const lept_value* v, char** data, size_t* length) {
+    lept_context c;
+    assert(v != NULL);
+    assert(data != NULL && length != NULL);
+    lept_context_init(&c, NULL);
+    c.stack = (char*)LEPT_MALLOC(c.size = LEPT_PARSE_STRINGIFY_INIT_SIZE);
+    lept_encode_value(&c, v);
+    *length = c.top;
+    *data = c.stack;
+    return LEPT_STRINGIFY_OK;
+}
+
+static int lept_decode_size(lept_context* c, size_t* n) {
+    const unsigned char* p = (const unsigned char*)c->json;
+    unsigned shift = 0;
+    *n = 0;
+    do {
+        if (p == (const unsigned char*)c->end || shift >= sizeof(size_t) * 8)
+            return LEPT_PARSE_INVALID_BINARY;
+        *n |= (size_t)(*p & 0x7F) << shift;
+        shift += 7;
+    } while (*p++ & 0x80);
+    c->json = (const char*)p;
+    return LEPT_PARSE_OK;
+}
+
+/* strings are not copied here, the handler gets them where they lie */
+static int lept_decode_string(lept_context* c, const char** s, size_t* len) {
+    int ret;
+    if ((ret = lept_decode_size(c, len)) != LEPT_PARSE_OK)
+        return ret;
+    if (*len >= (size_t)(c->end - c->json) || c->json[*len] != '\0')
+        return LEPT_PARSE_INVALID_BINARY;
+    *s = c->json;
+    c->json += *len + 1;
+    return LEPT_PARSE_OK;
+}
+
+/* depth counts the arrays and objects open around the value */
+static int lept_decode_value(lept_context* c, size_t depth) {
+    const unsigned char* p;
+    const char* s;
+    size_t n, i, klen;
+    lept_value u;
+    int ret, tag;
+    if (c->json == c->end)
+        return LEPT_PARSE_INVALID_BINARY;
+    tag = *(const unsigned char*)c->json++;
+    lept_init(&u);
+    if (tag >= LEPT_BINARY_SMALL) {
+        lept_set_int64(&u, tag & 0x7F);
+        return lept_emit_number(c, &u);
+    }
+    switch (tag) {
+        case LEPT_BINARY_NULL:  return LEPT_EMIT(c, on_null, (c->handler_ctx));
+        case LEPT_BINARY_FALSE: return LEPT_EMIT(c, on_boolean, (c->handler_ctx, 0));
+        case LEPT_BINARY_TRUE:  return LEPT_EMIT(c, on_boolean, (c->handler_ctx, 1));
+        case LEPT_BINARY_DOUBLE:
+        case LEPT_BINARY_INT64: {
+            uint64_t w = 0;
+            if (c->end - c->json < 8)
+                return LEPT_PARSE_INVALID_BINARY;
+            p = (const unsigned char*)c->json;
+            for (i = 8; i-- > 0; )
+                w = w << 8 | p[i];
+            c->json += 8;
+            if (tag == LEPT_BINARY_INT64)
+                lept_set_int64(&u, (int64_t)w);
+            else {
+                memcpy(&u.u.n, &w, sizeof(w));
+                u.type = LEPT_NUMBER;
+            }
+            return lept_emit_number(c, &u);
+        }
+        case LEPT_BINARY_STRING:
+            if ((ret = lept_decode_string(c, &s, &n)) != LEPT_PARSE_OK)
+                return ret;
+            return LEPT_EMIT(c, on_string, (c->handler_ctx, s, n));
+        case LEPT_BINARY_ARRAY:
+            if (depth == c->max_depth)
+                return LEPT_PARSE_TOO_DEEP;
+            if ((ret = lept_decode_size(c, &n)) != LEPT_PARSE_OK)
+                return ret;
+            if ((ret = LEPT_EMIT(c, on_start_array, (c->handler_ctx))) != LEPT_PARSE_OK)
+                return ret;
+            for (i = 0; i < n; i++)
+                if ((ret = lept_decode_value(c, depth + 1)) != LEPT_PARSE_OK)
+                    return ret;
+            return LEPT_EMIT(c, on_end_array, (c->handler_ctx, n));
+        case LEPT_BINARY_OBJECT:
+            if (depth == c->max_depth)
+                return LEPT_PARSE_TOO_DEEP;
+            if ((ret = lept_decode_size(c, &n)) != LEPT_PARSE_OK)
+                return ret;
+            if ((ret = LEPT_EMIT(c, on_start_object, (c->handler_ctx))) != LEPT_PARSE_OK)
+                return ret;
+            for (i = 0; i < n; i++) {
+                if ((ret = lept_decode_string(c, &s, &klen)) != LEPT_PARSE_OK)
+                    return ret;
+                if ((ret = LEPT_EMIT(c, on_key, (c->handler_ctx, s, klen))) != LEPT_PARSE_OK)
+                    return ret;
+                if ((ret = lept_decode_value(c, depth + 1)) != LEPT_PARSE_OK)
+                    return ret;
+            }
+            return LEPT_EMIT(c, on_end_object, (c->handler_ctx, n));
+        default:
+            return LEPT_PARSE_INVALID_BINARY;
+    }
+}
+
+/* a view shares the strings of data by parsing it like in-situ input, which decodes nothing */
+static int lept_decode_context(lept_value* v, const char* data, size_t len, int view) {
+    lept_context c;
+    int ret;
+    assert(v != NULL && (data != NULL || len == 0));
+    lept_context_init(&c, NULL);
+    c.json = data;
+    c.end = data + len;
+    c.insitu = view;
+    c.handler = &lept_build_handler;
+    c.handler_ctx = &c;
+    lept_init(v);
+    if ((ret = lept_decode_value(&c, 0)) == LEPT_PARSE_OK && c.json != c.end)
+        ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+    if (ret == LEPT_PARSE_OK)
+        *v = *(lept_value*)lept_context_pop(&c, sizeof(lept_value));
+    else
+        lept_build_unwind(&c);
+    LEPT_FREE(c.stack);
+    return ret;
+}
+
+int lept_decode(lept_value* v, const char* data, size_t len) {
+    return lept_decode_context(v, data, len, 0);
+}
+
+int lept_decode_view(lept_value* v, const char* data, size_t len) {
+    return lept_decode_context(v, data, len, 1);
+}
+
+/*
+ * The writer fills its context stack and hands it to the sink once it holds buffer_size
+ * bytes. Long strings are escaped piecewise so that the buffer stays near that size.
+ */
+lept_writer* lept_writer_create(lept_write_func write, void* ctx, size_t buffer_size) {
+    lept_writer* w = (lept_writer*)LEPT_MALLOC(sizeof(lept_writer));
+    assert(write != NULL);
+    w->flush_size = buffer_size ? buffer_size : LEPT_WRITER_BUFFER_SIZE;
+    lept_context_init(&w->c, NULL);
+    w->c.stack = (char*)LEPT_MALLOC(w->c.size = w->flush_size + LEPT_DTOA_SIZE);
+    w->write = write;
+    w->ctx = ctx;
+    w->comma = 0;
+    w->error = LEPT_STRINGIFY_OK;
+    return w;
+}
+
+void lept_writer_destroy(lept_writer* w) {
+    if (w) {
+        LEPT_FREE(w->c.stack);
+        LEPT_FREE(w);
+    }
+}
+
+int lept_writer_flush(lept_writer* w) {
+    assert(w != NULL);
+    if (w->c.top && !w->error && w->write(w->ctx, w->c.stack, w->c.top))
+        w->error = LEPT_STRINGIFY_WRITE_ERROR;
+    w->c.top = 0;
+    return w->error;
+}
+
+static int lept_writer_sync(lept_writer* w) {
+    return w->c.top >= w->flush_size ? lept_writer_flush(w) : w->error;
+}
+
+/* separates a value from the one before it, nothing goes after '[', '{' or ':' */
+static void lept_writer_comma(lept_writer* w) {
+    if (w->comma)
+        PUTC(&w->c, ',');
+    w->comma = 1;
+}
+
+static void lept_writer_chars(lept_writer* w, const char* s, size_t len) {
+    PUTC(&w->c, '"');
+    while (len > w->flush_size) {
+        lept_stringify_chars(&w->c, s, w->flush_size);
+        lept_writer_sync(w);
+        s += w->flush_size;
+        len -= w->flush_size;
+    }
+    lept_stringify_chars(&w->c, s, len);
+    PUTC(&w->c, '"');
+}
+
+int lept_writer_null(lept_writer* w) {
+    assert(w != NULL);
+    lept_writer_comma(w);
+    PUTS(&w->c, "null", 4);
+    return lept_writer_sync(w);
+}
+
+int lept_writer_boolean(lept_writer* w, int b) {
+    assert(w != NULL);
+    lept_writer_comma(w);
+    if (b)
+        PUTS(&w->c, "true", 4);
+    else
+        PUTS(&w->c, "false", 5);
+    return lept_writer_sync(w);
+}
+
+int lept_writer_number(lept_writer* w, double n) {
+    char* p;
+    assert(w != NULL);
+    lept_writer_comma(w);
+    p = lept_dtoa(n, (char*)lept_context_push(&w->c, LEPT_DTOA_SIZE));
+    w->c.top = p - w->c.stack;
+    return lept_writer_sync(w);
+}
+
+int lept_writer_int64(lept_writer* w, int64_t i) {
+    char* p;
+    assert(w != NULL);
+    lept_writer_comma(w);
+    p = lept_write_int64(i, (char*)lept_context_push(&w->c, LEPT_DTOA_SIZE));
+    w->c.top = p - w->c.stack;
+    return lept_writer_sync(w);
+}
+
+int lept_writer_string(lept_writer* w, const char* s, size_t len) {
+    assert(w != NULL && (s != NULL || len == 0));
+    lept_writer_comma(w);
+    lept_writer_chars(w, s, len);
+    return lept_writer_sync(w);
+}
+
+int lept_writer_start_array(lept_writer* w) {
+    assert(w != NULL);
+    lept_writer_comma(w);
+    PUTC(&w->c, '[');
+    w->comma = 0;
+    return lept_writer_sync(w);
+}
+
+int lept_writer_end_array(lept_writer* w) {
+    assert(w != NULL);
+    PUTC(&w->c, ']');
+    w->comma = 1;
+    return lept_writer_sync(w);
+}
+
+int lept_writer_start_object(lept_writer* w) {
+    assert(w != NULL);
+    lept_writer_comma(w);
+    PUTC(&w->c, '{');
+    w->comma = 0;
+    return lept_writer_sync(w);
+}
+
+int lept_writer_key(lept_writer* w, const char* s, size_t len) {
+    assert(w != NULL && (s != NULL || len == 0));
+    lept_writer_comma(w);
+    lept_writer_chars(w, s, len);
+    PUTC(&w->c, ':');
+    w->comma = 0;
+    return lept_writer_sync(w);
+}
+
+int lept_writer_end_object(lept_writer* w) {
+    assert(w != NULL);
+    PUTC(&w->c, '}');
+    w->comma = 1;
+    return lept_writer_sync(w);
+}
+
+int lept_writer_value(lept_writer* w, const lept_value* v) {
+    size_t i;
+    assert(w != NULL && v != NULL);
+    switch (v->type) {
+        case LEPT_ARRAY:
+            lept_writer_start_array(w);
+            for (i = 0; i < v->u.a.size; i++)
+                lept_writer_value(w, &v->u.a.e[i]);
+            return lept_writer_end_array(w);
+        case LEPT_OBJECT:
+            lept_writer_start_object(w);
+            for (i = 0; i < v->u.o.size; i++) {
+                lept_writer_key(w, v->u.o.m[i].k, v->u.o.m[i].klen);
+                lept_writer_value(w, &v->u.o.m[i].v);
+            }
+            return lept_writer_end_object(w);
+        case LEPT_STRING:
+            return lept_writer_string(w, lept_get_string(v), lept_get_string_length(v));
+        default:
+            lept_writer_comma(w);
+            lept_stringify_value(&w->c, v);
+            return lept_writer_sync(w);
+    }
+}
+
+/*
+ * Tape words carry the type in the top byte and a payload below it. Numbers and strings
+ * take a second word (the bits, or the length), containers too (the size), and the
+ * payload of a container is the index right after its last descendant.
+ */
+#define LEPT_TAPE_WORD(type, payload)   ((uint64_t)(type) << 56 | (payload))
+#define LEPT_TAPE_TYPE(w)               ((lept_type)((w) >> 56 & 0x7F))
+#define LEPT_TAPE_INT64                 ((uint64_t)0x80 << 56)
+#define LEPT_TAPE_PAYLOAD(w)            ((w) & (((uint64_t)1 << 56) - 1))
+
+static void lept_tape_push(lept_tape* t, uint64_t w) {
+    if (t->size == t->capacity) {
+        t->capacity = t->capacity ? t->capacity + (t->capacity >> 1) : LEPT_TAPE_INIT_SIZE;
+        t->words = (uint64_t*)LEPT_REALLOC(t->words, t->capacity * sizeof(uint64_t));
+    }
+    t->words[t->size++] = w;
+}
+
+static int lept_tape_null(void* ctx) {
+    lept_tape_push((lept_tape*)ctx, LEPT_TAPE_WORD(LEPT_NULL, 0));
+    return 0;
+}
+
+static int lept_tape_boolean(void* ctx, int b) {
+    lept_tape_push((lept_tape*)ctx, LEPT_TAPE_WORD(b ? LEPT_TRUE : LEPT_FALSE, 0));
+    return 0;
+}
+
+static int lept_tape_number(void* ctx, double n) {
+    uint64_t bits;
+    memcpy(&bits, &n, sizeof(double));
+    lept_tape_push((lept_tape*)ctx, LEPT_TAPE_WORD(LEPT_NUMBER, 0));
+    lept_tape_push((lept_tape*)ctx, bits);
+    return 0;
+}
+
+static int lept_tape_int64(void* ctx, int64_t i) {
+    lept_tape_push((lept_tape*)ctx, LEPT_TAPE_WORD(LEPT_NUMBER, 0) | LEPT_TAPE_INT64);
+    lept_tape_push((lept_tape*)ctx, (uint64_t)i);
+    return 0;
+}
+
+static int lept_tape_string(void* ctx, const char* s, size_t len) {
+    lept_tape* t = (lept_tape*)ctx;
+    if (t->strings_size + len + 1 > t->strings_capacity) {
+        if (t->strings_capacity == 0)
+            t->strings_capacity = LEPT_TAPE_INIT_SIZE;
+        while (t->strings_size + len + 1 > t->strings_capacity)
+            t->strings_capacity += t->strings_capacity >> 1;
+        t->strings = (char*)LEPT_REALLOC(t->strings, t->strings_capacity);
+    }
+    memcpy(t->strings + t->strings_size, s, len);
+    t->strings[t->strings_size + len] = '\0';
+    lept_tape_push(t, LEPT_TAPE_WORD(LEPT_STRING, t->strings_size));
+    lept_tape_push(t, len);
+    t->strings_size += len + 1;
+    return 0;
+}
+
+static void lept_tape_open(lept_tape* t, lept_type type) {
+    if (t->depth == t->open_capacity) {
+        t->open_capacity = t->open_capacity ?
+            t->open_capacity + (t->open_capacity >> 1) : LEPT_STREAM_DEPTH_INIT_SIZE;
+        t->open = (size_t*)LEPT_REALLOC(t->open, t->open_capacity * sizeof(size_t));
+    }
+    t->open[t->depth++] = t->size;
+    lept_tape_push(t, LEPT_TAPE_WORD(type, 0));
+    lept_tape_push(t, 0);
+}
+
+static void lept_tape_close(lept_tape* t, size_t size) {
+    size_t i = t->open[--t->depth];
+    t->words[i] |= t->size;
+    t->words[i + 1] = size;
+}
+
+static int lept_tape_start_array(void* ctx) {
+    lept_tape_open((lept_tape*)ctx, LEPT_ARRAY);
+    return 0;
+}
+
+static int lept_tape_end_array(void* ctx, size_t size) {
+    lept_tape_close((lept_tape*)ctx, size);
+    return 0;
+}
+
+static int lept_tape_start_object(void* ctx) {
+    lept_tape_open((lept_tape*)ctx, LEPT_OBJECT);
+    return 0;
+}
+
+static int lept_tape_end_object(void* ctx, size_t size) {
+    lept_tape_close((lept_tape*)ctx, size);
+    return 0;
+}
+
+static const lept_handler lept_tape_handler = {
+    lept_tape_null,
+    lept_tape_boolean,
+    lept_tape_number,
+    lept_tape_int64,
+    lept_tape_string,
+    lept_tape_start_array,
+    lept_tape_end_array,
+    lept_tape_start_object,
+    lept_tape_string,
+    lept_tape_end_object
+};
+
+lept_tape* lept_tape_create(void) {
+    lept_tape* t = (lept_tape*)LEPT_MALLOC(sizeof(lept_tape));
+    t->words = NULL;
+    t->size = t->capacity = 0;
+    t->strings = NULL;
+    t->strings_size = t->strings_capacity = 0;
+    t->open = NULL;
+    t->depth = t->open_capacity = 0;
+    t->p = lept_parser_create();
+    return t;
+}
+
+void lept_tape_destroy(lept_tape* t) {
+    if (t) {
+        lept_parser_destroy(t->p);
+        LEPT_FREE(t->words);
+        LEPT_FREE(t->strings);
+        LEPT_FREE(t->open);
+        LEPT_FREE(t);
+    }
+}
+
+int lept_tape_parse(lept_tape* t, const char* json, size_t len) {
+    int ret;
+    assert(t != NULL);
+    t->size = t->strings_size = t->depth = 0;
+    if ((ret = lept_parser_parse_sax(t->p, json, len, &lept_tape_handler, t)) != LEPT_PARSE_OK)
+        t->size = t->strings_size = t->depth = 0;
+    return ret;
+}
+
+size_t lept_tape_first(const lept_tape* t, size_t i) {
+    assert(t != NULL && i < t->size);
+    assert(LEPT_TAPE_TYPE(t->words[i]) == LEPT_ARRAY || LEPT_TAPE_TYPE(t->words[i]) == LEPT_OBJECT);
+    return i + 2;
+}
+
+size_t lept_tape_next(const lept_tape* t, size_t i) {
+    assert(t != NULL && i < t->size);
+    switch (LEPT_TAPE_TYPE(t->words[i])) {
+        case LEPT_ARRAY:
+        case LEPT_OBJECT:   return (size_t)LEPT_TAPE_PAYLOAD(t->words[i]);
+        case LEPT_NUMBER:
+        case LEPT_STRING:   return i + 2;
+        default:            return i + 1;
+    }
+}
+
+lept_type lept_tape_get_type(const lept_tape* t, size_t i) {
+    assert(t != NULL && i < t->size);
+    return LEPT_TAPE_TYPE(t->words[i]);
+}
+
+int lept_tape_get_boolean(const lept_tape* t, size_t i) {
+    assert(t != NULL && i < t->size);
+    assert(LEPT_TAPE_TYPE(t->words[i]) == LEPT_TRUE || LEPT_TAPE_TYPE(t->words[i]) == LEPT_FALSE);
+    return LEPT_TAPE_TYPE(t->words[i]) == LEPT_TRUE;
+}
+
+double lept_tape_get_number(const lept_tape* t, size_t i) {
+    double n;
+    assert(t != NULL && i < t->size && LEPT_TAPE_TYPE(t->words[i]) == LEPT_NUMBER);
+    if (t->words[i] & LEPT_TAPE_INT64)
+        return (double)(int64_t)t->words[i + 1];
+    memcpy(&n, &t->words[i + 1], sizeof(double));
+    return n;
+}
+
+int lept_tape_is_int64(const lept_tape* t, size_t i) {
+    assert(t != NULL && i < t->size && LEPT_TAPE_TYPE(t->words[i]) == LEPT_NUMBER);
+    return (t->words[i] & LEPT_TAPE_INT64) != 0;
+}
+
+int64_t lept_tape_get_int64(const lept_tape* t, size_t i) {
+    assert(t != NULL && i < t->size && (t->words[i] & LEPT_TAPE_INT64));
+    return (int64_t)t->words[i + 1];
+}
+
+const char* lept_tape_get_string(const lept_tape* t, size_t i) {
+    assert(t != NULL && i < t->size && LEPT_TAPE_TYPE(t->words[i]) == LEPT_STRING);
+    return t->strings + LEPT_TAPE_PAYLOAD(t->words[i]);
+}
+
+size_t lept_tape_get_string_length(const lept_tape* t, size_t i) {
+    assert(t != NULL && i < t->size && LEPT_TAPE_TYPE(t->words[i]) == LEPT_STRING);
+    return (size_t)t->words[i + 1];
+}
+
+size_t lept_tape_get_size(const lept_tape* t, size_t i) {
+    assert(t != NULL && i < t->size);
+    assert(LEPT_TAPE_TYPE(t->words[i]) == LEPT_ARRAY || LEPT_TAPE_TYPE(t->words[i]) == LEPT_OBJECT);
+    return (size_t)t->words[i + 1];
+}
+
+void lept_free(lept_value* v) {
+    size_t i;
+    assert(v != NULL);
+    /* an arena releases a whole tree at once, there is nothing to walk */
+    if (!(v->flags & LEPT_VALUE_EXTERNAL)) {
+        switch (v->type) {
+            case LEPT_STRING:
+                if (!(v->flags & LEPT_VALUE_SHORT))
+                    LEPT_FREE(v->u.s.s);
+                break;
+            case LEPT_ARRAY:
+                for (i = 0; i < v->u.a.size; i++)
+                    lept_free(&v->u.a.e[i]);
+                LEPT_FREE(v->u.a.e);
+                break;
+            case LEPT_OBJECT:
+                for (i = 0; i < v->u.o.size; i++)
+                    lept_free(&v->u.o.m[i].v);
+                LEPT_FREE(v->u.o.m); /* keys included */
+                break;
+            default: break;
+        }
+    }
+    v->type = LEPT_NULL;
+    v->flags = 0;
+}
+
+size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen) {
+    size_t i;
+    assert(v != NULL && v->type == LEPT_OBJECT && (key != NULL || klen == 0));
+    if (v->flags & LEPT_VALUE_INDEXED) {
+        const uint32_t* index = (const uint32_t*)(v->u.o.m + v->u.o.size);
+        size_t mask = lept_index_slots(v->u.o.size) - 1;
+        for (i = lept_hash_key(key, klen) & mask; index[i]; i = (i + 1) & mask) {
+            const lept_member* m = &v->u.o.m[index[i] - 1];
+            if (m->klen == klen && memcmp(m->k, key, klen) == 0)
+                return index[i] - 1;
+        }
+        return LEPT_KEY_NOT_EXIST;
+    }
+    for (i = 0; i < v->u.o.size; i++)
+        if (v->u.o.m[i].klen == klen && memcmp(v->u.o.m[i].k, key, klen) == 0)
+            return i;
+    return LEPT_KEY_NOT_EXIST;
+}
+
+lept_value* lept_find_object_value(const lept_value* v, const char* key, size_t klen) {
+    size_t i = lept_find_object_index(v, key, klen);
+    return i != LEPT_KEY_NOT_EXIST ? &v->u.o.m[i].v : NULL;
+}
+
+int lept_is_equal(const lept_value* lhs, const lept_value* rhs) {
+    size_t i;
+    assert(lhs != NULL && rhs != NULL);
+    if (lhs->type != rhs->type)
+        return 0;
+    switch (lhs->type) {
+        case LEPT_STRING:
+            return lept_get_string_length(lhs) == lept_get_string_length(rhs) &&
+                memcmp(lept_get_string(lhs), lept_get_string(rhs), lept_get_string_length(lhs)) == 0;
+        case LEPT_NUMBER:
+            LEPT_MATERIALIZE(lhs);
+            LEPT_MATERIALIZE(rhs);
+            if (lhs->flags & rhs->flags & LEPT_VALUE_INT64)
+                return lhs->u.i == rhs->u.i;
+            if ((lhs->flags | rhs->flags) & LEPT_VALUE_INT64) {
+                /* exactly, a double rounded to a neighbour of the int64 is another number */
+                const lept_value* i = lhs->flags & LEPT_VALUE_INT64 ? lhs : rhs;
+                double d = lept_get_number(i == lhs ? rhs : lhs);
+                return d >= -9223372036854775808.0 && d < 9223372036854775808.0 &&
+                    (double)(int64_t)d == d && (int64_t)d == i->u.i;
+            }
+            return lept_get_number(lhs) == lept_get_number(rhs);
+        case LEPT_ARRAY:
+            if (lhs->u.a.size != rhs->u.a.size)
+                return 0;
+            for (i = 0; i < lhs->u.a.size; i++)
+                if (!lept_is_equal(&lhs->u.a.e[i], &rhs->u.a.e[i]))
+                    return 0;
+            return 1;
+        case LEPT_OBJECT:
+            /* members may come in any order */
+            if (lhs->u.o.size != rhs->u.o.size)
+                return 0;
+            for (i = 0; i < lhs->u.o.size; i++) {
+                const lept_value* r = lept_find_object_value(rhs, lhs->u.o.m[i].k, lhs->u.o.m[i].klen);
+                if (!r || !lept_is_equal(&lhs->u.o.m[i].v, r))
+                    return 0;
+            }
+            return 1;
+        default:
+            return 1;
+    }
+}
+
+lept_type lept_get_type(const lept_value* v) {
+    assert(v != NULL);
+    return v->type;
+}
+
+int lept_get_boolean(const lept_value* v) {
+    assert(v != NULL && (v->type == LEPT_TRUE || v->type == LEPT_FALSE));
+    return v->type == LEPT_TRUE;
+}
+
+void lept_set_boolean(lept_value* v, int b) {
+    lept_free(v);
+    v->type = b ? LEPT_TRUE : LEPT_FALSE;
+}
+
+double lept_get_number(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_NUMBER);
+    LEPT_MATERIALIZE(v);
+    return v->flags & LEPT_VALUE_INT64 ? (double)v->u.i : v->u.n;
+}
+
+void lept_set_number(lept_value* v, double n) {
+    lept_free(v);
+    v->u.n = n;
+    v->type = LEPT_NUMBER;
+}
+
+int lept_is_int64(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_NUMBER);
+    LEPT_MATERIALIZE(v);
+    return (v->flags & LEPT_VALUE_INT64) != 0;
+}
+
+int64_t lept_get_int64(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_NUMBER);
+    LEPT_MATERIALIZE(v);
+    assert(v->flags & LEPT_VALUE_INT64);
+    return v->u.i;
+}
+
+void lept_set_int64(lept_value* v, int64_t i) {
+    lept_free(v);
+    v->u.i = i;
+    v->type = LEPT_NUMBER;
+    v->flags |= LEPT_VALUE_INT64;
+}
+
+const char* lept_get_string(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_STRING);
+    LEPT_MATERIALIZE(v);
+    return v->flags & LEPT_VALUE_SHORT ? v->u.ss : v->u.s.s;
+}
+
+size_t lept_get_string_length(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_STRING);
+    LEPT_MATERIALIZE(v);
+    return v->flags & LEPT_VALUE_SHORT ? (unsigned char)v->u.ss[sizeof(v->u.ss) - 1] : v->u.s.len;
+}
+
+void lept_set_string(lept_value* v, const char* s, size_t len) {
     assert(v != NULL && (s != NULL || len == 0));
     lept_free(v);
-    v->u.s.s = (char*)malloc(len + 1);
+    if (len <= LEPT_SHORT_STRING_MAX) {
+        memcpy(v->u.ss, s, len);
+        v->u.ss[len] = '\0';
+        v->u.ss[sizeof(v->u.ss) - 1] = (char)len;
+        v->type = LEPT_STRING;
+        v->flags |= LEPT_VALUE_SHORT;
+        return;
+    }
+    v->u.s.s = (char*)LEPT_MALLOC(len + 1);
     memcpy(v->u.s.s, s, len);
     v->u.s.s[len] = '\0';
     v->u.s.len = len;
     v->type = LEPT_STRING;
 }
+
+size_t lept_get_array_size(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_ARRAY);
+    return v->u.a.size;
+}
+
+lept_value* lept_get_array_element(const lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_ARRAY);
+    assert(index < v->u.a.size);
+    return &v->u.a.e[index];
+}
+
+size_t lept_get_object_size(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    return v->u.o.size;
+}
+
+const char* lept_get_object_key(const lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    assert(index < v->u.o.size);
+    return v->u.o.m[index].k;
+}
+
+size_t lept_get_object_key_length(const lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    assert(index < v->u.o.size);
+    return v->u.o.m[index].klen;
+}
+
+lept_value* lept_get_object_value(const lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    assert(index < v->u.o.size);
+    return &v->u.o.m[index].v;
+}
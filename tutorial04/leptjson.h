@@ -2,16 +2,30 @@
 #define LEPTJSON_H__
 
 #include <stddef.h> /* size_t */
+#include <stdint.h> /* int64_t */
 
 typedef enum { LEPT_NULL, LEPT_FALSE, LEPT_TRUE, LEPT_NUMBER, LEPT_STRING, LEPT_ARRAY, LEPT_OBJECT } lept_type;
 
-typedef struct {
+typedef struct lept_value lept_value;
+typedef struct lept_member lept_member;
+
+struct lept_value {
     union {
-        struct { char* s; size_t len; }s;  /* string: null-terminated string, string length */
-        double n;                          /* number */
+        struct { lept_member* m; size_t size; }o;   /* object: members, member count */
+        struct { lept_value* e; size_t size; }a;    /* array:  elements, element count */
+        struct { char* s; size_t len; }s;           /* string: null-terminated string, string length */
+        char ss[sizeof(char*) + sizeof(size_t)];    /* string: short one inline, its length in the last byte */
+        double n;                                   /* number */
+        int64_t i;                                  /* number: integer without fraction or exponent */
     }u;
     lept_type type;
-}lept_value;
+    unsigned char flags;
+};
+
+struct lept_member {
+    char* k; size_t klen;   /* member key string, key string length */
+    lept_value v;           /* member value */
+};
 
 enum {
     LEPT_PARSE_OK = 0,
@@ -23,14 +37,248 @@ enum {
     LEPT_PARSE_INVALID_STRING_ESCAPE,
     LEPT_PARSE_INVALID_STRING_CHAR,
     LEPT_PARSE_INVALID_UNICODE_HEX,
-    LEPT_PARSE_INVALID_UNICODE_SURROGATE
+    LEPT_PARSE_INVALID_UNICODE_SURROGATE,
+    LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
+    LEPT_PARSE_MISS_KEY,
+    LEPT_PARSE_MISS_COLON,
+    LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+    LEPT_PARSE_ABORTED,     /* a handler callback returned non-zero */
+    LEPT_PARSE_FILE_ERROR,  /* the file could not be opened or mapped */
+    LEPT_PARSE_INVALID_UTF8, /* a string is not well-formed UTF-8, only with a strict parser */
+    LEPT_PARSE_TYPE_MISMATCH, /* a member has another type than its field in a schema */
+    LEPT_PARSE_INVALID_BINARY, /* truncated or unknown input to lept_decode() */
+    LEPT_PARSE_TOO_DEEP     /* arrays and objects nest deeper than the parser allows */
 };
 
-#define lept_init(v) do { (v)->type = LEPT_NULL; } while(0)
+/*
+ * Events of lept_parse_sax(), in document order. Every callback returns 0 to go on, any other
+ * value stops the parse. NULL callbacks are skipped. Strings and keys are decoded, s is only
+ * valid during the call (in-situ parsing aside) and is null-terminated only in-situ.
+ */
+typedef struct {
+    int (*on_null)(void* ctx);
+    int (*on_boolean)(void* ctx, int b);
+    int (*on_number)(void* ctx, double n);
+    int (*on_int64)(void* ctx, int64_t i);  /* integers, reported to on_number when NULL */
+    int (*on_string)(void* ctx, const char* s, size_t len);
+    int (*on_start_array)(void* ctx);
+    int (*on_end_array)(void* ctx, size_t size);
+    int (*on_start_object)(void* ctx);
+    int (*on_key)(void* ctx, const char* s, size_t len);
+    int (*on_end_object)(void* ctx, size_t size);
+}lept_handler;
+
+enum {
+    LEPT_STRINGIFY_OK = 0,
+    LEPT_STRINGIFY_WRITE_ERROR  /* the sink of a writer failed */
+};
+
+typedef struct lept_arena lept_arena;
+typedef struct lept_parser lept_parser;
+typedef struct lept_query lept_query;
+typedef struct lept_schema lept_schema;
+typedef struct lept_tape lept_tape;
+typedef struct lept_writer lept_writer;
+typedef int (*lept_write_func)(void* ctx, const char* buf, size_t len); /* returns non-zero on failure */
+
+/*
+ * Every allocation of the library goes through these, malloc(), realloc() and free() by
+ * default. realloc_func gets NULL for a new block and free_func may get NULL.
+ */
+typedef struct {
+    void* (*malloc_func)(void* ctx, size_t size);
+    void* (*realloc_func)(void* ctx, void* ptr, size_t size);
+    void (*free_func)(void* ctx, void* ptr);
+    void* ctx;
+}lept_allocator;
+
+/*
+ * Shared by all threads: set it before anything is allocated and keep it while anything it
+ * allocated lives, the callbacks then serve every thread (per-thread pools pick by themselves).
+ * a is copied, NULL restores the default.
+ */
+void lept_set_allocator(const lept_allocator* a);
+
+#define lept_init(v) do { (v)->type = LEPT_NULL; (v)->flags = 0; } while(0)
 
 int lept_parse(lept_value* v, const char* json);
+int lept_parse_n(lept_value* v, const char* json, size_t len); /* json needs not be null-terminated */
+int lept_parse_arena(lept_value* v, const char* json, size_t len, lept_arena* a); /* a may be NULL */
+/* decodes strings into json itself, they stay valid as long as the buffer does */
+int lept_parse_insitu(lept_value* v, char* json, size_t len);
+/*
+ * Checks numbers and escape-free strings without decoding them, accessors decode them from
+ * json on first use, so json must outlive v. Numbers out of range read as infinity rather
+ * than failing. The first access writes to v, do not share an undecoded tree among threads.
+ */
+int lept_parse_lazy(lept_value* v, const char* json, size_t len);
+/* reports the document to h instead of building it, trailing garbage fails after the events */
+int lept_parse_sax(const char* json, size_t len, const lept_handler* h, void* ctx);
+/*
+ * The same parse in two stages: a vector pass indexes every token outside strings first,
+ * then the tree is built by the index. Takes four bytes of index per token.
+ */
+int lept_parse_indexed(lept_value* v, const char* json, size_t len);
+/* maps the file read-only and parses it where it lies, strings are still copied out */
+int lept_parse_file(lept_value* v, const char* path);
+/*
+ * Newline delimited JSON: v becomes an array of one value per line, blank lines skipped.
+ * Splits the input among up to threads threads. On error *line (may be NULL) is the
+ * 0-based index of the first failing line.
+ */
+int lept_parse_ndjson(lept_value* v, const char* json, size_t len, unsigned threads, size_t* line);
+/*
+ * A document of one top-level array is split at element boundaries among up to threads
+ * threads, its elements parsed in parallel and kept in order. Anything else takes one thread.
+ */
+int lept_parse_parallel(lept_value* v, const char* json, size_t len, unsigned threads);
+
+/* phases of lept_stats ticks, they nest: the stack may grow within a string */
+enum {
+    LEPT_PHASE_WHITESPACE,
+    LEPT_PHASE_STRING,
+    LEPT_PHASE_NUMBER,
+    LEPT_PHASE_STACK,       /* growing the scratch buffer */
+    LEPT_PHASE_COUNT
+};
+
+typedef struct {
+    size_t bytes;                   /* input read, up to the error if any */
+    size_t values[LEPT_OBJECT + 1]; /* values started, by type */
+    size_t escapes;
+    size_t stack_reallocs;
+    size_t stack_size;              /* scratch buffer capacity at the end */
+    int error;                      /* the result of the parse */
+    int timed;                      /* whether ticks were sampled this time, one parse in LEPT_STATS_SAMPLE */
+    uint64_t ticks[LEPT_PHASE_COUNT];
+}lept_stats;
+
+typedef void (*lept_stats_func)(void* ctx, const lept_stats* s);
+/*
+ * Reports every document parsed into a DOM, by SAX, query or schema to func (NULL to stop),
+ * but only when the library is built with LEPT_STATS: otherwise nothing is counted at all.
+ * Set it before parsing in several threads, func itself may then be called from any of them.
+ */
+void lept_set_stats_handler(lept_stats_func func, void* ctx);
+
+lept_arena* lept_arena_create(size_t block_size); /* 0 for the default block size */
+void lept_arena_reset(lept_arena* a);   /* releases every value parsed into a at once */
+/* lept_free() does not descend into arrays and objects parsed into an arena */
+void lept_arena_destroy(lept_arena* a);
+
+/* a parser keeps its scratch buffer between documents, use one per thread */
+lept_parser* lept_parser_create(void);
+void lept_parser_destroy(lept_parser* p);
+void lept_parser_set_arena(lept_parser* p, lept_arena* a); /* a may be NULL */
+/* rejects strings and keys that are not well-formed UTF-8, off by default (vectorized with
+ * NEON, SSSE3 or AVX2, scalar otherwise) */
+void lept_parser_set_strict_utf8(lept_parser* p, int strict);
+/* hashes the keys of objects of 16 members or more for lept_find_object_index(), off by default */
+void lept_parser_set_object_index(lept_parser* p, int index);
+/* open arrays and objects at most, 512 by default (LEPT_PARSE_MAX_DEPTH) and 0 for no limit */
+void lept_parser_set_max_depth(lept_parser* p, size_t depth);
+int lept_parser_parse(lept_parser* p, lept_value* v, const char* json, size_t len);
+int lept_parser_parse_insitu(lept_parser* p, lept_value* v, char* json, size_t len);
+int lept_parser_parse_lazy(lept_parser* p, lept_value* v, const char* json, size_t len); /* without an arena */
+int lept_parser_parse_indexed(lept_parser* p, lept_value* v, const char* json, size_t len);
+int lept_parser_parse_sax(lept_parser* p, const char* json, size_t len, const lept_handler* h, void* ctx);
+/*
+ * JSON Pointer queries (RFC 6901) compiled once, then run against raw input: only the
+ * values at the paths are built, everything else is skipped with its brackets counted,
+ * neither decoded nor fully checked. values[i] and found[i] receive the first match of
+ * paths[i] in document order, and the input is read only until every path is found.
+ */
+lept_query* lept_query_create(const char* const* paths, size_t count); /* NULL for a bad pointer */
+void lept_query_destroy(lept_query* q);
+size_t lept_query_get_size(const lept_query* q); /* paths */
+int lept_query_run(const lept_query* q, const char* json, size_t len, lept_value* values, int* found);
+int lept_parser_query(lept_parser* p, const lept_query* q, const char* json, size_t len, lept_value* values, int* found);
+/*
+ * Decoding an object straight into a struct, a table of fields ends with a NULL name:
+ *   LEPT_FALSE, LEPT_TRUE  int, either literal
+ *   LEPT_NUMBER            double
+ *   LEPT_STRING            char*, null-terminated
+ *   LEPT_OBJECT            the nested struct of fields, or a lept_value when fields is NULL
+ *   LEPT_ARRAY             lept_value
+ *   LEPT_NULL              lept_value of any type
+ * Unknown members are skipped like by queries, absent ones keep what out held. Pointers and
+ * lept_value members start NULL and lept_init()ed, lept_schema_free() releases them. A struct
+ * filled by a parser with an arena holds arena memory instead: never pass it to
+ * lept_schema_free(), resetting the arena releases it. On error out is freed (left to the
+ * arena with one) and *field (may be NULL) is the mismatched field, NULL when the root is no
+ * object.
+ */
+typedef struct lept_field {
+    const char* name;
+    size_t offset;                  /* offsetof() the member */
+    lept_type type;
+    const struct lept_field* fields;
+}lept_field;
+
+lept_schema* lept_schema_create(const lept_field* fields);
+void lept_schema_destroy(lept_schema* s);
+int lept_schema_parse(const lept_schema* s, void* out, const char* json, size_t len, const lept_field** field);
+int lept_parser_parse_schema(lept_parser* p, const lept_schema* s, void* out, const char* json, size_t len, const lept_field** field);
+void lept_schema_free(const lept_schema* s, void* out);
+/* incremental parsing of one document: feed it in chunks of any size, then finish */
+int lept_parser_feed(lept_parser* p, const char* chunk, size_t len);
+int lept_parser_finish(lept_parser* p, lept_value* v);
+
+/*
+ * A read-only tape laid out in document order in one array, the root is at index 0.
+ * Containers know where they end: lept_tape_next() steps over a whole subtree at once.
+ * Walk an array from lept_tape_first() with lept_tape_next(), an object alternates keys
+ * (strings) and values the same way.
+ */
+lept_tape* lept_tape_create(void);
+void lept_tape_destroy(lept_tape* t);
+int lept_tape_parse(lept_tape* t, const char* json, size_t len); /* empties t on error */
+size_t lept_tape_first(const lept_tape* t, size_t i);
+size_t lept_tape_next(const lept_tape* t, size_t i);
+lept_type lept_tape_get_type(const lept_tape* t, size_t i);
+int lept_tape_get_boolean(const lept_tape* t, size_t i);
+double lept_tape_get_number(const lept_tape* t, size_t i);
+int lept_tape_is_int64(const lept_tape* t, size_t i);
+int64_t lept_tape_get_int64(const lept_tape* t, size_t i);
+const char* lept_tape_get_string(const lept_tape* t, size_t i);
+size_t lept_tape_get_string_length(const lept_tape* t, size_t i);
+size_t lept_tape_get_size(const lept_tape* t, size_t i); /* elements or members */
+
+/* *json is null-terminated and freed with free_func of the allocator, length may be NULL */
+int lept_stringify(const lept_value* v, char** json, size_t* length);
+
+/*
+ * A compact binary form of a value for machines: numbers keep their bits, strings and sizes
+ * are length-prefixed. *data is freed like lept_stringify() results. Decoding checks the
+ * structure only, strings are taken as they are. A view shares the strings of data, which
+ * must then outlive v.
+ */
+int lept_encode(const lept_value* v, char** data, size_t* length);
+int lept_decode(lept_value* v, const char* data, size_t len);
+int lept_decode_view(lept_value* v, const char* data, size_t len);
+
+/*
+ * Streams JSON to write in pieces of about buffer_size bytes (0 for the default), from a
+ * tree or value by value. The caller nests the calls correctly, a key before every value
+ * of an object. Errors of the sink stick, flush before destroying to send the rest.
+ */
+lept_writer* lept_writer_create(lept_write_func write, void* ctx, size_t buffer_size);
+void lept_writer_destroy(lept_writer* w);
+int lept_writer_flush(lept_writer* w);
+int lept_writer_value(lept_writer* w, const lept_value* v);
+int lept_writer_null(lept_writer* w);
+int lept_writer_boolean(lept_writer* w, int b);
+int lept_writer_number(lept_writer* w, double n);
+int lept_writer_int64(lept_writer* w, int64_t i);
+int lept_writer_string(lept_writer* w, const char* s, size_t len);
+int lept_writer_start_array(lept_writer* w);
+int lept_writer_end_array(lept_writer* w);
+int lept_writer_start_object(lept_writer* w);
+int lept_writer_key(lept_writer* w, const char* s, size_t len);
+int lept_writer_end_object(lept_writer* w);
 
 void lept_free(lept_value* v);
+int lept_is_equal(const lept_value* lhs, const lept_value* rhs);
 
 lept_type lept_get_type(const lept_value* v);
 
@@ -41,9 +289,24 @@ void lept_set_boolean(lept_value* v, int b);
 
 double lept_get_number(const lept_value* v);
 void lept_set_number(lept_value* v, double n);
+int lept_is_int64(const lept_value* v);
+int64_t lept_get_int64(const lept_value* v); /* requires lept_is_int64() */
+void lept_set_int64(lept_value* v, int64_t i);
 
 const char* lept_get_string(const lept_value* v);
 size_t lept_get_string_length(const lept_value* v);
 void lept_set_string(lept_value* v, const char* s, size_t len);
 
+size_t lept_get_array_size(const lept_value* v);
+lept_value* lept_get_array_element(const lept_value* v, size_t index);
+
+size_t lept_get_object_size(const lept_value* v);
+const char* lept_get_object_key(const lept_value* v, size_t index);
+size_t lept_get_object_key_length(const lept_value* v, size_t index);
+lept_value* lept_get_object_value(const lept_value* v, size_t index);
+/* the first member of key, a hash lookup in indexed objects and a scan in the others */
+#define LEPT_KEY_NOT_EXIST ((size_t)-1)
+size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen);
+lept_value* lept_find_object_value(const lept_value* v, const char* key, size_t klen); /* NULL if none */
+
 #endif /* LEPTJSON_H__ */
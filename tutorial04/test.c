@@ -2,6 +2,8 @@
 #define _CRTDBG_MAP_ALLOC
 #include <crtdbg.h>
 #endif
+#include <locale.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,7 +25,9 @@ static int test_pass = 0;
     } while(0)
 
 #define EXPECT_EQ_INT(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%d")
+#define EXPECT_EQ_INT64(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (long)(expect), (long)(actual), "%ld")
 #define EXPECT_EQ_DOUBLE(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%.17g")
+#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (unsigned long)expect, (unsigned long)actual, "%lu")
 #define EXPECT_EQ_STRING(expect, actual, alength) \
     EXPECT_EQ_BASE(sizeof(expect) - 1 == alength && memcmp(expect, actual, alength) == 0, expect, actual, "%s")
 #define EXPECT_TRUE(actual) EXPECT_EQ_BASE((actual) != 0, "true", "false", "%s")
@@ -96,6 +100,68 @@ static void test_parse_number() {
     TEST_NUMBER(-2.2250738585072014e-308, "-2.2250738585072014e-308");
     TEST_NUMBER( 1.7976931348623157e+308, "1.7976931348623157e+308");  /* Max double */
     TEST_NUMBER(-1.7976931348623157e+308, "-1.7976931348623157e+308");
+
+    /* correct rounding beyond the fast paths */
+    TEST_NUMBER(2.225073858507201e-308, "2.2250738585072011e-308");
+    TEST_NUMBER(0.0, "2.4703282292062327e-324"); /* just below half of the minimum denormal */
+    TEST_NUMBER(4.9406564584124654e-324, "2.4703282292062328e-324");
+    TEST_NUMBER(1.7976931348623157e+308, "1.7976931348623158e+308");
+    TEST_NUMBER(1e23, "1e23");
+    TEST_NUMBER(9007199254740992.0, "9007199254740993"); /* halfway, ties to even */
+    TEST_NUMBER(9007199254740994.0, "9007199254740993.0000000000000000001");
+    TEST_NUMBER(1.2345678901234568e+29, "123456789012345678901234567890");
+    TEST_NUMBER(1.0, "1.00000000000000011102230246251565404236316680908203125"); /* exactly 1 + 2^-53 */
+    TEST_NUMBER(1.0000000000000002, "1.00000000000000011102230246251565404236316680908203125001");
+    TEST_NUMBER(0.1, "0.1000000000000000000000000000000000000000000000000000000000000000000000001");
+}
+
+#define TEST_INT64(expect, json)\
+    do {\
+        lept_value v;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        EXPECT_EQ_INT(LEPT_NUMBER, lept_get_type(&v));\
+        EXPECT_TRUE(lept_is_int64(&v));\
+        EXPECT_EQ_INT64(expect, lept_get_int64(&v));\
+        EXPECT_EQ_DOUBLE((double)expect, lept_get_number(&v));\
+        lept_free(&v);\
+    } while(0)
+
+#define TEST_NOT_INT64(expect, json)\
+    do {\
+        lept_value v;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        EXPECT_FALSE(lept_is_int64(&v));\
+        EXPECT_EQ_DOUBLE(expect, lept_get_number(&v));\
+        lept_free(&v);\
+    } while(0)
+
+static void test_parse_int64() {
+    TEST_INT64(0, "0");
+    TEST_INT64(1, "1");
+    TEST_INT64(-1, "-1");
+    TEST_INT64(1234567890, "1234567890");
+    TEST_INT64(INT64_C(9007199254740993), "9007199254740993"); /* not exact as a double */
+    TEST_INT64(INT64_MAX, "9223372036854775807");
+    TEST_INT64(INT64_MIN, "-9223372036854775808");
+
+    TEST_NOT_INT64(0.0, "-0");
+    TEST_NOT_INT64(1.0, "1.0");
+    TEST_NOT_INT64(100.0, "1e2");
+    TEST_NOT_INT64(9223372036854775808.0, "9223372036854775808");
+    TEST_NOT_INT64(-9223372036854775809.0, "-9223372036854775809");
+    TEST_NOT_INT64(1e20, "100000000000000000000");
+}
+
+static void test_parse_number_locale() {
+    /* the decimal point is always '.', whatever LC_NUMERIC says */
+    if (setlocale(LC_NUMERIC, "de_DE.UTF-8") || setlocale(LC_NUMERIC, "de_DE")) {
+        TEST_NUMBER(1.5, "1.5");
+        TEST_NUMBER(-3.1416, "-3.1416");
+        TEST_NUMBER(1.234E-10, "1.234E-10");
+        setlocale(LC_NUMERIC, "C");
+    }
 }
 
 #define TEST_STRING(expect, json)\
@@ -121,6 +187,142 @@ static void test_parse_string() {
     TEST_STRING("\xF0\x9D\x84\x9E", "\"\\ud834\\udd1e\"");  /* G clef sign U+1D11E */
 }
 
+static void test_parse_string_long() {
+    /* put a special character at every offset of the vectorized scan */
+    static const char* const special[] = { "\\n", "\\\"", "\x01" };
+    static const char expect_special[] = { '\n', '"', 0 };
+    char json[100], expect[100];
+    size_t n, i, k;
+    lept_value v;
+    lept_init(&v);
+    for (n = 0; n < 70; n++) {
+        for (i = 0; i < n; i++)
+            expect[i] = json[i + 1] = (char)('a' + i % 26);
+        json[0] = json[n + 1] = '"';
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_n(&v, json, n + 2));
+        EXPECT_EQ_SIZE_T(n, lept_get_string_length(&v));
+        EXPECT_TRUE(memcmp(expect, lept_get_string(&v), n) == 0);
+        lept_free(&v);
+        EXPECT_EQ_INT(LEPT_PARSE_MISS_QUOTATION_MARK, lept_parse_n(&v, json, n + 1));
+        for (k = 0; k < 3; k++) {
+            size_t slen = strlen(special[k]);
+            memmove(json + 1 + slen, json + 1, n + 1);
+            memcpy(json + 1, special[k], slen);
+            expect[n] = expect_special[k];
+            if (k < 2) {
+                EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_n(&v, json, n + slen + 2));
+                EXPECT_EQ_SIZE_T(n + 1, lept_get_string_length(&v));
+                EXPECT_EQ_INT(expect_special[k], lept_get_string(&v)[0]);
+                EXPECT_TRUE(memcmp(expect, lept_get_string(&v) + 1, n) == 0);
+                lept_free(&v);
+            }
+            else
+                EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_CHAR, lept_parse_n(&v, json, n + slen + 2));
+            memmove(json + 1, json + 1 + slen, n + 1);
+        }
+    }
+    lept_free(&v);
+}
+
+static void test_parse_array() {
+    size_t i, j;
+    lept_value v;
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[ ]"));
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(&v));
+    EXPECT_EQ_SIZE_T(0, lept_get_array_size(&v));
+    lept_free(&v);
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[ null , false , true , 123 , \"abc\" ]"));
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(&v));
+    EXPECT_EQ_SIZE_T(5, lept_get_array_size(&v));
+    EXPECT_EQ_INT(LEPT_NULL,   lept_get_type(lept_get_array_element(&v, 0)));
+    EXPECT_EQ_INT(LEPT_FALSE,  lept_get_type(lept_get_array_element(&v, 1)));
+    EXPECT_EQ_INT(LEPT_TRUE,   lept_get_type(lept_get_array_element(&v, 2)));
+    EXPECT_EQ_INT(LEPT_NUMBER, lept_get_type(lept_get_array_element(&v, 3)));
+    EXPECT_EQ_INT(LEPT_STRING, lept_get_type(lept_get_array_element(&v, 4)));
+    EXPECT_EQ_DOUBLE(123.0, lept_get_number(lept_get_array_element(&v, 3)));
+    EXPECT_EQ_STRING("abc", lept_get_string(lept_get_array_element(&v, 4)), lept_get_string_length(lept_get_array_element(&v, 4)));
+    lept_free(&v);
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[ [ ] , [ 0 ] , [ 0 , 1 ] , [ 0 , 1 , 2 ] ]"));
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(&v));
+    EXPECT_EQ_SIZE_T(4, lept_get_array_size(&v));
+    for (i = 0; i < 4; i++) {
+        lept_value* a = lept_get_array_element(&v, i);
+        EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(a));
+        EXPECT_EQ_SIZE_T(i, lept_get_array_size(a));
+        for (j = 0; j < i; j++) {
+            lept_value* e = lept_get_array_element(a, j);
+            EXPECT_EQ_INT(LEPT_NUMBER, lept_get_type(e));
+            EXPECT_EQ_DOUBLE((double)j, lept_get_number(e));
+        }
+    }
+    lept_free(&v);
+}
+
+static void test_parse_object() {
+    lept_value v;
+    size_t i;
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, " { } "));
+    EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(&v));
+    EXPECT_EQ_SIZE_T(0, lept_get_object_size(&v));
+    lept_free(&v);
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v,
+        " { "
+        "\"n\" : null , "
+        "\"f\" : false , "
+        "\"t\" : true , "
+        "\"i\" : 123 , "
+        "\"s\" : \"abc\", "
+        "\"a\" : [ 1, 2, 3 ],"
+        "\"o\" : { \"1\" : 1, \"2\" : 2, \"3\" : 3 }"
+        " } "
+    ));
+    EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(&v));
+    EXPECT_EQ_SIZE_T(7, lept_get_object_size(&v));
+    EXPECT_EQ_STRING("n", lept_get_object_key(&v, 0), lept_get_object_key_length(&v, 0));
+    EXPECT_EQ_INT(LEPT_NULL,   lept_get_type(lept_get_object_value(&v, 0)));
+    EXPECT_EQ_STRING("f", lept_get_object_key(&v, 1), lept_get_object_key_length(&v, 1));
+    EXPECT_EQ_INT(LEPT_FALSE,  lept_get_type(lept_get_object_value(&v, 1)));
+    EXPECT_EQ_STRING("t", lept_get_object_key(&v, 2), lept_get_object_key_length(&v, 2));
+    EXPECT_EQ_INT(LEPT_TRUE,   lept_get_type(lept_get_object_value(&v, 2)));
+    EXPECT_EQ_STRING("i", lept_get_object_key(&v, 3), lept_get_object_key_length(&v, 3));
+    EXPECT_EQ_INT(LEPT_NUMBER, lept_get_type(lept_get_object_value(&v, 3)));
+    EXPECT_EQ_DOUBLE(123.0, lept_get_number(lept_get_object_value(&v, 3)));
+    EXPECT_EQ_STRING("s", lept_get_object_key(&v, 4), lept_get_object_key_length(&v, 4));
+    EXPECT_EQ_INT(LEPT_STRING, lept_get_type(lept_get_object_value(&v, 4)));
+    EXPECT_EQ_STRING("abc", lept_get_string(lept_get_object_value(&v, 4)), lept_get_string_length(lept_get_object_value(&v, 4)));
+    EXPECT_EQ_STRING("a", lept_get_object_key(&v, 5), lept_get_object_key_length(&v, 5));
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(lept_get_object_value(&v, 5)));
+    EXPECT_EQ_SIZE_T(3, lept_get_array_size(lept_get_object_value(&v, 5)));
+    for (i = 0; i < 3; i++) {
+        lept_value* e = lept_get_array_element(lept_get_object_value(&v, 5), i);
+        EXPECT_EQ_INT(LEPT_NUMBER, lept_get_type(e));
+        EXPECT_EQ_DOUBLE(i + 1.0, lept_get_number(e));
+    }
+    EXPECT_EQ_STRING("o", lept_get_object_key(&v, 6), lept_get_object_key_length(&v, 6));
+    {
+        lept_value* o = lept_get_object_value(&v, 6);
+        EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(o));
+        for (i = 0; i < 3; i++) {
+            lept_value* ov = lept_get_object_value(o, i);
+            EXPECT_TRUE('1' + i == lept_get_object_key(o, i)[0]);
+            EXPECT_EQ_SIZE_T(1, lept_get_object_key_length(o, i));
+            EXPECT_EQ_INT(LEPT_NUMBER, lept_get_type(ov));
+            EXPECT_EQ_DOUBLE(i + 1.0, lept_get_number(ov));
+        }
+    }
+    lept_free(&v);
+}
+
 #define TEST_ERROR(error, json)\
     do {\
         lept_value v;\
@@ -149,6 +351,10 @@ static void test_parse_invalid_value() {
     TEST_ERROR(LEPT_PARSE_INVALID_VALUE, "inf");
     TEST_ERROR(LEPT_PARSE_INVALID_VALUE, "NAN");
     TEST_ERROR(LEPT_PARSE_INVALID_VALUE, "nan");
+
+    /* invalid value in array */
+    TEST_ERROR(LEPT_PARSE_INVALID_VALUE, "[1,]");
+    TEST_ERROR(LEPT_PARSE_INVALID_VALUE, "[\"a\", nul]");
 }
 
 static void test_parse_root_not_singular() {
@@ -163,6 +369,8 @@ static void test_parse_root_not_singular() {
 static void test_parse_number_too_big() {
     TEST_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "1e309");
     TEST_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "-1e309");
+    TEST_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "1.7976931348623159e+308"); /* above the midpoint to 2^1024 */
+    TEST_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, "1e100000000000");
 }
 
 static void test_parse_missing_quotation_mark() {
@@ -203,6 +411,1137 @@ static void test_parse_invalid_unicode_surrogate() {
     TEST_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\\\\"");
     TEST_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uDBFF\"");
     TEST_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uD800\\uE000\"");
+    TEST_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uDC00\"");
+    TEST_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, "\"\\uDFFF\\uDC00\"");
+    TEST_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX, "\"\\uD800\\uDC0G\"");
+}
+
+/* the same outcome through parse, lazy, in-situ and a byte at a time, needs a parser p */
+#define TEST_PARSER_PATHS(error, json)\
+    do {\
+        lept_value v;\
+        char buf[128];\
+        size_t len = sizeof(json) - 1, i;\
+        int ret = LEPT_PARSE_OK;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(error, lept_parser_parse(p, &v, json, len));\
+        lept_free(&v);\
+        EXPECT_EQ_INT(error, lept_parser_parse_lazy(p, &v, json, len));\
+        lept_free(&v);\
+        memcpy(buf, json, len);\
+        EXPECT_EQ_INT(error, lept_parser_parse_insitu(p, &v, buf, len));\
+        lept_free(&v);\
+        for (i = 0; i < len && ret == LEPT_PARSE_OK; i++)\
+            ret = lept_parser_feed(p, json + i, 1);\
+        if (ret == LEPT_PARSE_OK)\
+            ret = lept_parser_finish(p, &v);\
+        EXPECT_EQ_INT(error, ret);\
+        lept_free(&v);\
+    } while(0)
+
+static void test_parse_invalid_utf8() {
+    lept_parser* p = lept_parser_create();
+    lept_value v;
+    lept_parser_set_strict_utf8(p, 1);
+    TEST_PARSER_PATHS(LEPT_PARSE_OK, "\"caf\xC3\xA9 \xE2\x82\xAC \xF0\x9D\x84\x9E \xEF\xBF\xBF \xF4\x8F\xBF\xBF\"");
+    TEST_PARSER_PATHS(LEPT_PARSE_OK, "{\"\xC3\xA9\":[\"a\\n\xC3\xA9\",\"\"]}");
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "\"\x80\"");
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "\"\xFF\"");
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "\"\xC0\xAF\"");         /* overlong */
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "\"\xE0\x9F\xBF\"");
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "\"\xF0\x8F\xBF\xBF\"");
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "\"\xED\xA0\x80\"");     /* surrogate */
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "\"\xF4\x90\x80\x80\""); /* beyond U+10FFFF */
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "\"\xE2\x82\"");         /* truncated */
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "\"\xC3\\n\"");
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "\"\xC3\xA9\xA9\"");
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "{\"\xC3\":1}");
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "[\"0123456789abcdef0123456789abcdef0123456789\xE2\x82\xACx\xE2\x82\"]");
+    TEST_PARSER_PATHS(LEPT_PARSE_INVALID_UTF8, "[\"0123456789abcdef0123456789abcde\xE2\"]");
+
+    /* not checked unless asked for */
+    lept_parser_set_strict_utf8(p, 0);
+    TEST_PARSER_PATHS(LEPT_PARSE_OK, "\"\xC0\xAF\"");
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "\"\xFF\""));
+    lept_free(&v);
+    lept_parser_destroy(p);
+}
+
+#define TEST_PARSE_N(error, type, json, len)\
+    do {\
+        lept_value v;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(error, lept_parse_n(&v, json, len));\
+        EXPECT_EQ_INT(type, lept_get_type(&v));\
+        lept_free(&v);\
+    } while(0)
+
+static void test_parse_too_deep() {
+    static const lept_handler h = { NULL };
+    lept_parser* p = lept_parser_create();
+    lept_value v;
+    size_t n = 100000, i;
+    char* json = (char*)malloc(2 * n);
+    char data[2 * 513 + 1];
+    for (i = 0; i < n; i++) {
+        json[i] = '[';
+        json[2 * n - 1 - i] = ']';
+    }
+
+    /* the default limit */
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_n(&v, json + n - 512, 2 * 512));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, lept_parse_n(&v, json + n - 513, 2 * 513));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, lept_parse_sax(json, 2 * n, &h, NULL));
+
+    /* without a limit nesting still takes no C stack */
+    lept_parser_set_max_depth(p, 0);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse_sax(p, json, 2 * n, &h, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_parser_parse_sax(p, json, 2 * n - 1, &h, NULL));
+    free(json);
+
+    lept_parser_set_max_depth(p, 2);
+    TEST_PARSER_PATHS(LEPT_PARSE_OK, "[[1],[],{\"a\":2}]");
+    TEST_PARSER_PATHS(LEPT_PARSE_OK, "{\"a\":{\"b\":1},\"c\":[1]}");
+    TEST_PARSER_PATHS(LEPT_PARSE_TOO_DEEP, "[[[]]]");
+    TEST_PARSER_PATHS(LEPT_PARSE_TOO_DEEP, "[1,[2,{}]]");
+    TEST_PARSER_PATHS(LEPT_PARSE_TOO_DEEP, "{\"a\":{\"b\":{}}}");
+    lept_parser_destroy(p);
+
+    for (i = 0; i < 513; i++) {
+        data[2 * i] = '\x06';   /* an array of one */
+        data[2 * i + 1] = '\x01';
+    }
+    data[2 * 513] = '\x81';
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode(&v, data + 2, sizeof(data) - 2));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_TOO_DEEP, lept_decode(&v, data, sizeof(data)));
+}
+
+#define TEST_INDEXED(json, len)\
+    do {\
+        lept_value v, e;\
+        char *a, *b;\
+        int error;\
+        lept_init(&v);\
+        lept_init(&e);\
+        error = lept_parse_n(&e, json, len);\
+        EXPECT_EQ_INT(error, lept_parse_indexed(&v, json, len));\
+        EXPECT_EQ_INT(lept_get_type(&e), lept_get_type(&v));\
+        if (error == LEPT_PARSE_OK) {\
+            EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&e, &a, NULL));\
+            EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&v, &b, NULL));\
+            EXPECT_TRUE(strcmp(a, b) == 0);\
+            free(a);\
+            free(b);\
+        }\
+        lept_free(&v);\
+        EXPECT_EQ_INT(error, lept_parser_parse_indexed(p, &v, json, len));\
+        lept_free(&v);\
+        lept_free(&e);\
+    } while(0)
+
+static void test_parse_indexed() {
+    static const char* docs[] = {
+        "null", " true ", "-1.5e3", "\"\"", "[]", "{}",
+        "[1, \"a\", {\"b\": [true, false, null]}, 2.5]",
+        "{\"es\\\"c\\\\\": \"\\u00e9\\n\\\\\", \"\\\\\\\"\": \"\\\\\"}",
+        " \n\t[ \"\xC3\xA9\" , { \"k\" : \"v\" } ]\r\n",
+        "[1,]", "{\"a\" 1}", "\"abc", "[\"\\x\"]", "[1] 2", "\"\xFF\"", "", "  "
+    };
+    lept_parser* p = lept_parser_create();
+    char json[512];
+    size_t i, j;
+    for (i = 0; i < sizeof(docs) / sizeof(docs[0]); i++)
+        TEST_INDEXED(docs[i], strlen(docs[i]));
+
+    /* strings, escapes and whitespace across the 64-byte blocks */
+    for (i = 1; i < 200; i++) {
+        json[0] = '[';
+        for (j = 1; j < i; j++)
+            json[j] = ' ';
+        json[i] = '"';
+        for (j = i + 1; j < i + 140; j++)
+            json[j] = (j % 7 == 0) ? '\\' : (j % 7 == 1 ? 'n' : 'a' + (char)(j % 26));
+        json[j] = '"';
+        json[j + 1] = ']';
+        TEST_INDEXED(json, j + 2);
+        TEST_INDEXED(json, j + 1);
+    }
+    for (i = 1; i < 130; i++) {
+        memset(json, '\\', i);
+        json[0] = '"';
+        json[i] = '"';
+        TEST_INDEXED(json, i + 1);
+    }
+    lept_parser_destroy(p);
+}
+
+static void test_parse_miss_comma_or_square_bracket() {
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1");
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1}");
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2");
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[[]");
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[\"a\", [\"b\"");
+}
+
+static void test_parse_miss_key() {
+    TEST_ERROR(LEPT_PARSE_MISS_KEY, "{:1,");
+    TEST_ERROR(LEPT_PARSE_MISS_KEY, "{1:1,");
+    TEST_ERROR(LEPT_PARSE_MISS_KEY, "{true:1,");
+    TEST_ERROR(LEPT_PARSE_MISS_KEY, "{false:1,");
+    TEST_ERROR(LEPT_PARSE_MISS_KEY, "{null:1,");
+    TEST_ERROR(LEPT_PARSE_MISS_KEY, "{[]:1,");
+    TEST_ERROR(LEPT_PARSE_MISS_KEY, "{{}:1,");
+    TEST_ERROR(LEPT_PARSE_MISS_KEY, "{\"a\":1,");
+}
+
+static void test_parse_miss_colon() {
+    TEST_ERROR(LEPT_PARSE_MISS_COLON, "{\"a\"}");
+    TEST_ERROR(LEPT_PARSE_MISS_COLON, "{\"a\",\"b\"}");
+}
+
+static void test_parse_miss_comma_or_curly_bracket() {
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1");
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1]");
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":1 \"b\"");
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":{}");
+    TEST_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":[\"b\"], \"c\":{\"d\":\"e\"}");
+}
+
+static void test_parse_whitespace() {
+    static const char ws[] = " \t\n\r";
+    char json[200];
+    size_t n, i, k;
+    lept_value v;
+    lept_init(&v);
+    for (n = 0; n < 80; n++) {
+        for (k = 0; k < 2; k++) {
+            /* pretty-printed indentation and mixed whitespace around a value */
+            for (i = 0; i < n; i++)
+                json[i] = json[n + 4 + i] = k ? ws[i % 4] : (i == 0 ? '\n' : ' ');
+            memcpy(json + n, "true", 4);
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_n(&v, json, 2 * n + 4));
+            EXPECT_EQ_INT(LEPT_TRUE, lept_get_type(&v));
+            json[2 * n + 4] = 'x';
+            EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_parse_n(&v, json, 2 * n + 5));
+            EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, lept_parse_n(&v, json, n));
+        }
+    }
+    lept_free(&v);
+}
+
+static void test_parse_n() {
+    lept_value v;
+
+    /* input beyond len must not be looked at */
+    TEST_PARSE_N(LEPT_PARSE_OK, LEPT_TRUE, "truex", 4);
+    TEST_PARSE_N(LEPT_PARSE_OK, LEPT_NULL, "null x", 4);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_VALUE, LEPT_NULL, "true", 3);
+    TEST_PARSE_N(LEPT_PARSE_EXPECT_VALUE, LEPT_NULL, "  true", 2);
+    TEST_PARSE_N(LEPT_PARSE_ROOT_NOT_SINGULAR, LEPT_NULL, "null x", 6);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_VALUE, LEPT_NULL, "1.5", 2);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_VALUE, LEPT_NULL, "1e10", 2);
+    TEST_PARSE_N(LEPT_PARSE_MISS_QUOTATION_MARK, LEPT_NULL, "\"abc\"", 4);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_STRING_ESCAPE, LEPT_NULL, "\"\\n\"", 2);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_UNICODE_HEX, LEPT_NULL, "\"\\u0024\"", 5);
+
+    /* embedded null characters are ordinary input */
+    TEST_PARSE_N(LEPT_PARSE_ROOT_NOT_SINGULAR, LEPT_NULL, "null\0", 5);
+    TEST_PARSE_N(LEPT_PARSE_INVALID_STRING_CHAR, LEPT_NULL, "\"a\0b\"", 5);
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_n(&v, "1234567", 3));
+    EXPECT_EQ_DOUBLE(123.0, lept_get_number(&v));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_n(&v, "\"Hello\"World", 7));
+    EXPECT_EQ_STRING("Hello", lept_get_string(&v), lept_get_string_length(&v));
+    lept_free(&v);
+}
+
+static void test_parse_arena() {
+    lept_arena* a = lept_arena_create(64);
+    lept_value v[4];
+    char big[300];
+    size_t i;
+
+    for (i = 0; i < 4; i++)
+        lept_init(&v[i]);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_arena(&v[0], "\"Hello\"", 7, a));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_arena(&v[1], "\"Hello\\nWorld\"", 14, a));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_arena(&v[2], "1.5", 3, a));
+    big[0] = '"';
+    memset(big + 1, 'a', sizeof(big) - 2);
+    big[sizeof(big) - 1] = '"';
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_arena(&v[3], big, sizeof(big), a));
+    EXPECT_EQ_STRING("Hello", lept_get_string(&v[0]), lept_get_string_length(&v[0]));
+    EXPECT_EQ_STRING("Hello\nWorld", lept_get_string(&v[1]), lept_get_string_length(&v[1]));
+    EXPECT_EQ_DOUBLE(1.5, lept_get_number(&v[2]));
+    EXPECT_EQ_SIZE_T(sizeof(big) - 2, lept_get_string_length(&v[3]));
+    EXPECT_TRUE(memcmp(big + 1, lept_get_string(&v[3]), sizeof(big) - 2) == 0);
+    EXPECT_EQ_INT('\0', lept_get_string(&v[3])[sizeof(big) - 2]);
+
+    /* a value set after parsing owns its payload again */
+    lept_set_string(&v[0], "World", 5);
+    EXPECT_EQ_STRING("World", lept_get_string(&v[0]), lept_get_string_length(&v[0]));
+
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_QUOTATION_MARK, lept_parse_arena(&v[1], "\"abc", 4, a));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v[1]));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, lept_parse_arena(&v[1], "{\"a\":[\"b\"]", 11, a));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_arena(&v[1], "{\"a\":[\"b\",{\"c\":1}]}", 19, a));
+    EXPECT_EQ_STRING("a", lept_get_object_key(&v[1], 0), lept_get_object_key_length(&v[1], 0));
+    EXPECT_EQ_SIZE_T(2, lept_get_array_size(lept_get_object_value(&v[1], 0)));
+
+    for (i = 0; i < 4; i++)
+        lept_free(&v[i]);
+    lept_arena_reset(a);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_arena(&v[0], "\"Hello\"", 7, a));
+    EXPECT_EQ_STRING("Hello", lept_get_string(&v[0]), lept_get_string_length(&v[0]));
+    lept_free(&v[0]);
+    lept_arena_destroy(a);
+}
+
+static void test_parse_parser() {
+    lept_parser* p = lept_parser_create();
+    lept_arena* a = lept_arena_create(0);
+    lept_value v;
+    char big[1000];
+    int i;
+
+    big[0] = '"';
+    memset(big + 1, 'a', sizeof(big) - 2);
+    big[sizeof(big) - 1] = '"';
+    lept_init(&v);
+    for (i = 0; i < 3; i++) {
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(p, &v, big, sizeof(big)));
+        EXPECT_EQ_SIZE_T(sizeof(big) - 2, lept_get_string_length(&v));
+        lept_free(&v);
+        EXPECT_EQ_INT(LEPT_PARSE_MISS_QUOTATION_MARK, lept_parser_parse(p, &v, big, sizeof(big) - 1));
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(p, &v, "\"Hello\"", 7));
+        EXPECT_EQ_STRING("Hello", lept_get_string(&v), lept_get_string_length(&v));
+        lept_free(&v);
+    }
+
+    lept_parser_set_arena(p, a);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(p, &v, "\"Hello\"", 7));
+    EXPECT_EQ_STRING("Hello", lept_get_string(&v), lept_get_string_length(&v));
+    lept_free(&v);
+    lept_parser_destroy(p);
+    lept_arena_destroy(a);
+}
+
+#define TEST_INSITU(expect, json)\
+    do {\
+        char buf[] = json;\
+        lept_value v;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_insitu(&v, buf, sizeof(buf) - 1));\
+        EXPECT_EQ_INT(LEPT_STRING, lept_get_type(&v));\
+        EXPECT_EQ_STRING(expect, lept_get_string(&v), lept_get_string_length(&v));\
+        EXPECT_EQ_INT('\0', lept_get_string(&v)[lept_get_string_length(&v)]);\
+        EXPECT_TRUE(lept_get_string(&v) == buf + 1);\
+        lept_free(&v);\
+    } while(0)
+
+static void test_parse_insitu() {
+    lept_parser* p = lept_parser_create();
+    char buf[] = " \"a\\tb\" ", err[] = "\"a\\qb\"", obj[] = "{\"k\\n\":[\"v\"]}";
+    lept_value v;
+
+    TEST_INSITU("", "\"\"");
+    TEST_INSITU("Hello", "\"Hello\"");
+    TEST_INSITU("Hello\nWorld", "\"Hello\\nWorld\"");
+    TEST_INSITU("\" \\ / \b \f \n \r \t", "\"\\\" \\\\ \\/ \\b \\f \\n \\r \\t\"");
+    TEST_INSITU("0123456789abcdef0123456789abcdef\n0123456789abcdef0123456789abcdef",
+        "\"0123456789abcdef0123456789abcdef\\n0123456789abcdef0123456789abcdef\"");
+    TEST_INSITU("\x24 \xC2\xA2 \xE2\x82\xAC \xF0\x9D\x84\x9E", "\"\\u0024 \\u00A2 \\u20AC \\uD834\\uDD1E\"");
+
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse_insitu(p, &v, buf, sizeof(buf) - 1));
+    EXPECT_EQ_STRING("a\tb", lept_get_string(&v), lept_get_string_length(&v));
+    EXPECT_TRUE(lept_get_string(&v) == buf + 2);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_ESCAPE, lept_parser_parse_insitu(p, &v, err, sizeof(err) - 1));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse_insitu(p, &v, "1.5", 3)); /* numbers are not written */
+    EXPECT_EQ_DOUBLE(1.5, lept_get_number(&v));
+    lept_free(&v);
+
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_insitu(&v, obj, sizeof(obj) - 1));
+    EXPECT_EQ_STRING("k\n", lept_get_object_key(&v, 0), lept_get_object_key_length(&v, 0));
+    EXPECT_TRUE(lept_get_object_key(&v, 0) == obj + 2);
+    EXPECT_TRUE(lept_get_string(lept_get_array_element(lept_get_object_value(&v, 0), 0)) == obj + 9);
+    lept_free(&v);
+    lept_parser_destroy(p);
+}
+
+/* feeding any chunking of a document must give what lept_parse() gives */
+static void test_parse_feed_chunks(lept_parser* p, const char* json) {
+    size_t len = strlen(json), chunk, i;
+    lept_value expect, v;
+    int ret;
+    lept_init(&expect);
+    lept_init(&v);
+    ret = lept_parse(&expect, json);
+    for (chunk = 1; chunk <= len + 1; chunk++) {
+        int feed = LEPT_PARSE_OK;
+        for (i = 0; i < len && feed == LEPT_PARSE_OK; i += chunk)
+            feed = lept_parser_feed(p, json + i, len - i < chunk ? len - i : chunk);
+        EXPECT_EQ_INT(ret, lept_parser_finish(p, &v));
+        EXPECT_TRUE(lept_is_equal(&expect, &v));
+        lept_free(&v);
+    }
+    lept_free(&expect);
+}
+
+static void test_parse_lazy() {
+    static const char* docs[] = {
+        "null", "-0", "123", "-1.5e-7", "9223372036854775807", "\"\"", "\"abc\"", "\"a\\nb\"",
+        "[1,\"0123456789abcdef0123456789abcdef\",[true,\"\"],{}]",
+        "{\"n\":null,\"i\":-42,\"d\":0.5,\"s\":\"\\\"quoted\\\"\",\"a\":[1e3,\"x\"],\"o\":{\"k\":\"v\"}}"
+    };
+    static const char* invalid[] = {
+        "", "-", "1.", "1e", "1e+", "+1", ".5", "01", "[1,]", "\"abc", "\"a\\x\"", "\"a\x01\"", "[\"a\"", "{\"a\":1e}"
+    };
+    lept_value v, e;
+    lept_parser* p = lept_parser_create();
+    char *json, *json2;
+    size_t i;
+    for (i = 0; i < sizeof(docs) / sizeof(docs[0]); i++) {
+        lept_init(&e);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&e, docs[i]));
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_lazy(&v, docs[i], strlen(docs[i])));
+        EXPECT_EQ_INT(lept_get_type(&e), lept_get_type(&v));
+        EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&v, &json, NULL));
+        EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&e, &json2, NULL));
+        EXPECT_TRUE(strcmp(json2, json) == 0);
+        free(json);
+        free(json2);
+        lept_free(&v);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse_lazy(p, &v, docs[i], strlen(docs[i])));
+        EXPECT_TRUE(lept_is_equal(&e, &v));
+        lept_free(&v);
+        lept_free(&e);
+    }
+    for (i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        lept_init(&e);
+        EXPECT_EQ_INT(lept_parse(&e, invalid[i]), lept_parse_lazy(&v, invalid[i], strlen(invalid[i])));
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    }
+    lept_parser_destroy(p);
+
+    /* values decode one at a time, each on its first access */
+    json = "[9223372036854775807,-1e309,\"abcdefghijklmnopqrstuvwxyz\",\"x\"]";
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_lazy(&v, json, strlen(json)));
+    EXPECT_TRUE(lept_is_int64(lept_get_array_element(&v, 0)));
+    EXPECT_EQ_INT64(INT64_MAX, lept_get_int64(lept_get_array_element(&v, 0)));
+    EXPECT_TRUE(lept_get_number(lept_get_array_element(&v, 1)) < -1e308);
+    EXPECT_EQ_STRING("abcdefghijklmnopqrstuvwxyz", lept_get_string(lept_get_array_element(&v, 2)), lept_get_string_length(lept_get_array_element(&v, 2)));
+    EXPECT_EQ_SIZE_T(1, lept_get_string_length(lept_get_array_element(&v, 3)));
+    EXPECT_EQ_STRING("x", lept_get_string(lept_get_array_element(&v, 3)), 1);
+    lept_free(&v);
+}
+
+static void test_parse_file_write(const char* path, const char* json) {
+    FILE* fp = fopen(path, "wb");
+    fwrite(json, 1, strlen(json), fp);
+    fclose(fp);
+}
+
+static void test_parse_file() {
+    static const char* path = "leptjson_test.json";
+    lept_value v, v2;
+
+    lept_init(&v2);
+    test_parse_file_write(path, " {\"a\":[1,2,\"abc\"],\"b\":{\"c\":null}} ");
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_file(&v, path));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, "{\"a\":[1,2,\"abc\"],\"b\":{\"c\":null}}"));
+    EXPECT_TRUE(lept_is_equal(&v, &v2));
+    lept_free(&v);
+    lept_free(&v2);
+
+    /* the mapping has no null terminator to rely on */
+    test_parse_file_write(path, "123");
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_file(&v, path));
+    EXPECT_EQ_DOUBLE(123.0, lept_get_number(&v));
+    lept_free(&v);
+    test_parse_file_write(path, "[1,2");
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_parse_file(&v, path));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    test_parse_file_write(path, "");
+    EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, lept_parse_file(&v, path));
+
+    remove(path);
+    EXPECT_EQ_INT(LEPT_PARSE_FILE_ERROR, lept_parse_file(&v, path));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+}
+
+static void test_parse_ndjson() {
+    char* json = (char*)malloc(400000);
+    size_t len = 0, line, i;
+    unsigned threads;
+    lept_value v, e;
+
+    /* enough lines for several threads, each line a different value */
+    for (i = 0; i < 20000; i++) {
+        if (i % 5 == 0)
+            len += sprintf(json + len, "{\"id\":%lu,\"tags\":[\"a\",\"b\"],\"ok\":true}\n", (unsigned long)i);
+        else if (i % 5 == 1)
+            len += sprintf(json + len, "  [%lu, null]\r\n", (unsigned long)i);
+        else if (i % 5 == 2)
+            len += sprintf(json + len, "\n");
+        else
+            len += sprintf(json + len, "%lu\n", (unsigned long)i);
+    }
+    for (threads = 0; threads <= 4; threads++) {
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ndjson(&v, json, len, threads, NULL));
+        EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(&v));
+        EXPECT_EQ_SIZE_T(16000, lept_get_array_size(&v));
+        for (i = 0; i < lept_get_array_size(&v); i += 997) {
+            size_t n = i / 4 * 5 + i % 4 + (i % 4 >= 2);
+            char doc[64];
+            lept_init(&e);
+            if (n % 5 == 0)
+                sprintf(doc, "{\"id\":%lu,\"tags\":[\"a\",\"b\"],\"ok\":true}", (unsigned long)n);
+            else if (n % 5 == 1)
+                sprintf(doc, "[%lu,null]", (unsigned long)n);
+            else
+                sprintf(doc, "%lu", (unsigned long)n);
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&e, doc));
+            EXPECT_TRUE(lept_is_equal(&e, lept_get_array_element(&v, i)));
+            lept_free(&e);
+        }
+        lept_free(&v);
+    }
+
+    /* the first failing line is reported wherever the threads split the input */
+    memcpy(json + len - 6, "1 2\n\n\n", 6);
+    for (i = len / 2; json[i - 1] != '\n' || memchr(json + i, '\n', 4); i++)
+        ;
+    memcpy(json + i, "[1,}", 4);
+    for (threads = 1; threads <= 4; threads++) {
+        size_t j;
+        line = 0;
+        EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parse_ndjson(&v, json, len, threads, &line));
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+        for (j = 0; j != i; j++)
+            line -= json[j] == '\n';
+        EXPECT_EQ_SIZE_T(0, line);
+    }
+    line = 0;
+    while (json[i++] != '\n')
+        ;
+    EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_parse_ndjson(&v, json + i, len - i, 4, &line));
+    for (; i != len - 6; i++)
+        line -= json[i] == '\n';
+    EXPECT_EQ_SIZE_T(0, line);
+
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ndjson(&v, "1\n\n2", 4, 2, NULL));
+    EXPECT_EQ_SIZE_T(2, lept_get_array_size(&v));
+    EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_get_array_element(&v, 1)));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ndjson(&v, " \n\r\n", 4, 2, NULL));
+    EXPECT_EQ_SIZE_T(0, lept_get_array_size(&v));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ndjson(&v, NULL, 0, 2, NULL));
+    EXPECT_EQ_SIZE_T(0, lept_get_array_size(&v));
+    lept_free(&v);
+    free(json);
+}
+
+static void test_parse_parallel() {
+    char* json = (char*)malloc(600000);
+    char *a, *b;
+    size_t len = 1, i;
+    unsigned threads;
+    int error;
+    lept_value v, e;
+
+    /* strings that look like element boundaries wherever the threads split the input */
+    json[0] = '[';
+    for (i = 0; i < 8000; i++) {
+        if (i % 4 == 0)
+            len += sprintf(json + len, "{\"id\":%lu,\"s\":\"],[\\\"{\\\\\",\"n\":[[1],{}]},", (unsigned long)i);
+        else if (i % 4 == 1)
+            len += sprintf(json + len, " \"x,\\\\\"\n,");
+        else if (i % 4 == 2)
+            len += sprintf(json + len, "[%lu,\"]\",[\"[\"]] ,", (unsigned long)i);
+        else
+            len += sprintf(json + len, "\t%lu,", (unsigned long)i);
+    }
+    json[len - 1] = ']';
+    lept_init(&e);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_n(&e, json, len));
+    EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&e, &a, NULL));
+    for (threads = 0; threads <= 5; threads++) {
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_parallel(&v, json, len, threads));
+        EXPECT_EQ_SIZE_T(8000, lept_get_array_size(&v));
+        EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&v, &b, NULL));
+        EXPECT_TRUE(strcmp(a, b) == 0);
+        free(b);
+        lept_free(&v);
+    }
+    free(a);
+    lept_free(&e);
+
+    /* the error is the one of a single thread */
+    for (i = len / 3; json[i] != ','; i++)
+        ;
+    json[i] = ':';
+    error = lept_parse_n(&e, json, len);
+    EXPECT_TRUE(error != LEPT_PARSE_OK);
+    for (threads = 1; threads <= 5; threads++) {
+        EXPECT_EQ_INT(error, lept_parse_parallel(&v, json, len, threads));
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    }
+    json[i] = ',';
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_parse_parallel(&v, json, len - 1, 4));
+    json[len] = ']';
+    EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_parse_parallel(&v, json, len + 1, 4));
+
+    /* anything else in one piece */
+    memset(json, ' ', 300000);
+    memcpy(json + 100000, "[ ]", 3);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_parallel(&v, json, 300000, 4));
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(&v));
+    EXPECT_EQ_SIZE_T(0, lept_get_array_size(&v));
+    lept_free(&v);
+    memcpy(json + 100000, "{ }", 3);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_parallel(&v, json, 300000, 4));
+    EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(&v));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_parallel(&v, "[1,2]", 5, 4));
+    EXPECT_EQ_SIZE_T(2, lept_get_array_size(&v));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, lept_parse_parallel(&v, NULL, 0, 4));
+    free(json);
+}
+
+static void test_parse_feed() {
+    static const char* const json[] = {
+        "null", " true ", "false", "nul", "truex", "null x", "?", "",  " ",
+        "0", "-0", "1.5", "-1E-10", "1.234E+10", "9223372036854775807", "1e309", "+1", "1.", "0123", "0x0", "1-2",
+        "\"\"", "\"Hello\\nWorld\"", " \"\\\" \\\\ \\/ \\b \\f \\n \\r \\t\" ",
+        "\"", "\"abc", "\"\\", "\"\\v\"", "\"\x01\"", "\"\\u01\"", "\"\\u012",
+        "\"\\u0024\\u00a2\\u20AC\"", "\"\\uD834\\uDD1E\"", "\"\\uD800\"", "\"\\uD800\\", "\"\\uD800\\u",
+        "\"\\uD800\\uE000\"", "\"\\uDC00\"", "\"\\uD800\\uDC0",
+        "\"0123456789abcdef0123456789abcdef0123456789\\t0123456789abcdef0123456789abcdef\"  ",
+        "[]", " [ ] ", "[1,2.5,\"a\",true,null]", "[[[]],[0]]", "{}", " { } ", "{\"a\":1}",
+        "{\"a\":[1,{\"b\":\"c\"}],\"d\":{}}", " [ { \"a\" : [ ] , \"b\" : null } , -1e2 ] ",
+        "[", "[1", "[1,", "[1,]", "[1 2]", "[1}", "[12-3]", "[tru]", "{", "{1:1}", "{\"a\"", "{\"a\"}",
+        "{\"a\":", "{\"a\":1", "{\"a\":1,", "{\"a\":1]", "{\"a\":1 2}", "{\"a\":12-3}", "[] x", "{}{}"
+    };
+    lept_parser* p = lept_parser_create();
+    lept_value v;
+    size_t i;
+    for (i = 0; i < sizeof(json) / sizeof(json[0]); i++)
+        test_parse_feed_chunks(p, json[i]);
+
+    /* errors are latched until finish, after which the parser starts over */
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_feed(p, "nu", 2));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parser_feed(p, "x", 1));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parser_feed(p, "ll", 2));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parser_finish(p, &v));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_feed(p, "\"He", 3));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_feed(p, "llo\"", 4));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_finish(p, &v));
+    EXPECT_EQ_STRING("Hello", lept_get_string(&v), lept_get_string_length(&v));
+    lept_free(&v);
+
+    /* an unfinished stream is dropped by a one-shot parse */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_feed(p, "\"abc", 4));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(p, &v, "1", 1));
+    EXPECT_EQ_DOUBLE(1.0, lept_get_number(&v));
+    EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, lept_parser_finish(p, &v));
+    lept_free(&v);
+    lept_parser_destroy(p);
+}
+
+/* checks the tape at i against the DOM of the same document, returns the index after it */
+static size_t test_tape_value(const lept_tape* t, size_t i, const lept_value* v) {
+    size_t j, k;
+    EXPECT_EQ_INT(lept_get_type(v), lept_tape_get_type(t, i));
+    if (lept_get_type(v) != lept_tape_get_type(t, i))
+        return lept_tape_next(t, i);
+    switch (lept_get_type(v)) {
+        case LEPT_NUMBER:
+            EXPECT_EQ_INT(lept_is_int64(v), lept_tape_is_int64(t, i));
+            EXPECT_EQ_DOUBLE(lept_get_number(v), lept_tape_get_number(t, i));
+            break;
+        case LEPT_STRING:
+            EXPECT_EQ_SIZE_T(lept_get_string_length(v), lept_tape_get_string_length(t, i));
+            EXPECT_TRUE(memcmp(lept_get_string(v), lept_tape_get_string(t, i), lept_get_string_length(v)) == 0);
+            break;
+        case LEPT_ARRAY:
+            EXPECT_EQ_SIZE_T(lept_get_array_size(v), lept_tape_get_size(t, i));
+            for (j = lept_tape_first(t, i), k = 0; k < lept_get_array_size(v); k++)
+                j = test_tape_value(t, j, lept_get_array_element(v, k));
+            EXPECT_EQ_SIZE_T(lept_tape_next(t, i), j);
+            break;
+        case LEPT_OBJECT:
+            EXPECT_EQ_SIZE_T(lept_get_object_size(v), lept_tape_get_size(t, i));
+            for (j = lept_tape_first(t, i), k = 0; k < lept_get_object_size(v); k++) {
+                EXPECT_EQ_SIZE_T(lept_get_object_key_length(v, k), lept_tape_get_string_length(t, j));
+                EXPECT_TRUE(memcmp(lept_get_object_key(v, k), lept_tape_get_string(t, j), lept_get_object_key_length(v, k)) == 0);
+                j = test_tape_value(t, lept_tape_next(t, j), lept_get_object_value(v, k));
+            }
+            EXPECT_EQ_SIZE_T(lept_tape_next(t, i), j);
+            break;
+        default:
+            break;
+    }
+    return lept_tape_next(t, i);
+}
+
+static void test_parse_tape() {
+    static const char* const json[] = {
+        "null", "true", "false", "0", "-0", "1.5", "-9223372036854775808", "1e300", "\"\"", "\"Hello\\nWorld\"",
+        "[]", "{}", "[null,false,true,123,\"abc\"]", "[[],[0],[0,1],[0,1,2]]",
+        "{\"n\":null,\"a\":[1,2,{\"x\":\"y\"}],\"o\":{\"1\":1,\"2\":[]},\"s\":\"abc\"}"
+    };
+    lept_tape* t = lept_tape_create();
+    lept_value v;
+    size_t i, j;
+
+    for (i = 0; i < sizeof(json) / sizeof(json[0]); i++) {
+        lept_init(&v);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json[i]));
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_tape_parse(t, json[i], strlen(json[i])));
+        test_tape_value(t, 0, &v);
+        lept_free(&v);
+    }
+
+    /* a container is stepped over in one go */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_tape_parse(t, "[[1,[2,3],{\"a\":[]}],4,true]", 27));
+    EXPECT_EQ_SIZE_T(3, lept_tape_get_size(t, 0));
+    i = lept_tape_next(t, lept_tape_first(t, 0));
+    EXPECT_EQ_INT(LEPT_NUMBER, lept_tape_get_type(t, i));
+    EXPECT_TRUE(lept_tape_is_int64(t, i));
+    EXPECT_EQ_INT64(4, lept_tape_get_int64(t, i));
+    j = lept_tape_next(t, i);
+    EXPECT_TRUE(lept_tape_get_boolean(t, j));
+    EXPECT_EQ_SIZE_T(lept_tape_next(t, 0), lept_tape_next(t, j));
+
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_tape_parse(t, "[\"a\",[\"b\"", 9));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_tape_parse(t, "\"abc\"", 5));
+    EXPECT_EQ_STRING("abc", lept_tape_get_string(t, 0), lept_tape_get_string_length(t, 0));
+    EXPECT_EQ_INT('\0', lept_tape_get_string(t, 0)[3]);
+    lept_tape_destroy(t);
+}
+
+typedef struct {
+    char log[256];
+    size_t len;
+    int events, stop;   /* the event to abort at, counted from 1, or 0 */
+}test_sax_log;
+
+static int test_sax_put(void* ctx, const char* s) {
+    test_sax_log* t = (test_sax_log*)ctx;
+    size_t len = strlen(s);
+    memcpy(t->log + t->len, s, len + 1);
+    t->len += len;
+    return ++t->events == t->stop;
+}
+
+static int test_sax_null(void* ctx) { return test_sax_put(ctx, "n "); }
+static int test_sax_boolean(void* ctx, int b) { return test_sax_put(ctx, b ? "t " : "f "); }
+static int test_sax_start_array(void* ctx) { return test_sax_put(ctx, "[ "); }
+static int test_sax_start_object(void* ctx) { return test_sax_put(ctx, "{ "); }
+
+static int test_sax_number(void* ctx, double n) {
+    char s[32];
+    sprintf(s, "%g ", n);
+    return test_sax_put(ctx, s);
+}
+
+static int test_sax_int64(void* ctx, int64_t i) {
+    char s[32];
+    sprintf(s, "%ldL ", (long)i);
+    return test_sax_put(ctx, s);
+}
+
+static int test_sax_string(void* ctx, const char* str, size_t len) {
+    char s[64];
+    sprintf(s, "\"%.*s\" ", (int)len, str);
+    return test_sax_put(ctx, s);
+}
+
+static int test_sax_key(void* ctx, const char* str, size_t len) {
+    char s[64];
+    sprintf(s, "%.*s: ", (int)len, str);
+    return test_sax_put(ctx, s);
+}
+
+static int test_sax_end_array(void* ctx, size_t size) {
+    char s[32];
+    sprintf(s, "]%lu ", (unsigned long)size);
+    return test_sax_put(ctx, s);
+}
+
+static int test_sax_end_object(void* ctx, size_t size) {
+    char s[32];
+    sprintf(s, "}%lu ", (unsigned long)size);
+    return test_sax_put(ctx, s);
+}
+
+#define TEST_SAX(error, expect, json, abort_at)\
+    do {\
+        test_sax_log t;\
+        t.len = 0;\
+        t.log[0] = '\0';\
+        t.events = 0;\
+        t.stop = abort_at;\
+        EXPECT_EQ_INT(error, lept_parse_sax(json, strlen(json), &h, &t));\
+        EXPECT_EQ_STRING(expect, t.log, t.len);\
+    } while(0)
+
+static void test_parse_sax() {
+    lept_handler h = {
+        test_sax_null, test_sax_boolean, test_sax_number, test_sax_int64, test_sax_string,
+        test_sax_start_array, test_sax_end_array, test_sax_start_object, test_sax_key, test_sax_end_object
+    };
+    static const lept_handler none = { NULL };
+    lept_parser* p;
+    test_sax_log t;
+
+    TEST_SAX(LEPT_PARSE_OK, "n ", " null ", 0);
+    TEST_SAX(LEPT_PARSE_OK, "1L ", "1", 0);
+    TEST_SAX(LEPT_PARSE_OK, "-2.5 ", "-2.5", 0);
+    TEST_SAX(LEPT_PARSE_OK, "\"a\nb\" ", "\"a\\nb\"", 0);
+    TEST_SAX(LEPT_PARSE_OK, "{ a: [ 1L -2.5 \"x\" t f n ]6 b: { }0 }2 ",
+        "{\"a\":[1,-2.5,\"x\",true,false,null],\"b\":{}}", 0);
+    TEST_SAX(LEPT_PARSE_OK, "[ [ ]0 [ ]0 ]2 ", "[[],[]]", 0);
+
+    /* events up to the error are still reported */
+    TEST_SAX(LEPT_PARSE_EXPECT_VALUE, "[ 1L ", "[1,", 0);
+    TEST_SAX(LEPT_PARSE_MISS_COLON, "{ a: ", "{\"a\" 1}", 0);
+    TEST_SAX(LEPT_PARSE_ROOT_NOT_SINGULAR, "n ", "null x", 0);
+
+    /* a non-zero return stops the parse */
+    TEST_SAX(LEPT_PARSE_ABORTED, "[ 1L 2L ", "[1,2,3]", 3);
+    TEST_SAX(LEPT_PARSE_ABORTED, "{ a: ", "{\"a\":1}", 2);
+
+    /* integers go to on_number without on_int64 */
+    h.on_int64 = NULL;
+    TEST_SAX(LEPT_PARSE_OK, "[ 1 -2.5 ]2 ", "[1,-2.5]", 0);
+
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_sax("{\"a\":[1,\"b\"]}", 13, &none, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_KEY, lept_parse_sax("{1}", 3, &none, NULL));
+
+    p = lept_parser_create();
+    t.len = 0;
+    t.events = t.stop = 0;
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse_sax(p, "[\"abc\",{}]", 10, &h, &t));
+    EXPECT_EQ_STRING("[ \"abc\" { }0 ]2 ", t.log, t.len);
+    lept_parser_destroy(p);
+}
+
+/* runs the paths against json, expect[i] is the JSON of the value found or NULL if none is */
+static void test_parse_query_paths(const char* json, const char* const* paths, const char* const* expect, size_t count) {
+    lept_query* q = lept_query_create(paths, count);
+    lept_parser* p = lept_parser_create();
+    lept_value values[16], e;
+    int found[16], pass;
+    size_t i;
+    EXPECT_TRUE(q != NULL);
+    EXPECT_EQ_SIZE_T(count, lept_query_get_size(q));
+    for (pass = 0; pass < 2; pass++) {
+        if (pass == 0)
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_query_run(q, json, strlen(json), values, found));
+        else
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_query(p, q, json, strlen(json), values, found));
+        for (i = 0; i < count; i++) {
+            EXPECT_EQ_INT(expect[i] != NULL, found[i]);
+            if (expect[i]) {
+                lept_init(&e);
+                EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&e, expect[i]));
+                EXPECT_TRUE(lept_is_equal(&e, &values[i]));
+                lept_free(&e);
+            }
+            else
+                EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&values[i]));
+            lept_free(&values[i]);
+        }
+    }
+    lept_parser_destroy(p);
+    lept_query_destroy(q);
+}
+
+#define TEST_QUERY_ERROR(error, json, path)\
+    do {\
+        const char* paths[1];\
+        lept_query* q;\
+        lept_value v;\
+        int found;\
+        paths[0] = path;\
+        q = lept_query_create(paths, 1);\
+        EXPECT_EQ_INT(error, lept_query_run(q, json, strlen(json), &v, &found));\
+        EXPECT_EQ_INT(0, found);\
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+        lept_query_destroy(q);\
+    } while(0)
+
+static void test_parse_query() {
+    static const char* json =
+        " {\"user\":{\"name\":\"x\\\"}]\",\"id\":42},\"event\":{\"tags\":[\"a\",{\"b\":[1,2]}],\"ts\":\"2020\"},"
+        "\"a/b\":1,\"m~n\":2,\"\":3,\"arr\":[10,20,30],\"\\u00e9\":[]} ";
+    const char* paths[] = {
+        "/user/id", "/event/ts", "/event/tags/1/b/1", "/a~1b", "/m~0n", "/", "/arr/2", "/arr/3",
+        "/missing", "/user", "/user/id", "/arr/02", "/arr/-", "/\xC3\xA9", "/event/tags/0/x", ""
+    };
+    const char* expect[16];
+    static const char* bad[] = { "a", "/~2", "/a~", "/a/~x" };
+    lept_value v[2];
+    int found[2];
+    lept_query* q;
+    size_t i;
+
+    expect[0] = "42";
+    expect[1] = "\"2020\"";
+    expect[2] = "2";
+    expect[3] = "1";
+    expect[4] = "2";
+    expect[5] = "3";
+    expect[6] = "30";
+    expect[7] = expect[8] = NULL;
+    expect[9] = "{\"name\":\"x\\\"}]\",\"id\":42}";
+    expect[10] = "42";
+    expect[11] = expect[12] = NULL;
+    expect[13] = "[]";
+    expect[14] = NULL;
+    expect[15] = json;
+    test_parse_query_paths(json, paths, expect, 16);
+    test_parse_query_paths("[[1,[2,3]],4]", paths, expect, 0);
+
+    /* the first of duplicate keys, a later one is skipped */
+    paths[14] = "/a/b";
+    expect[14] = "1";
+    test_parse_query_paths("{\"a\":{\"b\":1},\"a\":{\"b\":2}}", paths + 14, expect + 14, 1);
+    paths[14] = "/event/tags/0/x";
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+        EXPECT_TRUE(lept_query_create(bad + i, 1) == NULL);
+
+    /* skipped strings may hold brackets and escaped quotes */
+    paths[0] = "/a";
+    expect[0] = "5";
+    expect[8] = "1";
+    test_parse_query_paths("{\"s\":\"]}\\\"[{\\\\\",\"t\":[[\"]\"],{}],\"u\":-1e5,\"v\":true,\"a\":5}", paths, expect, 1);
+
+    /* the input is read until every path is found, everything before is checked where walked */
+    test_parse_query_paths("{\"a\":1} x", paths, expect + 8, 1);
+    TEST_QUERY_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "{\"a\":1} x", "/b");
+    TEST_QUERY_ERROR(LEPT_PARSE_EXPECT_VALUE, "{\"a\":", "/a");
+    TEST_QUERY_ERROR(LEPT_PARSE_INVALID_VALUE, "{\"a\":tru}", "/a");
+    TEST_QUERY_ERROR(LEPT_PARSE_INVALID_VALUE, "{\"b\":nul,\"a\":1}", "/a");
+    TEST_QUERY_ERROR(LEPT_PARSE_MISS_COLON, "{\"b\" 1}", "/a");
+    TEST_QUERY_ERROR(LEPT_PARSE_MISS_KEY, "{1:1}", "/a");
+    TEST_QUERY_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"b\":1 \"a\":1}", "/a");
+    TEST_QUERY_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "[1 2]", "/1");
+    TEST_QUERY_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "{\"b\":[[1,\"]\"]", "/a");
+    /* the brackets of a skipped value that do not match show up later */
+    TEST_QUERY_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"b\":[[1,\"]\"],\"a\":1}", "/a");
+    TEST_QUERY_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, "{\"b\":\"abc", "/a");
+    TEST_QUERY_ERROR(LEPT_PARSE_INVALID_STRING_CHAR, "{\"b\":[\"\x01\"],\"a\":1}", "/a");
+    TEST_QUERY_ERROR(LEPT_PARSE_EXPECT_VALUE, "", "");
+
+    /* values found before an error are released */
+    paths[0] = "/a";
+    paths[1] = "/b";
+    q = lept_query_create(paths, 2);
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, lept_query_run(q, "{\"a\":[\"x\"] \"b\":1}", 18, v, found));
+    EXPECT_EQ_INT(0, found[0]);
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v[0]));
+    lept_query_destroy(q);
+}
+
+typedef struct {
+    double ts;
+    char* kind;
+}test_event;
+
+typedef struct {
+    double id;
+    char* name;
+    int admin;
+    test_event event;
+    lept_value tags, extra, any;
+}test_message;
+
+static const lept_field test_event_fields[] = {
+    { "ts", offsetof(test_event, ts), LEPT_NUMBER, NULL },
+    { "kind", offsetof(test_event, kind), LEPT_STRING, NULL },
+    { NULL, 0, LEPT_NULL, NULL }
+};
+
+static const lept_field test_message_fields[] = {
+    { "id", offsetof(test_message, id), LEPT_NUMBER, NULL },
+    { "name", offsetof(test_message, name), LEPT_STRING, NULL },
+    { "admin", offsetof(test_message, admin), LEPT_TRUE, NULL },
+    { "event", offsetof(test_message, event), LEPT_OBJECT, test_event_fields },
+    { "tags", offsetof(test_message, tags), LEPT_ARRAY, NULL },
+    { "extra", offsetof(test_message, extra), LEPT_OBJECT, NULL },
+    { "any", offsetof(test_message, any), LEPT_NULL, NULL },
+    { NULL, 0, LEPT_NULL, NULL }
+};
+
+static void test_message_init(test_message* m) {
+    memset(m, 0, sizeof(*m));
+    m->id = -1.0;
+    m->admin = -1;
+    lept_init(&m->tags);
+    lept_init(&m->extra);
+    lept_init(&m->any);
+}
+
+#define TEST_SCHEMA_ERROR(error, field, json)\
+    do {\
+        test_message m;\
+        const lept_field* f = test_message_fields;\
+        test_message_init(&m);\
+        EXPECT_EQ_INT(error, lept_schema_parse(s, &m, json, strlen(json), &f));\
+        EXPECT_TRUE(f == (field));\
+        EXPECT_TRUE(m.name == NULL && m.event.kind == NULL);\
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&m.tags));\
+    } while(0)
+
+static void test_parse_schema() {
+    static const char* json =
+        " { \"skip\" : [ \"}\" , { \"id\" : 7 } ] , \"id\" : 9007199254740993, \"name\" : \"x\\ny\","
+        " \"event\" : { \"kind\" : \"\\u00e9\", \"more\" : null, \"ts\" : 1.5e3 } , \"admin\" : false ,"
+        " \"tags\" : [ 1 , \"a\" ] , \"extra\" : { \"k\" : [ ] } , \"any\" : -0 , \"name\" : \"dup\" } ";
+    lept_schema* s = lept_schema_create(test_message_fields);
+    lept_parser* p = lept_parser_create();
+    lept_arena* a = lept_arena_create(0);
+    const lept_field* f = test_message_fields;
+    test_message m;
+    lept_value e;
+    int pass;
+
+    for (pass = 0; pass < 3; pass++) {
+        test_message_init(&m);
+        if (pass == 0)
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_schema_parse(s, &m, json, strlen(json), &f));
+        else {
+            lept_parser_set_arena(p, pass == 2 ? a : NULL);
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse_schema(p, s, &m, json, strlen(json), &f));
+        }
+        EXPECT_TRUE(f == NULL);
+        EXPECT_EQ_DOUBLE(9007199254740992.0, m.id);
+        EXPECT_EQ_STRING("x\ny", m.name, strlen(m.name));   /* the first of duplicate keys */
+        EXPECT_EQ_INT(0, m.admin);
+        EXPECT_EQ_DOUBLE(1500.0, m.event.ts);
+        EXPECT_EQ_STRING("\xC3\xA9", m.event.kind, strlen(m.event.kind));
+        lept_init(&e);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&e, "[1,\"a\"]"));
+        EXPECT_TRUE(lept_is_equal(&e, &m.tags));
+        lept_free(&e);
+        EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(&m.extra));
+        EXPECT_EQ_SIZE_T(1, lept_get_object_size(&m.extra));
+        EXPECT_EQ_INT(LEPT_NUMBER, lept_get_type(&m.any));
+        if (pass != 2) {
+            lept_schema_free(s, &m);
+            EXPECT_TRUE(m.name == NULL && m.event.kind == NULL);
+            EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&m.tags));
+        }
+    }
+    lept_parser_destroy(p);
+    lept_arena_destroy(a);
+
+    /* absent members keep their defaults */
+    test_message_init(&m);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_schema_parse(s, &m, "{\"admin\":true,\"event\":{}}", 25, NULL));
+    EXPECT_EQ_DOUBLE(-1.0, m.id);
+    EXPECT_EQ_INT(1, m.admin);
+    EXPECT_TRUE(m.name == NULL);
+    lept_schema_free(s, &m);
+
+    TEST_SCHEMA_ERROR(LEPT_PARSE_TYPE_MISMATCH, &test_message_fields[0], "{\"id\":\"7\"}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_TYPE_MISMATCH, &test_message_fields[1], "{\"name\":null}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_TYPE_MISMATCH, &test_message_fields[2], "{\"admin\":0}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_TYPE_MISMATCH, &test_message_fields[4], "{\"name\":\"a\",\"tags\":{}}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_TYPE_MISMATCH, &test_message_fields[5], "{\"extra\":[]}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_TYPE_MISMATCH, &test_event_fields[0], "{\"event\":{\"kind\":\"k\",\"ts\":true}}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_TYPE_MISMATCH, &test_message_fields[3], "{\"event\":1}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_TYPE_MISMATCH, NULL, "[]");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_INVALID_VALUE, NULL, "{\"id\":nul}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_INVALID_VALUE, NULL, "{\"admin\":tru}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_INVALID_VALUE, NULL, "?");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_EXPECT_VALUE, NULL, " ");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_NUMBER_TOO_BIG, NULL, "{\"id\":1e309}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, NULL, "{\"name\":\"a\",\"tags\":[1] \"id\":1}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, NULL, "{\"name\":\"a\",\"tags\":[1}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_MISS_COLON, NULL, "{\"event\":{\"kind\":\"k\",\"ts\" 1}}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_MISS_KEY, NULL, "{\"name\":\"a\",}");
+    /* values built into the failing one are freed, these strings are long enough to be allocated */
+    TEST_SCHEMA_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, NULL,
+        "{\"tags\":[\"a long string over fourteen bytes\",\"another long string here\" x");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_INVALID_VALUE, NULL,
+        "{\"tags\":[[\"a long string over fourteen bytes\"],{\"k\":\"another long string here\"},tru]}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, NULL,
+        "{\"extra\":{\"k\":[\"a long string over fourteen bytes\"],\"s\":\"unterminated");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_INVALID_VALUE, NULL,
+        "{\"any\":{\"k\":\"a long string over fourteen bytes\",\"n\":nul}}");
+    TEST_SCHEMA_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, NULL, "{\"name\":\"a\"} {}");
+    lept_schema_destroy(s);
+}
+
+static void test_stats_handler(void* ctx, const lept_stats* s) {
+    lept_stats* last = (lept_stats*)ctx;
+    *last = *s;
+    last->timed++;  /* counts the calls, whether timed or not */
+}
+
+static void test_parse_stats() {
+    const char* json = "{\"a\":[1,true,null,\"x\\n\"],\"b\":{\"c\":false}} ";
+    const char* paths[1];
+    lept_stats last;
+    lept_value v, w;
+    lept_query* q;
+    int found;
+    last.timed = 0;
+    lept_set_stats_handler(test_stats_handler, &last);
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+    lept_free(&v);
+#ifdef LEPT_STATS
+    EXPECT_TRUE(last.timed);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, last.error);
+    EXPECT_EQ_SIZE_T(strlen(json), last.bytes);
+    EXPECT_EQ_SIZE_T(2, last.values[LEPT_OBJECT]);
+    EXPECT_EQ_SIZE_T(1, last.values[LEPT_ARRAY]);
+    EXPECT_EQ_SIZE_T(1, last.values[LEPT_STRING]);  /* keys are no values */
+    EXPECT_EQ_SIZE_T(1, last.values[LEPT_NUMBER]);
+    EXPECT_EQ_SIZE_T(1, last.values[LEPT_TRUE]);
+    EXPECT_EQ_SIZE_T(1, last.values[LEPT_FALSE]);
+    EXPECT_EQ_SIZE_T(1, last.values[LEPT_NULL]);
+    EXPECT_EQ_SIZE_T(1, last.escapes);
+    EXPECT_TRUE(last.stack_size > 0);
+
+    last.timed = 0;
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parse(&v, "[1,x]"));
+    EXPECT_TRUE(last.timed);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, last.error);
+    EXPECT_EQ_SIZE_T(1, last.values[LEPT_NUMBER]);
+    EXPECT_TRUE(last.bytes <= 5);
+
+    last.timed = 0;
+    paths[0] = "/b/c";
+    q = lept_query_create(paths, 1);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_query_run(q, json, strlen(json), &w, &found));
+    EXPECT_TRUE(found);
+    EXPECT_TRUE(last.timed);
+    EXPECT_EQ_SIZE_T(1, last.values[LEPT_FALSE]);
+    lept_free(&w);
+    lept_query_destroy(q);
+#else
+    (void)paths; (void)w; (void)q; (void)found;
+    EXPECT_FALSE(last.timed);  /* nothing is counted without LEPT_STATS */
+#endif
+    lept_set_stats_handler(NULL, NULL);
+    lept_free(&v);
 }
 
 static void test_parse() {
@@ -210,7 +1549,12 @@ static void test_parse() {
     test_parse_true();
     test_parse_false();
     test_parse_number();
+    test_parse_number_locale();
+    test_parse_int64();
     test_parse_string();
+    test_parse_string_long();
+    test_parse_array();
+    test_parse_object();
     test_parse_expect_value();
     test_parse_invalid_value();
     test_parse_root_not_singular();
@@ -220,6 +1564,28 @@ static void test_parse() {
     test_parse_invalid_string_char();
     test_parse_invalid_unicode_hex();
     test_parse_invalid_unicode_surrogate();
+    test_parse_invalid_utf8();
+    test_parse_too_deep();
+    test_parse_indexed();
+    test_parse_miss_comma_or_square_bracket();
+    test_parse_miss_key();
+    test_parse_miss_colon();
+    test_parse_miss_comma_or_curly_bracket();
+    test_parse_whitespace();
+    test_parse_n();
+    test_parse_arena();
+    test_parse_parser();
+    test_parse_insitu();
+    test_parse_lazy();
+    test_parse_file();
+    test_parse_ndjson();
+    test_parse_parallel();
+    test_parse_feed();
+    test_parse_sax();
+    test_parse_query();
+    test_parse_schema();
+    test_parse_tape();
+    test_parse_stats();
 }
 
 static void test_access_null() {
@@ -251,6 +1617,19 @@ static void test_access_number() {
     lept_free(&v);
 }
 
+static void test_access_int64() {
+    lept_value v;
+    lept_init(&v);
+    lept_set_string(&v, "a", 1);
+    lept_set_int64(&v, INT64_MAX);
+    EXPECT_TRUE(lept_is_int64(&v));
+    EXPECT_EQ_INT64(INT64_MAX, lept_get_int64(&v));
+    lept_set_number(&v, 1234.5);
+    EXPECT_FALSE(lept_is_int64(&v));
+    EXPECT_EQ_DOUBLE(1234.5, lept_get_number(&v));
+    lept_free(&v);
+}
+
 static void test_access_string() {
     lept_value v;
     lept_init(&v);
@@ -258,14 +1637,446 @@ static void test_access_string() {
     EXPECT_EQ_STRING("", lept_get_string(&v), lept_get_string_length(&v));
     lept_set_string(&v, "Hello", 5);
     EXPECT_EQ_STRING("Hello", lept_get_string(&v), lept_get_string_length(&v));
+
+    /* around the longest string kept inline */
+    lept_set_string(&v, "0123456789abcd", 14);
+    EXPECT_EQ_STRING("0123456789abcd", lept_get_string(&v), lept_get_string_length(&v));
+    EXPECT_EQ_INT('\0', lept_get_string(&v)[14]);
+    lept_set_string(&v, "0123456789abcde", 15);
+    EXPECT_EQ_STRING("0123456789abcde", lept_get_string(&v), lept_get_string_length(&v));
+    EXPECT_EQ_INT('\0', lept_get_string(&v)[15]);
+    lept_set_string(&v, "0123456789abcdef0123456789abcdef", 32);
+    EXPECT_EQ_STRING("0123456789abcdef0123456789abcdef", lept_get_string(&v), lept_get_string_length(&v));
+    lept_set_string(&v, "a\0b", 3);
+    EXPECT_EQ_STRING("a\0b", lept_get_string(&v), lept_get_string_length(&v));
+    lept_free(&v);
+}
+
+#define TEST_ROUNDTRIP(json)\
+    do {\
+        lept_value v;\
+        char* json2;\
+        size_t length;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&v, &json2, &length));\
+        EXPECT_EQ_STRING(json, json2, length);\
+        lept_free(&v);\
+        free(json2);\
+    } while(0)
+
+static void test_stringify_number() {
+    TEST_ROUNDTRIP("0");
+    TEST_ROUNDTRIP("-0");
+    TEST_ROUNDTRIP("1");
+    TEST_ROUNDTRIP("-1");
+    TEST_ROUNDTRIP("1.5");
+    TEST_ROUNDTRIP("-1.5");
+    TEST_ROUNDTRIP("3.25");
+    TEST_ROUNDTRIP("0.1");
+    TEST_ROUNDTRIP("0.3");
+    TEST_ROUNDTRIP("0.000001");
+    TEST_ROUNDTRIP("1e-7");
+    TEST_ROUNDTRIP("1.5e-7");
+    TEST_ROUNDTRIP("100000000000000000000");
+    TEST_ROUNDTRIP("1e+21");
+    TEST_ROUNDTRIP("1.234e+21");
+    TEST_ROUNDTRIP("1.234e-20");
+    TEST_ROUNDTRIP("9223372036854775807");
+    TEST_ROUNDTRIP("-9223372036854775808");
+    TEST_ROUNDTRIP("9223372036854776000"); /* 2^63 is a double already */
+
+    TEST_ROUNDTRIP("1.0000000000000002"); /* the smallest number > 1 */
+    TEST_ROUNDTRIP("5e-324"); /* minimum denormal */
+    TEST_ROUNDTRIP("-5e-324");
+    TEST_ROUNDTRIP("2.225073858507201e-308");  /* Max subnormal double */
+    TEST_ROUNDTRIP("-2.225073858507201e-308");
+    TEST_ROUNDTRIP("2.2250738585072014e-308");  /* Min normal positive double */
+    TEST_ROUNDTRIP("-2.2250738585072014e-308");
+    TEST_ROUNDTRIP("1.7976931348623157e+308");  /* Max double */
+    TEST_ROUNDTRIP("-1.7976931348623157e+308");
+}
+
+static void test_stringify_string() {
+    lept_value v;
+    char* json;
+    size_t length;
+    TEST_ROUNDTRIP("\"\"");
+    TEST_ROUNDTRIP("\"Hello\"");
+    TEST_ROUNDTRIP("\"Hello\\nWorld\"");
+    TEST_ROUNDTRIP("\"Hello\\u0000World\"");
+    TEST_ROUNDTRIP("\"\\\" \\\\ / \\b \\f \\n \\r \\t\"");
+    TEST_ROUNDTRIP("\"0123456789abcdef0123456789abcdef\\n0123456789abcdef0123456789abcde\\\"\"");
+
+    lept_init(&v);
+    lept_set_string(&v, "\x01\x1f\0a", 4);
+    EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&v, &json, &length));
+    EXPECT_EQ_STRING("\"\\u0001\\u001F\\u0000a\"", json, length);
+    free(json);
+    lept_free(&v);
+}
+
+static void test_stringify_array() {
+    TEST_ROUNDTRIP("[]");
+    TEST_ROUNDTRIP("[null,false,true,123,\"abc\",[1,2,3]]");
+}
+
+static void test_stringify_object() {
+    TEST_ROUNDTRIP("{}");
+    TEST_ROUNDTRIP("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
+}
+
+static void test_stringify() {
+    lept_value v;
+    char* json;
+    double inf = 1e308;
+    TEST_ROUNDTRIP("null");
+    TEST_ROUNDTRIP("false");
+    TEST_ROUNDTRIP("true");
+    test_stringify_number();
+    test_stringify_string();
+    test_stringify_array();
+    test_stringify_object();
+
+    /* JSON has no infinity */
+    lept_init(&v);
+    lept_set_number(&v, inf * 10);
+    EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&v, &json, NULL));
+    EXPECT_EQ_STRING("null", json, strlen(json));
+    free(json);
+    lept_free(&v);
+}
+
+typedef struct {
+    char buf[1024];
+    size_t len;
+    int writes, fail;
+}test_sink;
+
+static int test_sink_write(void* ctx, const char* buf, size_t len) {
+    test_sink* k = (test_sink*)ctx;
+    k->writes++;
+    if (k->fail || k->len + len > sizeof(k->buf))
+        return 1;
+    memcpy(k->buf + k->len, buf, len);
+    k->len += len;
+    return 0;
+}
+
+#define TEST_WRITER(json, buffer_size)\
+    do {\
+        lept_value v;\
+        lept_writer* w;\
+        test_sink k;\
+        char* json2;\
+        size_t length;\
+        lept_init(&v);\
+        k.len = 0;\
+        k.writes = k.fail = 0;\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&v, &json2, &length));\
+        w = lept_writer_create(test_sink_write, &k, buffer_size);\
+        EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_writer_value(w, &v));\
+        EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_writer_flush(w));\
+        lept_writer_destroy(w);\
+        EXPECT_EQ_SIZE_T(length, k.len);\
+        EXPECT_TRUE(k.len == length && memcmp(json2, k.buf, length) == 0);\
+        lept_free(&v);\
+        free(json2);\
+    } while(0)
+
+static void test_writer() {
+    static const char* docs[] = {
+        "null", "true", "-1.5e-7", "9223372036854775807", "\"\"", "\"\\u0001\\n\\\"\"", "[]", "{}",
+        "[null,false,true,123,\"abc\",[1,2,3],{}]",
+        "{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}",
+        "[\"0123456789abcdef0123456789abcdef\\n0123456789abcdef0123456789abcde\\\"\",{\"0123456789abcdef\\t\":[[]]}]"
+    };
+    size_t i;
+    lept_writer* w;
+    test_sink k;
+    for (i = 0; i < sizeof(docs) / sizeof(docs[0]); i++) {
+        TEST_WRITER(docs[i], 0);
+        TEST_WRITER(docs[i], 1);
+        TEST_WRITER(docs[i], 7);
+    }
+
+    /* values one call at a time, flushed when the 8 bytes buffer fills */
+    k.len = 0;
+    k.writes = k.fail = 0;
+    w = lept_writer_create(test_sink_write, &k, 8);
+    lept_writer_start_object(w);
+    lept_writer_key(w, "a", 1);
+    lept_writer_start_array(w);
+    lept_writer_null(w);
+    lept_writer_boolean(w, 0);
+    lept_writer_number(w, 0.5);
+    lept_writer_int64(w, -42);
+    lept_writer_string(w, "x\ty", 3);
+    lept_writer_start_object(w);
+    lept_writer_end_object(w);
+    lept_writer_end_array(w);
+    lept_writer_key(w, "", 0);
+    lept_writer_boolean(w, 1);
+    EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_writer_end_object(w));
+    EXPECT_TRUE(k.writes > 1);
+    EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_writer_flush(w));
+    lept_writer_destroy(w);
+    EXPECT_EQ_STRING("{\"a\":[null,false,0.5,-42,\"x\\ty\",{}],\"\":true}", k.buf, k.len);
+
+    /* a failing sink is reported from then on and called no more */
+    k.len = 0;
+    k.writes = 0;
+    k.fail = 1;
+    w = lept_writer_create(test_sink_write, &k, 4);
+    EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_writer_start_array(w));
+    EXPECT_EQ_INT(LEPT_STRINGIFY_WRITE_ERROR, lept_writer_string(w, "abcdef", 6));
+    EXPECT_EQ_INT(LEPT_STRINGIFY_WRITE_ERROR, lept_writer_end_array(w));
+    EXPECT_EQ_INT(LEPT_STRINGIFY_WRITE_ERROR, lept_writer_flush(w));
+    EXPECT_EQ_INT(1, k.writes);
+    lept_writer_destroy(w);
+}
+
+#define TEST_EQUAL(json1, json2, equality) \
+    do {\
+        lept_value v1, v2;\
+        lept_init(&v1);\
+        lept_init(&v2);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, json1));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, json2));\
+        EXPECT_EQ_INT(equality, lept_is_equal(&v1, &v2));\
+        lept_free(&v1);\
+        lept_free(&v2);\
+    } while(0)
+
+#define TEST_BINARY(json)\
+    do {\
+        lept_value v, w;\
+        char *data, *json2;\
+        size_t len, i, length;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_encode(&v, &data, &len));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode(&w, data, len));\
+        EXPECT_TRUE(lept_is_equal(&v, &w));\
+        EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&w, &json2, &length));\
+        EXPECT_EQ_STRING(json, json2, length);\
+        free(json2);\
+        lept_free(&w);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode_view(&w, data, len));\
+        EXPECT_TRUE(lept_is_equal(&v, &w));\
+        lept_free(&w);\
+        for (i = 0; i < len; i++)\
+            EXPECT_EQ_INT(LEPT_PARSE_INVALID_BINARY, lept_decode(&w, data, i));\
+        lept_free(&v);\
+        free(data);\
+    } while(0)
+
+#define TEST_BINARY_ERROR(error, data)\
+    do {\
+        lept_value v;\
+        lept_init(&v);\
+        v.type = LEPT_TRUE;\
+        EXPECT_EQ_INT(error, lept_decode(&v, data, sizeof(data) - 1));\
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+    } while(0)
+
+static void test_binary() {
+    lept_value v;
+    char* data;
+    size_t len;
+    TEST_BINARY("null");
+    TEST_BINARY("false");
+    TEST_BINARY("true");
+    TEST_BINARY("0");
+    TEST_BINARY("127");
+    TEST_BINARY("128");
+    TEST_BINARY("-1");
+    TEST_BINARY("-9223372036854775808");
+    TEST_BINARY("9223372036854775807");
+    TEST_BINARY("-0");
+    TEST_BINARY("1.5");
+    TEST_BINARY("1e+300");
+    TEST_BINARY("5e-324");
+    TEST_BINARY("\"\"");
+    TEST_BINARY("\"Hello\\u0000World\"");
+    TEST_BINARY("\"a string too long to be stored in the value itself, with a \\\"quote\\\"\"");
+    TEST_BINARY("[]");
+    TEST_BINARY("{}");
+    TEST_BINARY("[null,false,true,123,\"abc\",[1,2,3]]");
+    TEST_BINARY("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
+    TEST_BINARY("{\"\":{\"\":[[],{}]},\"\\u0000\":\"\\u0000\"}");
+
+    /* small integers take a single byte, sizes too */
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[1,2,3]"));
+    EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_encode(&v, &data, &len));
+    EXPECT_EQ_SIZE_T(5, len);
     lept_free(&v);
+    free(data);
+
+    TEST_BINARY_ERROR(LEPT_PARSE_INVALID_BINARY, "");
+    TEST_BINARY_ERROR(LEPT_PARSE_INVALID_BINARY, "\x08");
+    TEST_BINARY_ERROR(LEPT_PARSE_INVALID_BINARY, "\x7F");
+    TEST_BINARY_ERROR(LEPT_PARSE_INVALID_BINARY, "\x05\x01" "ab");     /* no '\0' after the string */
+    TEST_BINARY_ERROR(LEPT_PARSE_INVALID_BINARY, "\x06\x02\x81");      /* an element short */
+    TEST_BINARY_ERROR(LEPT_PARSE_INVALID_BINARY, "\x06\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x01");
+    TEST_BINARY_ERROR(LEPT_PARSE_INVALID_BINARY, "\x07\x01\x01" "a\x01\x81");
+    TEST_BINARY_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "\x81\x81");
+}
+
+static void test_equal() {
+    TEST_EQUAL("true", "true", 1);
+    TEST_EQUAL("true", "false", 0);
+    TEST_EQUAL("false", "false", 1);
+    TEST_EQUAL("null", "null", 1);
+    TEST_EQUAL("null", "0", 0);
+    TEST_EQUAL("123", "123", 1);
+    TEST_EQUAL("123", "456", 0);
+    TEST_EQUAL("1", "1.0", 1);
+    TEST_EQUAL("9007199254740993", "9007199254740992", 0);
+    TEST_EQUAL("9007199254740993", "9007199254740992.0", 0);
+    TEST_EQUAL("9007199254740992.0", "9007199254740993", 0);
+    TEST_EQUAL("9007199254740992", "9007199254740992.0", 1);
+    TEST_EQUAL("-9223372036854775808", "-9223372036854775808.0", 1);
+    TEST_EQUAL("9223372036854775807", "9223372036854775807.0", 0);
+    TEST_EQUAL("1", "1.5", 0);
+    TEST_EQUAL("\"abc\"", "\"abc\"", 1);
+    TEST_EQUAL("\"abc\"", "\"abcd\"", 0);
+    TEST_EQUAL("[]", "[]", 1);
+    TEST_EQUAL("[]", "null", 0);
+    TEST_EQUAL("[1,2,3]", "[1,2,3]", 1);
+    TEST_EQUAL("[1,2,3]", "[1,2,3,4]", 0);
+    TEST_EQUAL("[[]]", "[[]]", 1);
+    TEST_EQUAL("{}", "{}", 1);
+    TEST_EQUAL("{}", "null", 0);
+    TEST_EQUAL("{}", "[]", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2}", 1);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"b\":2,\"a\":1}", 1);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":3}", 0);
+    TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2,\"c\":3}", 0);
+    TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":{}}}}", 1);
+    TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":[]}}}", 0);
+}
+
+/* finds every key of v, its value being its number, whether or not v is indexed */
+static void test_access_object_find(const lept_value* v, size_t n) {
+    char key[24];
+    size_t i;
+    for (i = 0; i < n; i++) {
+        sprintf(key, "k%lu", (unsigned long)i);
+        EXPECT_EQ_SIZE_T(i, lept_find_object_index(v, key, strlen(key)));
+        EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_find_object_value(v, key, strlen(key))));
+    }
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(v, "k", 1));
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(v, "", 0));
+    EXPECT_TRUE(lept_find_object_value(v, "k0\0", 3) == NULL);
+    EXPECT_EQ_SIZE_T(n, lept_find_object_index(v, "\xE6\x97\xA5", 3));
+    EXPECT_EQ_SIZE_T(n + 1, lept_find_object_index(v, "a\0b", 3));
+}
+
+static void test_access_object() {
+    static const size_t sizes[] = { 2, 15, 16, 200 };
+    lept_parser* p = lept_parser_create();
+    lept_arena* a = lept_arena_create(0);
+    lept_value v, e;
+    char* json = (char*)malloc(4096);
+    size_t i, j, len;
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        len = sprintf(json, "{");
+        for (j = 0; j < sizes[i]; j++)
+            len += sprintf(json + len, "\"k%lu\":%lu,", (unsigned long)j, (unsigned long)j);
+        len += sprintf(json + len, "\"\\u65E5\":null,\"a\\u0000b\":[]}");
+        lept_init(&e);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_n(&e, json, len));
+        lept_parser_set_object_index(p, 1);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(p, &v, json, len));
+        EXPECT_TRUE(lept_is_equal(&e, &v));
+        EXPECT_TRUE(lept_is_equal(&v, &e));
+        test_access_object_find(&e, sizes[i]);
+        test_access_object_find(&v, sizes[i]);
+        /* an arena holds the index with the members */
+        lept_free(&v);
+        lept_parser_set_arena(p, a);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(p, &v, json, len));
+        test_access_object_find(&v, sizes[i]);
+        lept_parser_set_arena(p, NULL);
+        lept_parser_set_object_index(p, 0);
+        lept_arena_reset(a);
+
+        /* the first of duplicate keys is found */
+        memcpy(json + len - 1, ",\"k1\":true}", 12);
+        len += 10;
+        lept_parser_set_object_index(p, i % 2);
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(p, &v, json, len));
+        EXPECT_EQ_SIZE_T(1, lept_find_object_index(&v, "k1", 2));
+        EXPECT_EQ_DOUBLE(1.0, lept_get_number(lept_find_object_value(&v, "k1", 2)));
+        lept_parser_set_object_index(p, 0);
+        lept_free(&v);
+        lept_free(&e);
+    }
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"a\":{}}"));
+    EXPECT_TRUE(lept_find_object_value(&v, "b", 1) == NULL);
+    EXPECT_EQ_INT(LEPT_OBJECT, lept_get_type(lept_find_object_value(&v, "a", 1)));
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(lept_find_object_value(&v, "a", 1), "a", 1));
+    lept_free(&v);
+    free(json);
+    lept_arena_destroy(a);
+    lept_parser_destroy(p);
 }
 
 static void test_access() {
     test_access_null();
     test_access_boolean();
     test_access_number();
+    test_access_int64();
     test_access_string();
+    test_access_object();
+}
+
+static void* test_malloc(void* ctx, size_t size) {
+    ++*(long*)ctx;
+    return malloc(size);
+}
+
+static void* test_realloc(void* ctx, void* ptr, size_t size) {
+    if (!ptr)
+        ++*(long*)ctx;
+    return realloc(ptr, size);
+}
+
+static void test_free(void* ctx, void* ptr) {
+    if (ptr)
+        --*(long*)ctx;
+    free(ptr);
+}
+
+static void test_allocator() {
+    long live = 0;
+    lept_allocator a;
+    lept_parser* p;
+    lept_value v;
+    char* json;
+    a.malloc_func = test_malloc;
+    a.realloc_func = test_realloc;
+    a.free_func = test_free;
+    a.ctx = &live;
+    lept_set_allocator(&a);
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"a\":[1,\"a string longer than sixteen\"],\"b\":null}"));
+    EXPECT_TRUE(live > 0);
+    EXPECT_EQ_INT(LEPT_STRINGIFY_OK, lept_stringify(&v, &json, NULL));
+    test_free(&live, json);
+    lept_free(&v);
+    p = lept_parser_create();
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parser_parse(p, &v, "[[[[\"deep\"]]]]", 14));
+    lept_free(&v);
+    lept_parser_destroy(p);
+    EXPECT_EQ_INT(0, (int)live);
+    lept_set_allocator(NULL);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[\"a string longer than sixteen\"]"));
+    lept_free(&v);
+    EXPECT_EQ_INT(0, (int)live);
 }
 
 int main() {
@@ -273,7 +2084,12 @@ int main() {
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
     test_parse();
+    test_stringify();
+    test_writer();
+    test_binary();
     test_access();
+    test_equal();
+    test_allocator();
     printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
     return main_ret;
 }